@@ -0,0 +1,110 @@
+// Deliver an estimator's measurements on its own thread
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "multirotor_sim/estimator_base.h"
+#include "multirotor_sim/spsc_queue.h"
+
+namespace multirotor_sim
+{
+
+// Wraps an estimator so its callbacks run on a worker thread.  Each callback copies the
+// measurement into a preallocated slot and hands it to the worker through a lock-free queue,
+// so the simulator only waits when the estimator falls a whole queue behind.  Measurements
+// are delivered in the order they were made.
+//
+// The worker receives its own copy of the satellites passed to rawGnssCallback, so changes
+// made to them by the estimator are not seen by the simulator or other estimators.
+class AsyncEstimator : public EstimatorBase
+{
+public:
+  AsyncEstimator(EstimatorBase* est, size_t queue_size=1024);
+  // Delivers anything still queued before joining the worker
+  ~AsyncEstimator();
+  AsyncEstimator(const AsyncEstimator&) = delete;
+  AsyncEstimator& operator=(const AsyncEstimator&) = delete;
+
+  // The queues are cache line aligned, which plain new doesn't guarantee before C++17
+  static void* operator new(size_t size);
+  static void operator delete(void* p);
+
+  // Block until every measurement made so far has been delivered
+  void wait();
+
+  EstimatorBase* estimator() const { return est_; }
+  size_t queue_depth() const { return full_.size(); }
+  uint64_t delivered() const { return delivered_; }
+
+  void imuCallback(const double& t, const Vector6d& z, const Matrix6d& R) override;
+  void altCallback(const double& t, const Vector1d& z, const Matrix1d& R) override;
+  void baroCallback(const double& t, const Vector1d& z, const Matrix1d& R) override;
+  void mocapCallback(const double& t, const Xformd& z, const Matrix6d& R) override;
+  void velocityCallback(const double& t, const Vector3d& z, const Matrix3d& R) override;
+  void voCallback(const double& t, const Xformd& z, const Matrix6d& R) override;
+  void imageCallback(const double& t, const ImageFeat& z, const Matrix2d& R_pix, const Matrix1d& R_depth) override;
+  void arucoCallback(const double& t, const xform::Xformd& z, const Matrix6d& R) override;
+  void landmarksCallback(const double& t, const ImageFeat& z, const Matrix2d& R_pix) override;
+  void grayImageCallback(const double& t, const std::shared_ptr<const GrayImage>& img) override;
+  void gnssCallback(const double& t, const Vector6d& z, const Matrix6d& R) override;
+  void rawGnssCallback(const GTime& t, const VecVec3& z, const VecMat3& R,
+                       std::vector<Satellite, aligned_allocator<Satellite>>& sat,
+                       const std::vector<bool>& slip) override;
+
+private:
+  enum Type
+  {
+    IMU,
+    ALT,
+    BARO,
+    MOCAP,
+    VELOCITY,
+    VO,
+    IMAGE,
+    ARUCO,
+    LANDMARKS,
+    GRAY_IMAGE,
+    GNSS,
+    RAW_GNSS
+  };
+
+  // Large enough for any callback.  The vectors keep their capacity between uses, so once every
+  // slot has carried an image and a raw GNSS measurement nothing more is allocated
+  struct Measurement
+  {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    Type type;
+    double t;
+    Matrix<double, 7, 1> z; // leading elements, or an Xformd's elements
+    Matrix6d R; // top left block
+    Matrix1d R_depth;
+    ImageFeat img;
+    std::shared_ptr<const GrayImage> gray; // released once delivered, so the buffer can be reused
+    GTime gtime;
+    VecVec3 zs;
+    VecMat3 Rs;
+    std::vector<bool> slip;
+    std::vector<Satellite, aligned_allocator<Satellite>> sats;
+  };
+
+  Measurement* acquire(Type type, double t);
+  void submit(Measurement* m);
+  void worker();
+  void deliver(Measurement& m);
+
+  EstimatorBase* est_;
+  std::vector<Measurement, aligned_allocator<Measurement>> slots_;
+  SPSCQueue<Measurement*> full_; // simulator -> worker
+  SPSCQueue<Measurement*> free_; // worker -> simulator
+  uint64_t submitted_;
+  std::atomic<uint64_t> delivered_;
+  std::atomic<bool> stop_;
+  std::thread thread_;
+};
+
+}
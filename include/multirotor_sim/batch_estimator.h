@@ -0,0 +1,160 @@
+// Deliver measurements to estimators in batches
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "multirotor_sim/estimator_base.h"
+
+namespace multirotor_sim
+{
+
+// Every measurement of one kind in a batch, in delivery order.  The vectors hold fixed size
+// Eigen types back to back, so e.g. all of a batch's IMU samples can be viewed as one matrix:
+//   Map<const Matrix<double, 6, Dynamic>> z(batch.imu.z[0].data(), 6, batch.imu.size());
+template <typename Z, typename Cov>
+struct SensorBatch
+{
+  std::vector<double> t;
+  std::vector<Z, aligned_allocator<Z>> z;
+  std::vector<Cov, aligned_allocator<Cov>> R;
+
+  size_t size() const { return t.size(); }
+  bool empty() const { return t.empty(); }
+  void clear()
+  {
+    t.clear();
+    z.clear();
+    R.clear();
+  }
+  void push_back(double ti, const Z& zi, const Cov& Ri)
+  {
+    t.push_back(ti);
+    z.push_back(zi);
+    R.push_back(Ri);
+  }
+};
+
+struct RawGnssMeasurement
+{
+  GTime t;
+  VecVec3 z;
+  VecMat3 R;
+  std::vector<Satellite, aligned_allocator<Satellite>> sat;
+  std::vector<bool> slip;
+};
+
+struct GrayImageMeasurement
+{
+  double t;
+  std::shared_ptr<const GrayImage> img;
+};
+
+// The measurements delivered in one window
+struct MeasurementBatch
+{
+  enum Type
+  {
+    IMU,
+    ALT,
+    BARO,
+    MOCAP,
+    VELOCITY,
+    VO,
+    IMAGE,
+    ARUCO,
+    LANDMARKS,
+    GNSS,
+    RAW_GNSS,
+    GRAY_IMAGE
+  };
+
+  // The order the measurements were delivered in, across every sensor: the i'th measurement is
+  // element order[i].index of the batch of type order[i].type.  With sensor latency this can
+  // differ from the order of their timestamps.
+  struct Entry
+  {
+    uint32_t type;
+    uint32_t index;
+  };
+
+  // The window, from the stamp of the measurement which opened it.  Every measurement but raw GNSS
+  // (which is in GPS time) has t < t1, but one delayed by its sensor's latency is delivered in the
+  // window it arrives in, with its original stamp, so it can have t < t0.
+  double t0, t1;
+  std::vector<Entry> order;
+
+  SensorBatch<Vector6d, Matrix6d> imu;
+  SensorBatch<Vector1d, Matrix1d> alt;
+  SensorBatch<Vector1d, Matrix1d> baro;
+  SensorBatch<Xformd, Matrix6d> mocap;
+  SensorBatch<Vector3d, Matrix3d> velocity;
+  SensorBatch<Xformd, Matrix6d> vo;
+  SensorBatch<ImageFeat, Matrix2d> image;
+  std::vector<Matrix1d, aligned_allocator<Matrix1d>> image_R_depth;
+  SensorBatch<Xformd, Matrix6d> aruco;
+  SensorBatch<ImageFeat, Matrix2d> landmarks;
+  SensorBatch<Vector6d, Matrix6d> gnss;
+  std::vector<RawGnssMeasurement> raw_gnss;
+  std::vector<GrayImageMeasurement> gray_image; // held until the batch is cleared
+
+  size_t size() const { return order.size(); }
+  bool empty() const { return order.empty(); }
+  void clear();
+};
+
+// Implement to receive measurements a batch at a time
+class BatchEstimatorBase
+{
+public:
+  virtual ~BatchEstimatorBase() = default;
+  virtual void batchCallback(const MeasurementBatch& batch) {}
+};
+
+// Collects the measurements delivered to it (register it with the simulator like any other
+// estimator) and hands them to a BatchEstimatorBase one window at a time.
+//
+// Windows are aligned to multiples of window seconds (window <= 0 disables them), by measurement
+// stamp, and a measurement goes in the batch open when it is delivered.  A batch is delivered as
+// soon as a measurement stamped after its window arrives, or once it holds max_size
+// measurements (0 for no limit).  Call flush() to deliver the last, incomplete, batch.  Once
+// the batch's storage has grown to the largest batch only images and raw GNSS allocate.
+class MeasurementBatcher : public EstimatorBase
+{
+public:
+  MeasurementBatcher(BatchEstimatorBase* est, double window, size_t max_size=0);
+
+  void flush();
+  const MeasurementBatch& batch() const { return batch_; }
+
+  void imuCallback(const double& t, const Vector6d& z, const Matrix6d& R) override;
+  void altCallback(const double& t, const Vector1d& z, const Matrix1d& R) override;
+  void baroCallback(const double& t, const Vector1d& z, const Matrix1d& R) override;
+  void mocapCallback(const double& t, const Xformd& z, const Matrix6d& R) override;
+  void velocityCallback(const double& t, const Vector3d& z, const Matrix3d& R) override;
+  void voCallback(const double& t, const Xformd& z, const Matrix6d& R) override;
+  void imageCallback(const double& t, const ImageFeat& z, const Matrix2d& R_pix, const Matrix1d& R_depth) override;
+  void arucoCallback(const double& t, const xform::Xformd& z, const Matrix6d& R) override;
+  void landmarksCallback(const double& t, const ImageFeat& z, const Matrix2d& R_pix) override;
+  void grayImageCallback(const double& t, const std::shared_ptr<const GrayImage>& img) override;
+  void gnssCallback(const double& t, const Vector6d& z, const Matrix6d& R) override;
+  void rawGnssCallback(const GTime& t, const VecVec3& z, const VecMat3& R,
+                       std::vector<Satellite, aligned_allocator<Satellite>>& sat,
+                       const std::vector<bool>& slip) override;
+
+private:
+  // Delivers the current batch first if t is past its window
+  void begin(double t);
+  // Records the measurement just added, and delivers the batch if it's full
+  void end(MeasurementBatch::Type type, size_t index);
+
+  BatchEstimatorBase* est_;
+  double window_;
+  size_t max_size_;
+  double t_; // latest measurement time
+  MeasurementBatch batch_;
+};
+
+}
@@ -108,6 +108,8 @@ public:
 
   // Functions
   void load(const std::string filename);
+  // Reseeds the trajectory's random heading walk (here and in the nonlinear controller)
+  void reseed(uint64_t seed);
   void updateWaypointManager();
   void updateTrajectoryManager();
   void computeControl(const double& t, const State &x, const State& x_c, const Vector4d& ur, Vector4d& u) override;
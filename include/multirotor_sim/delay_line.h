@@ -0,0 +1,123 @@
+// Transport delay of sensor measurements
+#pragma once
+
+#include <stddef.h>
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <Eigen/Core>
+
+namespace multirotor_sim
+{
+
+// Time from a measurement being made to it reaching the estimators: a fixed latency plus
+// gaussian jitter, never negative.  No random numbers are drawn without jitter.
+struct LatencyModel
+{
+  double latency;
+  double jitter;
+
+  LatencyModel(double _latency=0, double _jitter=0) :
+    latency(_latency),
+    jitter(_jitter)
+  {}
+
+  template <typename Rng>
+  double sample(std::normal_distribution<double>& normal, Rng& rng) const
+  {
+    if (jitter <= 0)
+      return latency;
+    return std::max(latency + jitter * normal(rng), 0.0);
+  }
+};
+
+// Measurements waiting to be delivered, in a ring buffer.  Like a real link the line is
+// first-in first-out: a measurement is never released before one made earlier, however the
+// jitter falls.  Slots are reused, so once the buffer has grown to the most measurements ever in
+// flight (it starts with capacity for that many) nothing is allocated, and measurements
+// holding vectors keep their capacity between uses.
+template <typename T>
+class DelayLine
+{
+public:
+  struct Entry
+  {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    double release; // time the measurement reaches the estimators
+    double t; // time the measurement was made (its timestamp)
+    T z;
+  };
+
+  DelayLine(size_t capacity=8)
+  {
+    reset(capacity);
+  }
+
+  // Empties the line, with room for at least capacity measurements
+  void reset(size_t capacity)
+  {
+    size_t size = 1;
+    while (size < capacity)
+      size <<= 1;
+    buf_.clear();
+    buf_.resize(size);
+    head_ = 0;
+    size_ = 0;
+  }
+
+  // Returns the slot for a measurement made at t, to be filled in by the caller
+  T& push(double t, double release)
+  {
+    if (size_ == buf_.size())
+      grow();
+    if (size_ > 0)
+      release = std::max(release, back().release);
+    Entry& e = buf_[(head_ + size_) & (buf_.size() - 1)];
+    e.release = release;
+    e.t = t;
+    ++size_;
+    return e.z;
+  }
+
+  // Release time of the next measurement, infinity when there's none
+  double next_release() const
+  {
+    return size_ > 0 ? front().release : std::numeric_limits<double>::infinity();
+  }
+
+  const Entry& front() const { return buf_[head_]; }
+  Entry& front() { return buf_[head_]; } // e.g. to move a measurement out before pop()
+  const Entry& back() const { return buf_[(head_ + size_ - 1) & (buf_.size() - 1)]; }
+  void pop()
+  {
+    head_ = (head_ + 1) & (buf_.size() - 1);
+    --size_;
+  }
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  size_t capacity() const { return buf_.size(); }
+  void clear()
+  {
+    head_ = 0;
+    size_ = 0;
+  }
+
+private:
+  void grow()
+  {
+    std::vector<Entry, Eigen::aligned_allocator<Entry>> buf(buf_.size() * 2);
+    for (size_t i = 0; i < size_; i++)
+      std::swap(buf[i], buf_[(head_ + i) & (buf_.size() - 1)]);
+    buf_.swap(buf);
+    head_ = 0;
+  }
+
+  std::vector<Entry, Eigen::aligned_allocator<Entry>> buf_;
+  size_t head_;
+  size_t size_;
+};
+
+}
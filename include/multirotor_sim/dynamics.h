@@ -9,6 +9,7 @@
 #include "geometry/support.h"
 
 #include "multirotor_sim/state.h"
+#include "multirotor_sim/turbulence.h"
 
 using namespace quat;
 using namespace xform;
@@ -74,6 +75,10 @@ public:
   const Eigen::Vector3d& get_wind() const { return vw_; }
   Vector3d get_imu_accel() const;
   Vector3d get_imu_gyro() const;
+
+  // Sums the mean wind (walked by run()), the turbulence at the vehicle, carried dt further
+  // downwind, and any gust into vw_
+  void update_wind(double dt);
   
   // States and RK4 Workspace
   State x_, x2_, x3_, x4_;
@@ -93,6 +98,16 @@ public:
   bool wind_enabled_;
   double vw_walk_stdev_;
   Eigen::Vector3d vw_; // Wind velocity
+  Eigen::Vector3d vw_mean_; // Wind velocity without turbulence or gusts, random walking
+  double t_; // Time since load (s)
+
+  // Turbulence, a field shared between runs carried along by the mean wind, and gusts
+  std::shared_ptr<const TurbulenceField> turbulence_;
+  Eigen::Vector3d turbulence_offset_; // how far the mean wind has carried the field (m)
+  double gust_rate_; // gusts per second
+  double gust_stdev_; // of each component of a gust's amplitude (m/s)
+  double gust_duration_; // (s)
+  Gust gust_; // the current gust, or the next one
   
   bool noise_enabled_;
   Matrix12d Qsqrt_;
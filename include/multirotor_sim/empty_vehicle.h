@@ -33,6 +33,11 @@ public:
     pts.clear();
   }
 
+  LandmarkView landmarks() override
+  {
+    return LandmarkView();
+  }
+
   virtual Vector2d getPosition()
   {
     Vector2d pos;
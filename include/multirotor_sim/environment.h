@@ -3,9 +3,15 @@
 #include <Eigen/Core>
 #include <Eigen/Dense>
 
+#include <memory>
+#include <unordered_map>
+
 #include "geometry/xform.h"
+#include "geometry/cam.h"
 #include "nanoflann_eigen/nanoflann_eigen.h"
 #include "multirotor_sim/utils.h"
+#include "multirotor_sim/landmark_map.h"
+#include "multirotor_sim/scene.h"
 
 using namespace Eigen;
 using namespace std;
@@ -14,33 +20,112 @@ using namespace nanoflann;
 
 class Environment
 {
-    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
-    typedef struct
-    {
-        Vector3d bottom_left;
-        Vector3d normal;
-        double width;
-        double height;
-    } wall_t;
-    
 public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
     Environment(int seed);
-    void load(std::string filename);
+    // Copies own their points and rebuild their own kd-tree
+    Environment(const Environment& other);
+    Environment& operator=(const Environment& other);
+    ~Environment();
+    void load(std::string filename); // the landmark parameters and the scene
+    void load_scene(std::string filename); // only the walls and boxes, for the other sensors' rays
+    // Reseeds the generator new points are drawn from.  A tiled world keeps its seed, so its
+    // tiles stay the same world.
+    void reseed(uint64_t seed);
     bool get_center_img_center_on_ground_plane(const Xformd &x_I2c, Vector3d& point);
 
+    // The ground and the walls and boxes from the parameter file, for ray casts
+    const multirotor_sim::Scene& scene() const { return scene_; }
+
+    // Places a point where a random ray from the camera meets the scene (about the floor, within
+    // wall_max_offset of it, or on an obstacle)
     int add_point(const Vector3d& t_I_c, const Quatd& q_I_c, Vector3d& zeta, Vector2d& pix, double& depth);
     bool get_closest_points(const Vector3d &query_pt, int num_pts, double max_dist,
                             vector<Vector3d, aligned_allocator<Vector3d> > &pts, vector<size_t> &ids);
+
+    // Queries that write into caller-owned arrays, so they can be reused without allocating.
+    // Each fills ids and dist_sqr (squared distances) with at most capacity points within max_dist
+    // of query_pt and returns how many it found.  The k-nearest query returns them nearest first
+    // (the search is bounded by max_dist from the start, rather than filtered after); the radius
+    // query returns them in the order the tree visits them, stopping once the arrays are full.
+    size_t get_closest_points(const Vector3d& query_pt, size_t capacity, double max_dist,
+                              size_t* ids, double* dist_sqr) const;
+    size_t get_points_within(const Vector3d& query_pt, double max_dist, size_t capacity,
+                             size_t* ids, double* dist_sqr) const;
+
+    // Ids of every point the camera at x_I2c sees, between min_depth and max_depth from it and
+    // inside the image, in ascending order.  Cells of the point grid outside the frustum are
+    // discarded whole, so only the points of cells it touches are projected.  ids keeps its
+    // capacity between calls.
+    size_t query_frustum(const Xformd& x_I2c, const Camera<double>& cam, vector<size_t>& ids,
+                         double min_depth=0.5, double max_depth=100.0) const;
+
+    // Tiled world (world_tile_size > 0): instead of points added one by one, a fixed number of
+    // landmarks in every square tile, generated from the seed and the tile alone.  Tiles are
+    // loaded around the camera as it moves and the least recently used are evicted past
+    // world_max_tiles, so memory stays bounded however far it flies.  A tile's ids follow from its
+    // index alone, so a revisited tile gets back the same landmarks with the same ids.  They fit
+    // an int within about sqrt(2^31 / world_tile_landmarks) / 2 tiles of the origin, and loading
+    // a tile beyond throws std::runtime_error.
+    bool tiled() const { return tile_size_ > 0; }
+    // Loads the tiles within world_tile_radius of center, in a tiled world
+    void update_tiles(const Vector3d& center);
+    size_t num_loaded_tiles() const { return tiles_.size(); }
+
+    // Landmark map files.  save_map writes every point with its grid; open_map (or
+    // landmark_map_filename, in load) maps one read-only in place of the points so far.  Copies of
+    // this environment, and every other one mapping the same file, share its memory.  Points added
+    // after go to a private overlay, with ids following the map's.
+    void save_map(const std::string& filename) const;
+    void open_map(const std::string& filename);
+
+    // Any point ever returned by a query, tiled or not (evicted tiles are regenerated)
+    bool has_point(size_t id) const;
+    Vector3d get_point(size_t id) const;
+    // The points added one by one, empty in a tiled world (and only those since open_map)
     inline const std::vector<Vector3d, aligned_allocator<Vector3d>>& get_points() const {return points_.pts; }
     int point_idx_;
     
 protected:
+    struct GridCell
+    {
+        Vector3i index;
+        std::vector<uint64_t> ids;
+        std::vector<Vector3d, aligned_allocator<Vector3d>> pts; // of ids, kept alongside for locality
+    };
+    void grid_insert(size_t id, const Vector3d& pt);
+    void grid_erase(size_t id, const Vector3d& pt);
+    template <typename ResultSet>
+    void grid_search(const Vector3d& query_pt, double max_dist, ResultSet& result) const;
+
+    struct Tile
+    {
+        Vector2i index;
+        size_t ordinal; // place on a spiral out from the origin, so ids run ordinal * tile_landmarks_ onwards
+        uint64_t last_used;
+    };
+    void load_tile(const Vector2i& index);
+    void evict_tile(uint64_t key);
+    Vector3d tile_point(const Vector2i& index, int i) const;
+
     KDTree3d* kd_tree_;
     PointCloud<double> points_;
+    std::unordered_map<uint64_t, GridCell> grid_; // point ids by cell, hashed on the cell index
+    double grid_cell_size_;
+    std::shared_ptr<const multirotor_sim::LandmarkMap> map_;
+    size_t map_ids_; // ids below this are in map_, the rest in points_
+    uint64_t seed_;
+    double tile_size_;
+    int tile_landmarks_;
+    double tile_radius_;
+    int max_tiles_;
+    std::unordered_map<uint64_t, Tile> tiles_; // loaded tiles
+    uint64_t tile_clock_; // bumped by each update_tiles, for the LRU
     std::default_random_engine generator_;
     std::uniform_real_distribution<double> uniform_;
     std::normal_distribution<double> normal_;
     double floor_level_;
+    multirotor_sim::Scene scene_;
     double max_offset_;
     Vector2d img_size_;
     Vector2d img_center_;
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <memory>
+
 #include <Eigen/Core>
 
 #include "multirotor_sim/state.h"
@@ -10,6 +12,8 @@
 namespace  multirotor_sim
 {
 
+struct GrayImage; // multirotor_sim/rasterizer.h
+
 typedef std::vector<Vector3d, aligned_allocator<Vector3d>> VecVec3;
 typedef std::vector<Matrix3d, aligned_allocator<Matrix3d>> VecMat3;
 
@@ -31,6 +35,12 @@ public:
     virtual void arucoCallback(const double& t, const xform::Xformd& x_c2a_meas, const Matrix6d& aruco_R) {}
     virtual void landmarksCallback(const double& t, const ImageFeat& z, const Matrix2d& R_pix) {}
 
+    // t - time of capture (seconds)
+    // img - the image rendered for the camera or the simple camera (see img->source).  The
+    //       buffer is reused once every holder has let go of it, so keep the pointer rather than
+    //       copying the pixels
+    virtual void grayImageCallback(const double& t, const std::shared_ptr<const GrayImage>& img) {}
+
     // t - current time (seconds)
     // z - gnss measurement [p_{b/ECEF}^ECEF, v_{b/ECEF}^ECEF]
     // R - gnss covariance
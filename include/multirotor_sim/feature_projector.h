@@ -0,0 +1,57 @@
+// Project many landmarks into a camera at once
+#pragma once
+
+#include <Eigen/Core>
+
+#include "geometry/xform.h"
+#include "geometry/cam.h"
+
+namespace multirotor_sim
+{
+
+// Transforms and projects a set of landmarks in one pass over structure-of-arrays storage (one
+// aligned array per coordinate), so the transform and the culling run as straight-line Eigen
+// array expressions the compiler vectorizes.  Landmarks behind the camera or outside the image
+// are flagged in visible() rather than branched on.
+//
+// Storage is kept between frames, so once it has grown to the most landmarks projected nothing
+// is allocated.
+class FeatureProjector
+{
+public:
+  FeatureProjector();
+
+  // Sets the number of landmarks, keeping the positions of the first ones
+  void resize(int n);
+  int size() const { return n_; }
+
+  // Position of landmark i in the inertial frame
+  void set_point(int i, const Eigen::Vector3d& p)
+  {
+    px_[i] = p.x();
+    py_[i] = p.y();
+    pz_[i] = p.z();
+  }
+  // Sets every landmark at once from the columns of pts (inertial frame)
+  void set_points(const Eigen::Ref<const Eigen::Matrix3Xd>& pts);
+  Eigen::Vector3d point(int i) const { return Eigen::Vector3d(px_[i], py_[i], pz_[i]); }
+
+  // Projects every landmark into the camera at x_I2c
+  void project(const xform::Xformd& x_I2c, const Camera<double>& cam);
+
+  // Results of the last projection
+  bool visible(int i) const { return visible_[i]; }
+  Eigen::Vector3d bearing(int i) const { return Eigen::Vector3d(zx_[i], zy_[i], zz_[i]); } // unit vector, camera frame
+  Eigen::Vector2d pixel(int i) const { return Eigen::Vector2d(u_[i], v_[i]); }
+  double depth(int i) const { return depth_[i]; }
+
+private:
+  int n_;
+  Eigen::ArrayXd px_, py_, pz_; // landmarks, inertial frame
+  Eigen::ArrayXd zx_, zy_, zz_; // bearings
+  Eigen::ArrayXd u_, v_; // pixels
+  Eigen::ArrayXd depth_;
+  Eigen::Array<bool, Eigen::Dynamic, 1> visible_;
+};
+
+}
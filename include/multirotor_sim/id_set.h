@@ -0,0 +1,126 @@
+// Set of integer ids with constant time membership
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+namespace multirotor_sim
+{
+
+// Open-addressing hash set of non-negative ids: linear probing in a power-of-two table kept at
+// most half full, with backward-shift deletion so no tombstones build up as ids come and go.
+// Once reserved for the most ids held at a time, inserting and erasing never allocate.
+class IdSet
+{
+public:
+  IdSet(size_t capacity=16) :
+    size_(0)
+  {
+    reserve(capacity);
+  }
+
+  // Room for n ids without growing
+  void reserve(size_t n)
+  {
+    size_t slots = 4;
+    while (slots < 2 * n)
+      slots <<= 1;
+    if (slots > slots_.size())
+      rehash(slots);
+  }
+
+  bool contains(int id) const
+  {
+    for (size_t i = home(id);; i = next(i))
+    {
+      if (slots_[i] == id)
+        return true;
+      if (slots_[i] == EMPTY)
+        return false;
+    }
+  }
+
+  // Returns false if id was already in the set
+  bool insert(int id)
+  {
+    if (2 * (size_ + 1) > slots_.size())
+      rehash(2 * slots_.size());
+    size_t i = home(id);
+    for (; slots_[i] != EMPTY; i = next(i))
+    {
+      if (slots_[i] == id)
+        return false;
+    }
+    slots_[i] = id;
+    ++size_;
+    return true;
+  }
+
+  // Returns false if id wasn't in the set
+  bool erase(int id)
+  {
+    size_t i = home(id);
+    for (; slots_[i] != id; i = next(i))
+    {
+      if (slots_[i] == EMPTY)
+        return false;
+    }
+
+    // Shift later members of the probe run back into the hole, unless that would put them
+    // before their home slot
+    for (size_t j = next(i); slots_[j] != EMPTY; j = next(j))
+    {
+      size_t h = home(slots_[j]);
+      if (((j - h) & mask()) >= ((j - i) & mask()))
+      {
+        slots_[i] = slots_[j];
+        i = j;
+      }
+    }
+    slots_[i] = EMPTY;
+    --size_;
+    return true;
+  }
+
+  void clear()
+  {
+    std::fill(slots_.begin(), slots_.end(), EMPTY);
+    size_ = 0;
+  }
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+private:
+  enum { EMPTY = -1 };
+
+  size_t mask() const { return slots_.size() - 1; }
+  size_t next(size_t i) const { return (i + 1) & mask(); }
+  size_t home(int id) const
+  {
+    // Fibonacci hashing, so runs of consecutive ids spread over the table
+    return (size_t)(((uint64_t)(uint32_t)id * 0x9e3779b97f4a7c15ull) >> 32) & mask();
+  }
+
+  void rehash(size_t slots)
+  {
+    std::vector<int> old(slots, EMPTY);
+    old.swap(slots_);
+    for (size_t i = 0; i < old.size(); i++)
+    {
+      if (old[i] == EMPTY)
+        continue;
+      size_t j = home(old[i]);
+      while (slots_[j] != EMPTY)
+        j = next(j);
+      slots_[j] = old[i];
+    }
+  }
+
+  std::vector<int> slots_;
+  size_t size_;
+};
+
+}
@@ -0,0 +1,80 @@
+// A landmark map saved to a flat file, shared read-only between simulators
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+
+namespace multirotor_sim
+{
+
+// The points of an environment and its spatial grid, laid out so the file can be memory mapped
+// and used in place.  Every simulator mapping the same file shares the same physical pages, so
+// many parallel runs over one large map hold a single copy of it.
+//
+// File layout (native endianness, every section 8 byte aligned):
+//   header:  "MSIMMAP\0", uint32 version, uint32 reserved, double cell_size,
+//            uint64 num_cells, uint64 num_points, uint64 id_count
+//   cells:   num_cells Cell, sorted by key
+//   points:  num_points x, y, z doubles, grouped by cell
+//   ids:     num_points uint64, the id of each point
+//   slots:   id_count uint64, the position of each id in points (NO_SLOT for unused ids)
+class LandmarkMap
+{
+public:
+  enum { VERSION = 1 };
+  static const uint64_t NO_SLOT = ~0ull;
+
+  struct Cell
+  {
+    uint64_t key; // as hashed by Environment
+    int32_t index[3];
+    uint32_t reserved;
+    uint64_t begin; // first point of the cell
+    uint64_t count;
+  };
+
+  // Throws std::runtime_error if the file can't be mapped or isn't a landmark map
+  explicit LandmarkMap(const std::string& filename);
+  ~LandmarkMap();
+  LandmarkMap(const LandmarkMap&) = delete;
+  LandmarkMap& operator=(const LandmarkMap&) = delete;
+
+  // Writes a map; cells must be sorted by key and index points and ids
+  static void write(const std::string& filename, double cell_size, const std::vector<Cell>& cells,
+                    const std::vector<double>& points, const std::vector<uint64_t>& ids);
+
+  double cell_size() const { return cell_size_; }
+  size_t num_cells() const { return num_cells_; }
+  size_t num_points() const { return num_points_; }
+  // One past the largest id, so ids at and above it are free for points added after
+  size_t id_count() const { return id_count_; }
+
+  const Cell* cells() const { return cells_; }
+  // The cell with this key, or nullptr
+  const Cell* find(uint64_t key) const;
+  const double* points() const { return points_; }
+  const uint64_t* ids() const { return ids_; }
+
+  bool has_point(uint64_t id) const { return id < id_count_ && slots_[id] != NO_SLOT; }
+  Eigen::Vector3d point(uint64_t id) const
+  {
+    return Eigen::Map<const Eigen::Vector3d>(points_ + 3 * slots_[id]);
+  }
+
+private:
+  const uint8_t* data_;
+  size_t size_;
+  double cell_size_;
+  size_t num_cells_;
+  size_t num_points_;
+  size_t id_count_;
+  const Cell* cells_;
+  const double* points_;
+  const uint64_t* ids_;
+  const uint64_t* slots_;
+};
+
+}
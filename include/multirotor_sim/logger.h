@@ -0,0 +1,264 @@
+// Binary structured logging of simulator data
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "multirotor_sim/spsc_queue.h"
+
+namespace multirotor_sim
+{
+
+// Each channel of a log holds fixed-size records made of typed fields.
+//
+// File layout (little endian):
+//   header:  "MSIMLOG\0", uint32 version, uint32 reserved
+//   blocks:  uint32 kind, uint32 channel, uint32 payload bytes, uint32 records, payload
+//   trailer: uint64 offset of the INDEX block, "MSIMIDX\0"
+// A DEFINITION block holds "<name>\0<numpy dtype descriptor>\0" for its channel and is
+// written before any data of that channel.  A DATA block is a chunk of records of a single
+// channel stored column by column: all values of the first field, then all values of the
+// second, etc.  DATA_ZSTD and DATA_LZ4 blocks hold the same payload, compressed.
+// The INDEX block, written on close, holds an IndexEntry for every other block so a reader
+// can jump straight to the chunks of one channel and time range.  A log without a trailer
+// (e.g. the program crashed) can still be read by walking the blocks.
+// See python/sim_log.py for a reader.
+//
+// In asynchronous mode, blocks are copied into a pool of large buffers which a writer thread
+// takes over a lock-free queue, compresses and writes, so recording never waits on the disk or
+// the compressor unless every buffer is full.  What happens then is chosen by the Backpressure
+// policy.
+class Logger
+{
+public:
+  enum
+  {
+    VERSION = 2,
+    DEFINITION = 0,
+    DATA = 1,
+    DATA_ZSTD = 2,
+    DATA_LZ4 = 3,
+    INDEX = 4,
+    HEADER_SIZE = 16,
+    BLOCK_HEADER_SIZE = 16,
+    TRAILER_SIZE = 16
+  };
+
+  enum Compression
+  {
+    NONE,
+    ZSTD,
+    LZ4
+  };
+
+  struct IndexEntry
+  {
+    uint64_t offset;  // of the block header, from the start of the file
+    uint32_t kind;
+    uint32_t channel;
+    uint32_t records;
+    uint32_t reserved;
+    double t_min;     // range of the channel's "t" field in this chunk (+-inf if it has none)
+    double t_max;
+  };
+
+  enum Type
+  {
+    F64,
+    F32,
+    I64,
+    I32,
+    U32,
+    U8
+  };
+
+  // What an asynchronous logger does when the writer thread falls behind and no buffer is free
+  enum Backpressure
+  {
+    BLOCK, // wait for the writer thread
+    DROP   // discard data blocks (definitions are never dropped) and count them
+  };
+
+  struct Field
+  {
+    std::string name;
+    Type type;
+    int rows;
+    int cols;
+  };
+
+  class Channel
+  {
+  public:
+    Channel(const std::string& name) : name_(name), record_size_(0) {}
+
+    // Add a field of rows x cols elements (a scalar by default)
+    Channel& add(const std::string& name, Type type, int rows=1, int cols=1);
+
+    const std::string& name() const { return name_; }
+    const std::vector<Field>& fields() const { return fields_; }
+    size_t record_size() const { return record_size_; }
+    std::string numpy_dtype() const;
+
+  private:
+    std::string name_;
+    std::vector<Field> fields_;
+    size_t record_size_;
+  };
+
+  // Sequentially fills one record of a channel.  Matrices are written row-major, so a
+  // rows x cols field reads as a (rows, cols) array in numpy.
+  class Record
+  {
+  public:
+    Record(uint8_t* data, size_t size) : ptr_(data), end_(data + size) {}
+
+    Record& operator<< (double v) { return put(v); }
+    Record& operator<< (float v) { return put(v); }
+    Record& operator<< (int64_t v) { return put(v); }
+    Record& operator<< (int32_t v) { return put(v); }
+    Record& operator<< (uint32_t v) { return put(v); }
+    Record& operator<< (uint8_t v) { return put(v); }
+
+    template <typename Derived>
+    Record& operator<< (const Eigen::DenseBase<Derived>& m)
+    {
+      for (int i = 0; i < m.rows(); i++)
+        for (int j = 0; j < m.cols(); j++)
+          put((double)m(i, j));
+      return *this;
+    }
+
+    // Pad the remainder of a field with n copies of v
+    template <typename T>
+    Record& fill(int n, T v)
+    {
+      for (int i = 0; i < n; i++)
+        put(v);
+      return *this;
+    }
+
+    bool complete() const { return ptr_ == end_; }
+
+  private:
+    template <typename T>
+    Record& put(const T& v)
+    {
+      if ((size_t)(end_ - ptr_) >= sizeof(T))
+      {
+        memcpy(ptr_, &v, sizeof(T));
+        ptr_ += sizeof(T);
+      }
+      return *this;
+    }
+
+    uint8_t* ptr_;
+    uint8_t* end_;
+  };
+
+  // block_size is the size of the per-channel buffer which is written to disk when full
+  Logger(size_t block_size = 1 << 16);
+  ~Logger();
+  Logger(const Logger&) = delete;
+  Logger& operator=(const Logger&) = delete;
+
+  // Write to disk from a dedicated thread, through num_buffers buffers of buffer_size bytes.
+  // Takes effect at the next open()
+  void set_async(size_t buffer_size = 1 << 20, int num_buffers = 4, Backpressure policy = BLOCK);
+  void set_sync();
+  bool is_async() const { return async_; }
+
+  // Compress data chunks.  Returns false if the library was built without that compressor.
+  // In asynchronous mode chunks are compressed by the writer thread, off the recording thread,
+  // so the buffers carry them uncompressed; in synchronous mode, by the thread calling record().
+  bool set_compression(Compression compression, int level = 1);
+  static bool has_compression(Compression compression);
+
+  bool open(const std::string& filename);
+  void close();
+  bool is_open() const { return file_ != nullptr; }
+
+  // Register a channel and return its id.  Channels can be added at any time
+  int add_channel(const Channel& channel);
+  const Channel& channel(int id) const { return channels_[id].def; }
+  int num_channels() const { return channels_.size(); }
+
+  // Start a new record in a channel.  Fields not written are left zeroed.
+  Record record(int channel);
+
+  // Write all partially filled blocks to disk (waits for the writer thread in asynchronous mode)
+  void flush();
+
+  // Write a python module with a numpy dtype for every channel
+  bool write_numpy_dtypes(const std::string& filename) const;
+
+  // Bytes which have reached the file
+  uint64_t bytes_written() const { return bytes_written_.load(); }
+  // Buffers handed to the writer thread and not yet written
+  int queue_depth() const { return queue_depth_.load(); }
+  // Data blocks (and their bytes, before compression) discarded by the DROP policy
+  uint64_t dropped_blocks() const { return dropped_blocks_; }
+  uint64_t dropped_bytes() const { return dropped_bytes_; }
+
+private:
+  struct ChannelBuffer
+  {
+    ChannelBuffer(const Channel& c) : def(c), records(0) {}
+    Channel def;
+    std::vector<uint8_t> block;
+    uint32_t records;
+  };
+
+  void write_definition(ChannelBuffer& buf);
+  void write_block(int id);
+  void write_index();
+  // Hands a block to the writer thread, or emits it straight away in synchronous mode.
+  // Returns false if the block was dropped.
+  bool write(const IndexEntry& entry, const uint8_t* data, uint32_t size);
+  // Compresses a data block, writes it at offset_ and indexes it
+  void emit(IndexEntry entry, const uint8_t* data, uint32_t size);
+  size_t compress(const uint8_t* src, size_t size);
+
+  typedef std::vector<uint8_t> Buffer;
+  bool acquire_buffer(bool wait);
+  void submit_buffer();
+  void writer_thread();
+
+  size_t block_size_;
+  FILE* file_;
+  std::atomic<uint64_t> bytes_written_;
+  std::vector<ChannelBuffer> channels_;
+
+  // Chunk encoding and index.  compressed_, offset_ and index_ belong to the writer thread
+  // while it runs
+  Compression compression_;
+  int compression_level_;
+  std::vector<uint8_t> columns_;     // chunk being transposed into columns
+  std::vector<uint8_t> compressed_;
+  uint64_t offset_;                  // file offset of the next block
+  std::vector<IndexEntry> index_;
+
+  // Asynchronous writer
+  bool async_;
+  size_t buffer_size_;
+  int num_buffers_;
+  Backpressure policy_;
+  std::vector<Buffer> pool_;
+  Buffer* current_;                // buffer being filled by the recording thread
+  SPSCQueue<Buffer*> full_;        // recording thread -> writer thread
+  SPSCQueue<Buffer*> free_;        // writer thread -> recording thread
+  std::atomic<int> queue_depth_;
+  std::atomic<bool> stop_;
+  std::thread writer_;
+  uint64_t dropped_blocks_;
+  uint64_t dropped_bytes_;
+};
+
+}
@@ -0,0 +1,72 @@
+// Precomputed motion of moving platforms, evaluated in constant time
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+#include <Eigen/Core>
+
+namespace multirotor_sim
+{
+
+// The pose (x, y, z, roll, pitch, yaw in the inertial frame) of a platform sampled every dt over
+// one period, and interpolated between samples with a Catmull-Rom spline: any time costs one
+// index computation and four columns, however long the run.  The motion repeats every period,
+// shifted by drift (the distance a ship makes good in a period, or the turns a rover makes around
+// a loop), so the pose at t + period() is the pose at t plus drift.
+//
+// Tables are immutable once built, so one table can be shared by any number of vehicles on any
+// number of threads.  Vehicles started at different times into a long table see different
+// realizations of the same motion.
+class MotionTable
+{
+public:
+  enum { X, Y, Z, ROLL, PITCH, YAW, SIZE };
+  typedef Eigen::Matrix<double, SIZE, 1> Pose;
+  typedef Eigen::Matrix<double, SIZE, Eigen::Dynamic> Samples;
+
+  // samples.col(i) is the pose at i dt, for i in [0, samples.cols())
+  MotionTable(double dt, const Samples& samples, const Pose& drift=Pose::Zero());
+
+  // Sea state and course of a ship.  Heave, roll, pitch and yaw are each a sum of sinusoids
+  // with random phases, with amplitudes following a Bretschneider spectrum that peaks at the
+  // given period and scaled to the given standard deviation
+  struct ShipMotion
+  {
+    ShipMotion();
+
+    Eigen::Vector3d start; // position at t = 0 (m)
+    double heading; // course, and mean yaw (rad)
+    double speed; // (m/s)
+    double heave_stdev, heave_period; // (m, s)
+    double roll_stdev, roll_period; // (rad, s)
+    double pitch_stdev, pitch_period; // (rad, s)
+    double yaw_stdev, yaw_period; // (rad, s)
+    double duration; // length of the table before the motion repeats (s)
+    double dt; // (s)
+  };
+  static std::shared_ptr<const MotionTable> ship(const ShipMotion& motion, uint64_t seed);
+
+  // A platform driving around the closed loop through waypoints (a Catmull-Rom spline, back to the
+  // first waypoint) at a constant speed, level and facing along the path.  The loop is sampled
+  // about every dt (adjusted so a whole number of samples make a lap), from the first waypoint.
+  static std::shared_ptr<const MotionTable> path(const std::vector<Eigen::Vector3d>& waypoints, double speed,
+                                                 double dt=0.05);
+
+  Pose operator()(double t) const;
+
+  double dt() const { return dt_; }
+  double period() const { return dt_ * samples_.cols(); }
+  size_t size() const { return samples_.cols(); }
+  const Samples& samples() const { return samples_; }
+  const Pose& drift() const { return drift_; }
+
+private:
+  double dt_;
+  double inv_dt_;
+  Samples samples_;
+  Pose drift_;
+};
+
+}
@@ -0,0 +1,64 @@
+// Blocks of gaussian noise for the sensor models
+#pragma once
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <Eigen/Core>
+
+namespace multirotor_sim
+{
+
+// Standard normal samples, made a block at a time and handed out in slices.  A block is filled
+// in one tight loop by a ziggurat over a xoshiro256++ generator, which needs one 64 bit random
+// number and a compare for almost every sample, and a slice is then scaled as a fixed size Eigen
+// vector.  The samples depend only on the seed and on the sizes of the slices taken, so runs are
+// reproducible.
+class NoisePool
+{
+public:
+  NoisePool(uint64_t seed=0, size_t block_size=4096);
+
+  // Restarts the sequence, discarding the rest of the current block
+  void seed(uint64_t seed);
+
+  // The next n samples, contiguous.  A slice never spans two blocks: when the block doesn't have n
+  // left it is refilled, so n must not exceed the block size.
+  const double* take(size_t n)
+  {
+    assert(n <= (size_t)block_.size());
+    if (pos_ + n > (size_t)block_.size())
+      refill();
+    const double* p = block_.data() + pos_;
+    pos_ += n;
+    return p;
+  }
+
+  // One sample with the given standard deviation
+  double normal(double stdev=1.0)
+  {
+    return stdev * *take(1);
+  }
+
+  // A fixed size vector of independent samples with the given standard deviation
+  template <typename T>
+  T normal(double stdev=1.0)
+  {
+    return stdev * Eigen::Map<const T>(take(T::SizeAtCompileTime));
+  }
+
+  size_t block_size() const { return block_.size(); }
+
+private:
+  void refill();
+  uint64_t next();
+  double uniform(); // in (0, 1]
+  double sample();
+
+  uint64_t s_[4]; // xoshiro256++ state
+  Eigen::VectorXd block_;
+  size_t pos_; // next unused sample of block_
+};
+
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "geometry/xform.h"
+
+#include "multirotor_sim/state.h"
+#include "multirotor_sim/vehicle_base.h"
+#include "multirotor_sim/motion_table.h"
+
+namespace multirotor_sim
+{
+
+// A moving landing platform, such as a ship's deck or a rover, following a precomputed
+// MotionTable: each step is a table lookup, then one matrix product carrying the ArUco marker and
+// landmarks, fixed to the platform, into the inertial frame.  The landmarks are kept in one array,
+// returned by landmarks() without copying.
+//
+// The table is shared, not copied, so a Monte Carlo study can build a table per sea state once
+// and start each run's platform at a different time into it.
+class PlatformVehicle : public VehicleBase
+{
+public:
+  explicit PlatformVehicle(std::shared_ptr<const MotionTable> motion, double t0=0.0);
+
+  // Restarts the platform at time t0 into its table
+  void reset(double t0);
+
+  // The marker's pose in the platform frame
+  void set_aruco(const Vector3d& p_b_a, const quat::Quatd& q_b_a);
+  // Landmarks fixed to the platform, the columns of p_b in the platform frame.  Throws
+  // std::runtime_error unless there is one id for each column.
+  void set_landmarks(const std::vector<int>& ids, const Eigen::Matrix3Xd& p_b);
+  // A rows x cols grid of landmarks spacing apart, centred on center in the platform's xy plane,
+  // with ids from first_id along each row in turn (a fiducial grid on a landing pad)
+  void set_landmark_grid(int rows, int cols, double spacing, const Vector3d& center=Vector3d::Zero(),
+                         int first_id=0);
+
+  void step(const double& dt) override;
+  void arucoLocation(Vector3d& pt) override { pt = p_I_a_; }
+  void arucoOrientation(quat::Quatd& q_I_a) override { q_I_a = q_I_a_; }
+  void landmarkLocations(std::vector<int>& ids, std::vector<Vector3d>& pts) override;
+  LandmarkView landmarks() override
+  {
+    return LandmarkView(ids_.size(), ids_.data(), lm_I_.data());
+  }
+  Vector2d getPosition() override { return x_I2b_.t().head<2>(); }
+
+  double t() const { return t_; }
+  const xform::Xformd& pose() const { return x_I2b_; } // of the platform frame
+  const MotionTable& motion() const { return *motion_; }
+
+private:
+  void update();
+
+  std::shared_ptr<const MotionTable> motion_;
+  double t_;
+  xform::Xformd x_I2b_;
+  Vector3d p_b_a_;
+  quat::Quatd q_b_a_;
+  Vector3d p_I_a_;
+  quat::Quatd q_I_a_;
+  std::vector<int> ids_;
+  Eigen::Matrix3Xd lm_b_;
+  Eigen::Matrix3Xd lm_I_;
+};
+
+}  // namespace multirotor_sim
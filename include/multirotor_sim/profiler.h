@@ -0,0 +1,243 @@
+// Lightweight per-stage timing of the simulation loop
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <ostream>
+
+// Scoped timers are only compiled in when MULTIROTOR_SIM_PROFILE is defined.  Otherwise the
+// Profiler keeps empty histograms and PROFILE_SCOPE costs nothing.
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#ifdef MULTIROTOR_SIM_PROFILE
+#define PROFILE_SCOPE(prof, stage) \
+  multirotor_sim::ScopedTimer PROFILE_CONCAT(prof_timer_, __LINE__)((prof), (stage))
+#else
+#define PROFILE_SCOPE(prof, stage) do {} while (0)
+#endif
+
+namespace multirotor_sim
+{
+
+// Stages of Simulator::run.  Sensor stages time making measurements, the *_CB stages the
+// estimator callbacks they are delivered to once their latency has passed.
+enum ProfileStage
+{
+  PROF_RUN,
+  PROF_VEHICLE,
+  PROF_TRAJECTORY,
+  PROF_CONTROL,
+  PROF_DYNAMICS,
+  PROF_PROGRESS,
+  PROF_MEASUREMENTS,
+  PROF_IMU,
+  PROF_IMU_CB,
+  PROF_CAMERA,
+  PROF_IMAGE_CB,
+  PROF_ALT,
+  PROF_ALT_CB,
+  PROF_BARO,
+  PROF_BARO_CB,
+  PROF_MOCAP,
+  PROF_MOCAP_CB,
+  PROF_VELOCITY,
+  PROF_VELOCITY_CB,
+  PROF_VO,
+  PROF_VO_CB,
+  PROF_GNSS,
+  PROF_GNSS_CB,
+  PROF_RAW_GNSS,
+  PROF_RAW_GNSS_CB,
+  PROF_SIMPLE_CAM,
+  PROF_ARUCO_CB,
+  PROF_LANDMARKS_CB,
+  PROF_RENDER,
+  PROF_GRAY_IMAGE_CB,
+  PROF_ESTIMATOR_WAIT,
+  PROF_NUM_STAGES
+};
+
+static const char* const PROFILE_STAGE_NAMES[PROF_NUM_STAGES] = {
+  "run",
+  "vehicle",
+  "trajectory",
+  "control",
+  "dynamics",
+  "progress",
+  "measurements",
+  "imu",
+  "imu_cb",
+  "camera",
+  "image_cb",
+  "alt",
+  "alt_cb",
+  "baro",
+  "baro_cb",
+  "mocap",
+  "mocap_cb",
+  "velocity",
+  "velocity_cb",
+  "vo",
+  "vo_cb",
+  "gnss",
+  "gnss_cb",
+  "raw_gnss",
+  "raw_gnss_cb",
+  "simple_cam",
+  "aruco_cb",
+  "landmarks_cb",
+  "render",
+  "gray_image_cb",
+  "estimator_wait"
+};
+
+// Histogram with power-of-two nanosecond buckets.  Bucket i holds samples in [2^i, 2^(i+1)) ns
+class TimingHistogram
+{
+public:
+  enum
+  {
+    NUM_BUCKETS = 40 // 2^40 ns ~ 18 minutes
+  };
+
+  TimingHistogram()
+  {
+    clear();
+  }
+
+  void clear()
+  {
+    count_ = 0;
+    total_ns_ = 0;
+    min_ns_ = std::numeric_limits<uint64_t>::max();
+    max_ns_ = 0;
+    for (int i = 0; i < NUM_BUCKETS; i++)
+      buckets_[i] = 0;
+  }
+
+  void add(uint64_t ns)
+  {
+    ++count_;
+    total_ns_ += ns;
+    min_ns_ = ns < min_ns_ ? ns : min_ns_;
+    max_ns_ = ns > max_ns_ ? ns : max_ns_;
+    ++buckets_[bucket(ns)];
+  }
+
+  static int bucket(uint64_t ns)
+  {
+    int b = 0;
+    while (ns > 1 && b < NUM_BUCKETS - 1)
+    {
+      ns >>= 1;
+      ++b;
+    }
+    return b;
+  }
+
+  // Approximate percentile (p in [0, 1]), interpolated geometrically inside the bucket
+  double percentile(double p) const
+  {
+    if (count_ == 0)
+      return 0.0;
+    double target = p * count_;
+    uint64_t cumulative = 0;
+    for (int i = 0; i < NUM_BUCKETS; i++)
+    {
+      if (buckets_[i] == 0)
+        continue;
+      if (cumulative + buckets_[i] >= target)
+      {
+        double frac = (target - cumulative) / (double)buckets_[i];
+        double ns = std::ldexp(1.0, i) * std::pow(2.0, frac);
+        return ns < min_ns_ ? min_ns_ : ns > max_ns_ ? max_ns_ : ns;
+      }
+      cumulative += buckets_[i];
+    }
+    return max_ns_;
+  }
+
+  uint64_t count() const { return count_; }
+  uint64_t total_ns() const { return total_ns_; }
+  uint64_t min_ns() const { return count_ > 0 ? min_ns_ : 0; }
+  uint64_t max_ns() const { return max_ns_; }
+  double mean_ns() const { return count_ > 0 ? total_ns_ / (double)count_ : 0.0; }
+  uint64_t bucket_count(int i) const { return buckets_[i]; }
+
+private:
+  uint64_t count_;
+  uint64_t total_ns_;
+  uint64_t min_ns_;
+  uint64_t max_ns_;
+  uint64_t buckets_[NUM_BUCKETS];
+};
+
+class Profiler
+{
+public:
+  typedef std::chrono::steady_clock clock;
+
+  static uint64_t now_ns()
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now().time_since_epoch()).count();
+  }
+
+  void add(ProfileStage stage, uint64_t ns) { stages_[stage].add(ns); }
+  const TimingHistogram& stage(ProfileStage stage) const { return stages_[stage]; }
+  static const char* name(ProfileStage stage) { return PROFILE_STAGE_NAMES[stage]; }
+
+  void clear()
+  {
+    for (int i = 0; i < PROF_NUM_STAGES; i++)
+      stages_[i].clear();
+  }
+
+  // Print a table of every stage which has at least one sample
+  void print(std::ostream& out) const
+  {
+    char line[160];
+    snprintf(line, sizeof(line), "%-14s %10s %12s %10s %10s %10s %10s\n",
+             "stage", "count", "total(ms)", "mean(us)", "p50(us)", "p99(us)", "max(us)");
+    out << line;
+    for (int i = 0; i < PROF_NUM_STAGES; i++)
+    {
+      const TimingHistogram& h = stages_[i];
+      if (h.count() == 0)
+        continue;
+      snprintf(line, sizeof(line), "%-14s %10llu %12.3f %10.3f %10.3f %10.3f %10.3f\n",
+               PROFILE_STAGE_NAMES[i], (unsigned long long)h.count(), h.total_ns() * 1e-6,
+               h.mean_ns() * 1e-3, h.percentile(0.5) * 1e-3, h.percentile(0.99) * 1e-3,
+               h.max_ns() * 1e-3);
+      out << line;
+    }
+  }
+
+private:
+  TimingHistogram stages_[PROF_NUM_STAGES];
+};
+
+// Records the lifetime of the object into one stage of a Profiler
+class ScopedTimer
+{
+public:
+  ScopedTimer(Profiler& prof, ProfileStage stage) :
+    prof_(prof),
+    stage_(stage),
+    start_(Profiler::now_ns())
+  {}
+
+  ~ScopedTimer()
+  {
+    prof_.add(stage_, Profiler::now_ns() - start_);
+  }
+
+private:
+  Profiler& prof_;
+  ProfileStage stage_;
+  uint64_t start_;
+};
+
+}
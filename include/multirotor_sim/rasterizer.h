@@ -0,0 +1,187 @@
+// Grayscale camera images rendered on the CPU
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "geometry/xform.h"
+#include "geometry/cam.h"
+
+namespace multirotor_sim
+{
+
+// An 8 bit grayscale image, rows stride bytes apart (a multiple of 32)
+struct GrayImage
+{
+  enum Source { CAMERA, SIMPLE_CAM };
+
+  int source;
+  int id; // for the camera, the id of the ImageFeat of the same frame
+  int width;
+  int height;
+  int stride;
+  std::vector<uint8_t> pixels;
+
+  GrayImage() : source(CAMERA), id(0), width(0), height(0), stride(0) {}
+
+  // Keeps the buffer when it is already large enough
+  void resize(int w, int h)
+  {
+    width = w;
+    height = h;
+    stride = (w + 31) & ~31;
+    pixels.resize((size_t)stride * h);
+  }
+
+  uint8_t* row(int v) { return pixels.data() + (size_t)v * stride; }
+  const uint8_t* row(int v) const { return pixels.data() + (size_t)v * stride; }
+  uint8_t operator()(int u, int v) const { return row(v)[u]; }
+};
+
+// Frame buffers for images handed out without copying.  Estimators get a
+// shared_ptr<const GrayImage> straight to the buffer and may hold it as long as they like;
+// acquire() reuses a buffer once nothing but the pool holds it, and only allocates when every
+// buffer is still held (an estimator falling behind, or keeping frames).
+class ImagePool
+{
+public:
+  ImagePool() : next_(0) {}
+
+  std::shared_ptr<GrayImage> acquire(int width, int height);
+  size_t size() const { return images_.size(); }
+
+private:
+  std::vector<std::shared_ptr<GrayImage>> images_;
+  size_t next_; // where to start looking, so buffers are reused round robin
+};
+
+// Renders the ground plane, walls, boxes and markers as a camera sees them.  The image is split
+// into TILE x TILE tiles, which worker threads take in turn, each with tile buffers of its own
+// that stay in cache.  Every surface is a plane, on which 1/z and the texture coordinates over z
+// are linear in the pixel coordinates, so a tile first finds the nearest surface at each pixel
+// for runs of 8 pixels at once with Eigen arrays, then looks up the texture once per pixel, so
+// hidden surfaces cost no lookups.  Textures are procedural and mip mapped.
+//
+// Images use the pinhole model, without the camera's distortion.
+class Rasterizer
+{
+public:
+  enum { TILE = 32 };
+  enum Material
+  {
+    WALL, // textured every texel_size metres
+    MARKER // an ArUco marker (DICT_4X4_50 id 0) in a white margin, filling the rectangle
+  };
+
+  // Tiles are rendered by num_threads threads, the calling thread being one of them (0 for one
+  // per core, which oversubscribes the machine when several simulators run in parallel)
+  explicit Rasterizer(int num_threads=1);
+  ~Rasterizer();
+  Rasterizer(const Rasterizer&) = delete;
+  Rasterizer& operator=(const Rasterizer&) = delete;
+
+  int num_threads() const { return workers_.size() + 1; }
+
+  // The plane z = level (NED), textured every texel_size metres
+  void set_ground(double level, double texel_size=0.05);
+  void clear_ground() { has_ground_ = false; }
+
+  // The rectangle corner + a u + b v, a and b in [0, 1], returning its index.  A marker reads
+  // left to right along u and top to bottom along v
+  int add_quad(const Eigen::Vector3d& corner, const Eigen::Vector3d& u, const Eigen::Vector3d& v,
+               Material material, double texel_size=0.02);
+  void move_quad(int i, const Eigen::Vector3d& corner, const Eigen::Vector3d& u, const Eigen::Vector3d& v);
+  void clear_quads() { quads_.clear(); }
+  size_t num_quads() const { return quads_.size(); }
+
+  // Renders what cam sees from x_I2c into img, resized to the camera's image size
+  void render(const xform::Xformd& x_I2c, const Camera<double>& cam, GrayImage& img);
+
+private:
+  struct Texture
+  {
+    int log2_size;
+    std::vector<std::vector<uint8_t>> levels; // each half the size of the one before, to 1 x 1
+  };
+
+  struct Quad
+  {
+    Eigen::Vector3d corner, u, v;
+    Material material;
+    double texel_size;
+  };
+
+  // A quad as seen in this frame.  At the centre (x, y) of a pixel, 1/z = w(x, y), and the
+  // texture coordinates (in texels) are a(x, y) / w - a0 and b(x, y) / w - b0, with w, a and b
+  // each c0 + c1 x + c2 y
+  struct Plane
+  {
+    float w[3], a[3], b[3];
+    float a0, b0;
+    float a_max, b_max; // texture extent, or infinite for the ground
+    float lod_scale; // texels per pixel over z
+    float shade;
+    const Texture* texture;
+    bool wrap;
+    int x0, y0, x1, y1; // pixel bounds, x1 and y1 one past the end
+  };
+
+  // Per thread buffers for a tile: 1/z and the plane (or GROUND_SURFACE, SKY_SURFACE) in front
+  struct TileBuffer
+  {
+    std::vector<float> depth;
+    std::vector<int> surface;
+  };
+  enum { GROUND_SURFACE = -1, SKY_SURFACE = -2 };
+
+  static void build_noise(Texture& tex, int log2_size, uint64_t seed);
+  static void build_marker(Texture& tex);
+  static void build_mips(Texture& tex);
+  static float sample(const Texture& tex, float a, float b, float texels_per_pixel, bool wrap);
+
+  bool setup_plane(const Eigen::Vector3d& corner, const Eigen::Vector3d& u, const Eigen::Vector3d& v,
+                   double a_texels, double b_texels, Plane& plane) const;
+  void render_tiles(TileBuffer& buffer);
+  void render_tile(int tile, TileBuffer& buffer);
+  void draw_ground(int x0, int y0, int x1, int y1, float* depth, int* surface);
+  void draw_plane(const Plane& p, int index, int x0, int y0, int x1, int y1, float* depth, int* surface);
+  void shade(int x0, int y0, int x1, int y1, const float* depth, const int* surface);
+  void worker(int index);
+
+  bool has_ground_;
+  double ground_;
+  double ground_texel_size_;
+  std::vector<Quad> quads_;
+  Texture ground_texture_, wall_texture_, marker_texture_;
+
+  // The frame being rendered
+  Eigen::Matrix3d R_c2I_;
+  Eigen::Vector3d t_;
+  double fx_, fy_, cx_, cy_, s_;
+  GrayImage* img_;
+  int tiles_x_, tiles_y_;
+  bool ground_visible_;
+  Plane ground_plane_;
+  std::vector<Plane> planes_;
+  std::vector<std::vector<int>> bins_; // planes overlapping each tile
+  std::atomic<int> next_tile_;
+
+  // Workers wait for frame_ to change, render tiles until there are none left, and the last
+  // to finish wakes render()
+  std::vector<std::thread> workers_;
+  std::vector<TileBuffer> buffers_;
+  std::mutex mutex_;
+  std::condition_variable start_, done_;
+  uint64_t frame_;
+  int busy_;
+  bool stop_;
+};
+
+}
@@ -0,0 +1,163 @@
+// Record the measurements delivered to estimators and replay them without the simulator
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "multirotor_sim/estimator_base.h"
+
+namespace multirotor_sim
+{
+
+// Every callback the simulator makes, as a stream of tagged records in the order they were
+// delivered.  Values are stored as raw bytes, so a replay is bit-exact.
+//
+// File layout (native endianness):
+//   header:  "MSIMREC\0", uint32 version, uint32 reserved
+//   records: uint32 type, uint32 payload bytes, payload (padded to 8 bytes)
+namespace recording
+{
+enum
+{
+  VERSION = 1,
+  HEADER_SIZE = 16,
+  RECORD_HEADER_SIZE = 8
+};
+
+enum Type
+{
+  IMU,
+  ALT,
+  BARO,
+  MOCAP,
+  VELOCITY,
+  VO,
+  IMAGE,
+  ARUCO,
+  LANDMARKS,
+  GNSS,
+  SATELLITES, // the satellites passed to rawGnssCallback, only recorded when they change
+  RAW_GNSS,
+  NUM_TYPES
+};
+}
+
+// Register with the simulator (before any estimator which modifies the satellites passed to
+// rawGnssCallback) to record everything it delivers.  Rendered images are not recorded: they
+// would dwarf everything else, and rendering them again from the same seed gives the same pixels.
+class MeasurementRecorder : public EstimatorBase
+{
+public:
+  MeasurementRecorder();
+  ~MeasurementRecorder();
+  MeasurementRecorder(const MeasurementRecorder&) = delete;
+  MeasurementRecorder& operator=(const MeasurementRecorder&) = delete;
+
+  // A write that fails (e.g. on a full disk) closes the file, so is_open() turns false and
+  // num_records() counts only the records written before it
+  bool open(const std::string& filename);
+  // Returns false if any write failed since open()
+  bool close();
+  bool is_open() const { return file_ != nullptr; }
+  bool failed() const { return failed_; }
+  uint64_t num_records() const { return num_records_; }
+
+  void imuCallback(const double& t, const Vector6d& z, const Matrix6d& R) override;
+  void altCallback(const double& t, const Vector1d& z, const Matrix1d& R) override;
+  void baroCallback(const double& t, const Vector1d& z, const Matrix1d& R) override;
+  void mocapCallback(const double& t, const Xformd& z, const Matrix6d& R) override;
+  void velocityCallback(const double& t, const Vector3d& z, const Matrix3d& R) override;
+  void voCallback(const double& t, const Xformd& z, const Matrix6d& R) override;
+  void imageCallback(const double& t, const ImageFeat& z, const Matrix2d& R_pix, const Matrix1d& R_depth) override;
+  void arucoCallback(const double& t, const xform::Xformd& z, const Matrix6d& R) override;
+  void landmarksCallback(const double& t, const ImageFeat& z, const Matrix2d& R_pix) override;
+  void gnssCallback(const double& t, const Vector6d& z, const Matrix6d& R) override;
+  void rawGnssCallback(const GTime& t, const VecVec3& z, const VecMat3& R,
+                       std::vector<Satellite, aligned_allocator<Satellite>>& sat,
+                       const std::vector<bool>& slip) override;
+
+private:
+  void begin(recording::Type type);
+  void end();
+  void put(const void* data, size_t size);
+  template <typename T>
+  void put(const T& v) { put(&v, sizeof(T)); }
+  template <typename Derived>
+  void put_matrix(const Eigen::MatrixBase<Derived>& m) { put(m.derived().data(), sizeof(double) * m.size()); }
+  void put_image(const ImageFeat& z);
+
+  FILE* file_;
+  bool failed_;
+  std::vector<uint8_t> record_;
+  std::vector<uint8_t> satellites_; // last recorded SATELLITES payload
+  uint64_t num_records_;
+};
+
+// Streams a recording into estimators, as fast as they consume it.  The file is memory mapped,
+// so only the pages being replayed are resident.
+class MeasurementReplayer
+{
+public:
+  MeasurementReplayer();
+  ~MeasurementReplayer();
+  MeasurementReplayer(const MeasurementReplayer&) = delete;
+  MeasurementReplayer& operator=(const MeasurementReplayer&) = delete;
+
+  // Throws std::runtime_error if the file can't be mapped or isn't a recording
+  void open(const std::string& filename);
+  void close();
+
+  void register_estimator(EstimatorBase* est);
+
+  // Deliver the next record, returns false at the end of the recording.  Throws
+  // std::runtime_error for a record of unknown type or whose contents overrun it.
+  bool step();
+  // Deliver every remaining record, returns the number of records delivered
+  uint64_t run();
+  // Go back to the start of the recording
+  void rewind();
+
+  // Time of the last delivered measurement (seconds, or GPS time of week for raw GNSS)
+  double t() const { return t_; }
+  recording::Type last_type() const { return type_; }
+
+private:
+  // Throws unless the record has size more bytes left
+  void need(size_t size) const;
+  template <typename T>
+  void get(T& v) { need(sizeof(T)); memcpy(&v, ptr_, sizeof(T)); ptr_ += sizeof(T); }
+  template <typename Derived>
+  void get_matrix(Eigen::MatrixBase<Derived>& m)
+  {
+    need(sizeof(double) * m.size());
+    memcpy(m.derived().data(), ptr_, sizeof(double) * m.size());
+    ptr_ += sizeof(double) * m.size();
+  }
+  void get_image(ImageFeat& z);
+  void deliver(recording::Type type, const uint8_t* end);
+
+  typedef std::vector<EstimatorBase*> estVec;
+  estVec est_;
+
+  const uint8_t* data_;
+  size_t size_;
+  size_t pos_;
+  const uint8_t* ptr_;
+  const uint8_t* end_; // of the record's payload
+  double t_;
+  recording::Type type_;
+
+  // Reused between records to avoid allocating during a replay
+  ImageFeat img_;
+  VecVec3 z_;
+  VecMat3 R_;
+  std::vector<bool> slip_;
+  std::vector<Satellite, aligned_allocator<Satellite>> sats_;
+};
+
+}
@@ -0,0 +1,94 @@
+// Ray casting against the ground and obstacles of an environment
+#pragma once
+
+#include <vector>
+
+#include <Eigen/Core>
+
+namespace multirotor_sim
+{
+
+// The surfaces rays can hit: an optional ground plane, and rectangles (walls, and the faces of
+// boxes) indexed by a bounding volume hierarchy.  Rays are cast one at a time (the altimeter,
+// placing a landmark) or many from one origin (a camera, a lidar) in packets of PACKET rays,
+// which traverse the hierarchy together so each node's bounds are tested against all of them
+// in one vectorized slab test.
+class Scene
+{
+public:
+  enum { PACKET = 8 };
+  enum { GROUND = -1, NONE = -2 }; // surfaces other than a rectangle
+
+  Scene();
+
+  void clear();
+  // The plane z = level, facing up (NED)
+  void set_ground(double level);
+  // A vertical rectangle facing normal, width to the right (normal x down) and height upwards
+  // from bottom_left, as seen from in front
+  void add_wall(const Eigen::Vector3d& bottom_left, const Eigen::Vector3d& normal, double width, double height);
+  // An axis aligned box, as its six faces
+  void add_box(const Eigen::Vector3d& lo, const Eigen::Vector3d& hi);
+  // Builds the hierarchy, once the walls and boxes are added
+  void build();
+
+  size_t num_rectangles() const { return rects_.size(); }
+  bool has_ground() const { return has_ground_; }
+  double ground() const { return ground_; }
+  // Rectangle i, as corner + a u + b v for a and b in [0, 1], facing u x v
+  void rectangle(size_t i, Eigen::Vector3d& corner, Eigen::Vector3d& u, Eigen::Vector3d& v) const
+  {
+    corner = rects_[i].corner;
+    u = rects_[i].u;
+    v = rects_[i].v;
+  }
+
+  // Distance along the unit vector dir from origin to the first surface nearer than max_range.
+  // Returns false if there is none; surface is set to the index of the rectangle hit, or GROUND.
+  bool cast(const Eigen::Vector3d& origin, const Eigen::Vector3d& dir, double max_range,
+            double& range, int* surface=nullptr) const;
+  // The same for every column of dirs, with infinite ranges for the rays that miss
+  void cast(const Eigen::Vector3d& origin, const Eigen::Matrix3Xd& dirs, double max_range,
+            Eigen::VectorXd& ranges) const;
+
+  // Whether a rectangle lies between origin and each of n points (x, y, z consecutive, as in a
+  // Matrix3Xd), for hiding landmarks behind obstacles.  The ground isn't counted, since landmarks
+  // are scattered about it, nor is a surface the point itself lies on.  Any hit settles a ray, so
+  // a packet stops traversing as soon as all of its rays are blocked.
+  void occluded(const Eigen::Vector3d& origin, const double* points, int n, bool* blocked) const;
+
+private:
+  typedef Eigen::Array<double, PACKET, 1> Lane;
+
+  struct Rect
+  {
+    Eigen::Vector3d corner, u, v; // the rectangle is corner + a u + b v, a and b in [0, 1]
+    Eigen::Vector3d normal; // u x v
+    double u_inv_sqr, v_inv_sqr; // 1 / |u|^2, 1 / |v|^2
+  };
+  struct Node
+  {
+    Eigen::Vector3d lo, hi;
+    int left, right; // children, for an inner node, left lower along axis
+    int axis;
+    int first, count; // rectangles, for a leaf
+  };
+
+  void add_rect(const Eigen::Vector3d& corner, const Eigen::Vector3d& u, const Eigen::Vector3d& v);
+  int build_node(int first, int count);
+  double intersect(const Rect& r, const Eigen::Vector3d& origin, const Eigen::Vector3d& dir) const;
+  Lane intersect(const Rect& r, const Eigen::Vector3d& origin, const Lane& dx, const Lane& dy,
+                 const Lane& dz) const;
+  int next_leaf(const Eigen::Vector3d& origin, const Lane& ix, const Lane& iy, const Lane& iz,
+                const Lane& t_max, int* stack, int& top) const;
+  void cast_packet(const Eigen::Vector3d& origin, const double* dirs, int n, double max_range,
+                   double* ranges) const;
+  void occluded_packet(const Eigen::Vector3d& origin, const double* points, int n, bool* blocked) const;
+
+  bool has_ground_;
+  double ground_;
+  std::vector<Rect> rects_;
+  std::vector<Node> nodes_;
+};
+
+}
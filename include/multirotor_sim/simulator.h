@@ -5,6 +5,7 @@
 #include <deque>
 #include <fstream>
 #include <functional>
+#include <limits>
 #include <cstdint>
 #include <memory>
 
@@ -25,6 +26,16 @@
 #include "multirotor_sim/estimator_base.h"
 #include "multirotor_sim/vehicle_base.h"
 #include "multirotor_sim/empty_vehicle.h"
+#include "multirotor_sim/profiler.h"
+#include "multirotor_sim/trace.h"
+#include "multirotor_sim/logger.h"
+#include "multirotor_sim/recorder.h"
+#include "multirotor_sim/async_estimator.h"
+#include "multirotor_sim/delay_line.h"
+#include "multirotor_sim/noise_pool.h"
+#include "multirotor_sim/feature_projector.h"
+#include "multirotor_sim/id_set.h"
+#include "multirotor_sim/rasterizer.h"
 
 
 #ifdef MULTIROTOR_SIM_PRINT_DEBUG
@@ -52,6 +63,34 @@ public:
     int feature_id;
     double depth;
   } measurement_t;
+
+  // Raw GNSS measurement waiting to be delivered (the satellites are passed at delivery)
+  struct raw_gnss_meas_t
+  {
+    GTime t;
+    VecVec3 z;
+    VecMat3 R;
+    std::vector<bool> slip;
+  };
+
+  // The delay lines, in the order simultaneous measurements are delivered
+  enum DelayedSensor
+  {
+    DELAYED_IMU,
+    DELAYED_CAMERA,
+    DELAYED_ALT,
+    DELAYED_BARO,
+    DELAYED_MOCAP,
+    DELAYED_VELOCITY,
+    DELAYED_VO,
+    DELAYED_GNSS,
+    DELAYED_RAW_GNSS,
+    DELAYED_ARUCO,
+    DELAYED_LANDMARKS,
+    DELAYED_CAMERA_IMAGE,
+    DELAYED_SIMPLE_CAM_IMAGE,
+    NUM_DELAYED_SENSORS
+  };
   
   Simulator(bool prog_indicator=false, uint64_t seed=0);
   ~Simulator();
@@ -69,6 +108,8 @@ public:
   void init_velocity();
   void init_gnss();
   void init_raw_gnss();
+  void init_renderer();
+  void init_log();
 
   bool run();
   Vector4d compute_low_level_control(const Vector4d& u); // {F[0-1], Wx(rad/s), Wy, Wz}
@@ -84,11 +125,26 @@ public:
   void update_vo_meas();
   void update_gnss_meas();
   void update_raw_gnss_meas();
+  // Deliver the measurements whose latency has elapsed, from every sensor in release order
+  void deliver_measurements();
 
   void use_custom_controller(ControllerBase* cont);
   void use_custom_trajectory(TrajectoryBase* traj);
   void register_estimator(EstimatorBase* est);
 
+  // How estimator callbacks are made
+  enum EstimatorDispatch
+  {
+    DISPATCH_SYNC, // on the simulator thread, one estimator after the other
+    DISPATCH_BARRIER, // on a thread per estimator, run() returns once they have all caught up
+    DISPATCH_FREE_RUNNING // on a thread per estimator, call wait_for_estimators() before reading their output
+  };
+  // Also set by the estimator_dispatch parameter.  Applies to estimators already registered
+  // and to those registered later.  In the threaded modes estimators must outlive the simulator
+  void set_estimator_dispatch(EstimatorDispatch dispatch, size_t queue_size=1024);
+  EstimatorDispatch estimator_dispatch() const { return dispatch_; }
+  void wait_for_estimators();
+
   void use_custom_vehicle(VehicleBase* veh);
 
   const Vector6d& imu() const { return dyn_.imu_;}
@@ -103,6 +159,24 @@ public:
   Vector3d get_position_ecef() const;
   Vector3d get_velocity_ecef() const;
 
+  // Per-stage timing histograms (only populated when built with MULTIROTOR_SIM_PROFILE)
+  const Profiler& profiler() const { return prof_; }
+  Profiler& profiler() { return prof_; }
+
+  // Timeline of simulator events.  Enabled by the trace_filename parameter (written on
+  // destruction), or by calling trace().init(capacity) and trace().write_chrome_trace()
+  const TraceRecorder& trace() const { return trace_; }
+  TraceRecorder& trace() { return trace_; }
+
+  // Binary log of truth, commands and sensor measurements, opened by the log_filename
+  // parameter.  Read it with python/sim_log.py.  Also provides the writer thread's
+  // queue depth, bytes written and dropped blocks
+  const Logger& log() const { return log_; }
+
+  // Recording of every estimator callback, opened by the record_filename parameter.  Replay it
+  // into an estimator with MeasurementReplayer
+  const MeasurementRecorder& recorder() const { return recorder_; }
+
   Environment env_;
   Dynamics dyn_;
   ReferenceController ref_con_;
@@ -129,7 +203,7 @@ public:
    * of the supplied feature object given the current
    * simulator state
    * @param feature
-   * @return true if feature still in image, false otherwise
+   * @return true if feature still in image and not hidden behind an obstacle, false otherwise
    */
   bool update_feature(feature_t &feature) const;
   
@@ -139,7 +213,8 @@ public:
    * currently being tracked.  If retrack is false, or there are no previously observed landmarks,
    * or all previously observed landmarks are being tracked, creates a new, randomly selected landmark
    * in the camera frame from the environment and calculates its projection - global_id is automatically
-   * incremented with each new landmark
+   * incremented with each new landmark.  In a tiled world every landmark exists already, so
+   * it only takes untracked ones in view, whatever retrack is.
    * @param feature - ouput new feature with projection loaded
    * @param retrack - flag of whether to rediscover old landmarks or always create new
    * @returns bool - true if suceeded, false if the ground plane is not in the camera FOV.
@@ -147,6 +222,7 @@ public:
   bool get_feature_in_frame(feature_t &feature, bool retrack);
 
 
+  // Takes the next untracked landmark found in view by update_camera_meas
   bool get_previously_tracked_feature_in_frame(feature_t &feature);
   bool create_new_feature_in_frame(feature_t &feature);
   bool is_feature_tracked(const int env_id) const;
@@ -161,14 +237,117 @@ public:
 
   void update_simple_cam_pose();
 
+  // Renders what cam sees from x_I2c into an image from the pool, queued on line like a
+  // measurement made at t and released at release
+  void render_image(GrayImage::Source source, int id, const Xformd& x_I2c, const Camera<double>& cam,
+                    DelayLine<std::shared_ptr<const GrayImage>>& line, double t, double release);
+
+  void log_landmarks();
+
+  // Everything that evolves while the simulator runs: the vehicle state and wind, controller
+  // integrators and waypoint index, sensor biases and delay buffers, the GNSS clock and
+  // multipath state, the environment's landmarks and every random number generator, and the
+  // time into its motion table of a PlatformVehicle landing vehicle.  Parameters, custom
+  // controllers/trajectories, other custom vehicles (whose state restore() leaves as it is),
+  // estimators and the log, trace and recorder outputs are not included.
+  struct Snapshot
+  {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    Snapshot() : env(0), platform_t(std::numeric_limits<double>::quiet_NaN()) {}
+
+    double t;
+    Vector4d u;
+    Vector4d ur;
+    State xc;
+    Dynamics dyn;
+    ReferenceController ref_con;
+    Environment env;
+    default_random_engine rng;
+    uniform_real_distribution<double> uniform;
+    normal_distribution<double> normal;
+    NoisePool noise;
+    Vector3d w_err_prev;
+
+    double last_imu_update;
+    Vector3d accel_bias;
+    Vector3d gyro_bias;
+    double last_simple_cam_update;
+    double last_camera_update;
+    int next_feature_id;
+    vector<feature_t, aligned_allocator<feature_t>> tracked_points;
+    int image_id;
+    double last_altimeter_update;
+    double last_baro_update;
+    double baro_bias;
+    xform::Xformd X_I2bk;
+    double last_mocap_update;
+    double next_mocap_measurement;
+    double last_velocity_update;
+    double next_velocity_measurement;
+    double last_gnss_update;
+    Vector3d gnss_position_noise;
+    double clock_bias;
+    double clock_bias_rate;
+    std::vector<double> multipath_offset;
+    std::vector<int> carrier_phase_integer_offsets;
+    std::vector<Satellite, aligned_allocator<Satellite>> satellites;
+    double last_raw_gnss_update;
+
+    DelayLine<Vector6d> imu_delay;
+    DelayLine<ImageFeat> camera_delay;
+    DelayLine<Vector1d> alt_delay;
+    DelayLine<Vector1d> baro_delay;
+    DelayLine<Xformd> mocap_delay;
+    DelayLine<Vector3d> velocity_delay;
+    DelayLine<Xformd> vo_delay;
+    DelayLine<Vector6d> gnss_delay;
+    DelayLine<raw_gnss_meas_t> raw_gnss_delay;
+    DelayLine<Xformd> aruco_delay;
+    DelayLine<ImageFeat> landmarks_delay;
+    DelayLine<std::shared_ptr<const GrayImage>> camera_image_delay;
+    DelayLine<std::shared_ptr<const GrayImage>> simple_cam_image_delay;
+
+    double platform_t; // NaN unless the landing vehicle is a PlatformVehicle
+  };
+
+  // Fork a run: simulate a shared prefix once, take a snapshot, then restore() it (into this
+  // simulator or another loaded from the same parameters) and reseed() before each continuation.
+  // A PlatformVehicle registered with use_custom_vehicle is put back at the snapshot's time;
+  // another custom vehicle has to be reset by the caller after restore().
+  Snapshot snapshot() const;
+  void restore(const Snapshot& snap);
+  // Reseed the simulator, dynamics, reference controller and environment random number
+  // generators and the sensor noise pool, so continuations from the same snapshot diverge
+  void reseed(uint64_t seed);
+
 
 
   // Progress indicator, updated by run()
   ProgressBar prog_;
+  Profiler prof_;
+  TraceRecorder trace_;
+  std::string trace_filename_;
   bool prog_indicator_;
   std::string log_filename_;
   std::string param_filename_;
-  ofstream log_;
+  Logger log_;
+  int log_truth_;
+  int log_commanded_;
+  int log_input_;
+  int log_imu_;
+  int log_alt_;
+  int log_baro_;
+  int log_mocap_;
+  int log_velocity_;
+  int log_vo_;
+  int log_aruco_;
+  int log_landmarks_;
+  int log_gnss_;
+  int log_raw_gnss_;
+  MeasurementRecorder recorder_;
+  EstimatorDispatch dispatch_;
+  size_t estimator_queue_size_;
+  std::vector<std::unique_ptr<AsyncEstimator>> async_est_; // after recorder_, so it's drained first
 
   Vector4d u_; // Command vector passed from controller to dynamics [F, Omega]
   Vector4d ur_; // Reference Command given by the trajectory
@@ -181,6 +360,7 @@ public:
   default_random_engine rng_;
   uniform_real_distribution<double> uniform_;
   normal_distribution<double> normal_;
+  NoisePool noise_; // sensor noise of the IMU, altimeter, barometer, mocap and GNSS
 
   // Multirotor Hardware
   double max_thrust_;
@@ -202,6 +382,8 @@ public:
   Vector3d gyro_bias_; // Memory for random walk
   double gyro_noise_stdev_;
   double gyro_walk_stdev_;
+  LatencyModel imu_latency_;
+  DelayLine<Vector6d> imu_delay_;
 
   // Simple Cam
   bool simple_cam_enabled_;
@@ -211,12 +393,17 @@ public:
   double aruco_depth_noise_stdev_;
   Matrix2d aruco_pixel_R_;
   Matrix1d aruco_depth_R_;
+  Matrix6d aruco_R_;
   bool landmarks_enabled_;
   double lm_pixel_noise_stdev_;
   Matrix2d lm_pixel_R_;
   double last_simple_cam_update_;
   Camera<double> simple_cam_;
   ImageFeat sc_landmarks_;
+  FeatureProjector lm_projector_; // scratch for projecting the landing vehicle's landmarks
+  LatencyModel simple_cam_latency_;
+  DelayLine<Xformd> aruco_delay_;
+  DelayLine<ImageFeat> landmarks_delay_;
   Xformd x_b2sc_;
   Xformd x_I2sc_;
   
@@ -235,17 +422,40 @@ public:
   double camera_transmission_time_;
   bool loop_closure_; // whether to re-use features if they show up in the frame again
   vector<feature_t, aligned_allocator<feature_t>> tracked_points_; // currently tracked features
-  deque<std::pair<double,measurement_t>, aligned_allocator<std::pair<double,measurement_t>>> camera_measurements_buffer_; // container to hold measurements while waiting for delay
+  IdSet tracked_ids_; // ids of tracked_points_
+  vector<size_t> frustum_ids_; // landmarks in view this frame, for re-tracking
+  size_t frustum_next_; // first of frustum_ids_ not yet considered
+  size_t candidate_ids_[Scene::PACKET]; // untracked frustum landmarks, tested for occlusion together
+  int num_candidates_;
+  int next_candidate_; // first of candidate_ids_ not yet considered
+  Matrix3Xd occlusion_points_; // scratch for the occlusion queries of a frame
+  Array<bool, Dynamic, 1> occluded_;
+  LatencyModel camera_latency_;
+  DelayLine<ImageFeat> camera_delay_;
   Camera<double> cam_;
+  FeatureProjector projector_; // scratch for projecting the tracked features
   ImageFeat img_;
   int image_id_;
 
+  // Rendered images, of the camera (with the features) and the simple camera (with the ArUco
+  // marker and landmarks), delivered with the same latency as their measurements
+  bool render_camera_images_;
+  bool render_simple_cam_images_;
+  std::unique_ptr<Rasterizer> rasterizer_; // the ground and obstacles of env_, and the marker
+  int aruco_quad_; // the marker's quad, -1 for none
+  double aruco_quad_side_; // (m)
+  ImagePool image_pool_;
+  DelayLine<std::shared_ptr<const GrayImage>> camera_image_delay_;
+  DelayLine<std::shared_ptr<const GrayImage>> simple_cam_image_delay_;
+
   // Altimeter
   bool alt_enabled_;
   Matrix1d alt_R_;
   double altimeter_update_rate_;
   double last_altimeter_update_;
   double altimeter_noise_stdev_;
+  LatencyModel alt_latency_;
+  DelayLine<Vector1d> alt_delay_;
 
   // Barometer
   bool baro_enabled_;
@@ -256,12 +466,13 @@ public:
   double baro_bias_;
   double baro_bias_walk_stdev_;
   double alt0_;
+  LatencyModel baro_latency_;
+  DelayLine<Vector1d> baro_delay_;
 
   // Depth
   bool depth_enabled_;
   Matrix1d depth_R_;
   double depth_update_rate_;
-  double last_depth_update_;
   double depth_noise_stdev_;
 
   // Visual Odometry
@@ -272,6 +483,8 @@ public:
   double vo_delta_attitude_;
   double vo_translation_noise_stdev_;
   double vo_rotation_noise_stdev_;
+  LatencyModel vo_latency_;
+  DelayLine<Xformd> vo_delay_;
 
   // Motion Capture
   bool mocap_enabled_;
@@ -286,7 +499,8 @@ public:
   double mocap_time_offset_;
   double mocap_transmission_noise_;
   double mocap_transmission_time_;
-  deque<std::pair<double, measurement_t>, aligned_allocator<std::pair<double, measurement_t>>> mocap_measurement_buffer_; // container to hold measurements while waiting for delay
+  LatencyModel mocap_latency_;
+  DelayLine<Xformd> mocap_delay_;
 
   // Velocity Sensor
   bool velocity_enabled_;
@@ -295,6 +509,8 @@ public:
   double velocity_noise_stdev_;
   double last_velocity_update_;
   double next_velocity_measurement_;
+  LatencyModel velocity_latency_;
+  DelayLine<Vector3d> velocity_delay_;
 
   // GNSS
   bool gnss_enabled_;
@@ -306,6 +522,8 @@ public:
   double gnss_velocity_stdev_;
   double last_gnss_update_;
   Vector3d gnss_position_noise_;
+  LatencyModel gnss_latency_;
+  DelayLine<Vector6d> gnss_delay_;
 
   // RAW GNSS
   bool raw_gnss_enabled_;
@@ -326,5 +544,7 @@ public:
   std::vector<Satellite, aligned_allocator<Satellite>> satellites_;
   double last_raw_gnss_update_;
   GTime start_time_;
+  LatencyModel raw_gnss_latency_;
+  DelayLine<raw_gnss_meas_t> raw_gnss_delay_;
 };
 }
@@ -0,0 +1,81 @@
+// Lock-free single-producer single-consumer queue
+#pragma once
+
+#include <stddef.h>
+#include <atomic>
+#include <vector>
+
+namespace multirotor_sim
+{
+
+// Fixed-capacity ring buffer shared by exactly one producer thread (push) and one consumer
+// thread (pop).  Neither side ever blocks or allocates; push fails when the queue is full
+// and pop fails when it is empty.
+template <typename T>
+class SPSCQueue
+{
+public:
+  // Capacity is rounded up to a power of two
+  SPSCQueue(size_t capacity=1) :
+    head_(0),
+    tail_(0)
+  {
+    reset(capacity);
+  }
+
+  SPSCQueue(const SPSCQueue&) = delete;
+  SPSCQueue& operator=(const SPSCQueue&) = delete;
+
+  // Not thread safe, only call while neither side is using the queue
+  void reset(size_t capacity)
+  {
+    size_t size = 1;
+    while (size < capacity)
+      size <<= 1;
+    buf_.resize(size);
+    mask_ = size - 1;
+    head_.store(0);
+    tail_.store(0);
+  }
+
+  // Producer side
+  bool push(const T& v)
+  {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) > mask_)
+      return false;
+    buf_[tail & mask_] = v;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side
+  bool pop(T& v)
+  {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire))
+      return false;
+    v = buf_[head & mask_];
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Number of queued elements.  Exact on either side, approximate from any other thread
+  size_t size() const
+  {
+    // Read head first: tail never falls behind a previously read head
+    const size_t head = head_.load(std::memory_order_acquire);
+    return tail_.load(std::memory_order_acquire) - head;
+  }
+  bool empty() const { return size() == 0; }
+  size_t capacity() const { return buf_.size(); }
+
+private:
+  // head_ is written by the consumer and tail_ by the producer, keep them on separate cache lines
+  alignas(64) std::atomic<size_t> head_;
+  alignas(64) std::atomic<size_t> tail_;
+  alignas(64) size_t mask_;
+  std::vector<T> buf_;
+};
+
+}
@@ -0,0 +1,135 @@
+// Deliver measurements to a fixed set of estimators resolved at compile time
+#pragma once
+
+#include "multirotor_sim/estimator_base.h"
+#include "multirotor_sim/simulator.h"
+
+namespace multirotor_sim
+{
+
+// Fans every callback out to the estimators, in order, through qualified (non-virtual) calls.
+// The estimators' callbacks can be inlined into the fan-out, and the simulator makes one
+// virtual call per measurement however many estimators there are.  Estimators still derive from
+// EstimatorBase, so the same class can also be registered with Simulator::register_estimator.
+//
+// Callbacks are resolved against the declared types, so pass the most derived type of each
+// estimator.
+template <typename... Estimators>
+class StaticEstimators;
+
+template <>
+class StaticEstimators<> : public EstimatorBase
+{};
+
+template <typename Est, typename... Rest>
+class StaticEstimators<Est, Rest...> : public StaticEstimators<Rest...>
+{
+  typedef StaticEstimators<Rest...> Tail;
+
+public:
+  StaticEstimators(Est& est, Rest&... rest) :
+    Tail(rest...),
+    est_(est)
+  {}
+
+  void imuCallback(const double& t, const Vector6d& z, const Matrix6d& R) override
+  {
+    est_.Est::imuCallback(t, z, R);
+    Tail::imuCallback(t, z, R);
+  }
+  void altCallback(const double& t, const Vector1d& z, const Matrix1d& R) override
+  {
+    est_.Est::altCallback(t, z, R);
+    Tail::altCallback(t, z, R);
+  }
+  void baroCallback(const double& t, const Vector1d& z, const Matrix1d& R) override
+  {
+    est_.Est::baroCallback(t, z, R);
+    Tail::baroCallback(t, z, R);
+  }
+  void mocapCallback(const double& t, const Xformd& z, const Matrix6d& R) override
+  {
+    est_.Est::mocapCallback(t, z, R);
+    Tail::mocapCallback(t, z, R);
+  }
+  void velocityCallback(const double& t, const Vector3d& z, const Matrix3d& R) override
+  {
+    est_.Est::velocityCallback(t, z, R);
+    Tail::velocityCallback(t, z, R);
+  }
+  void voCallback(const double& t, const Xformd& z, const Matrix6d& R) override
+  {
+    est_.Est::voCallback(t, z, R);
+    Tail::voCallback(t, z, R);
+  }
+  void imageCallback(const double& t, const ImageFeat& z, const Matrix2d& R_pix, const Matrix1d& R_depth) override
+  {
+    est_.Est::imageCallback(t, z, R_pix, R_depth);
+    Tail::imageCallback(t, z, R_pix, R_depth);
+  }
+  void arucoCallback(const double& t, const xform::Xformd& z, const Matrix6d& R) override
+  {
+    est_.Est::arucoCallback(t, z, R);
+    Tail::arucoCallback(t, z, R);
+  }
+  void landmarksCallback(const double& t, const ImageFeat& z, const Matrix2d& R_pix) override
+  {
+    est_.Est::landmarksCallback(t, z, R_pix);
+    Tail::landmarksCallback(t, z, R_pix);
+  }
+  void grayImageCallback(const double& t, const std::shared_ptr<const GrayImage>& img) override
+  {
+    est_.Est::grayImageCallback(t, img);
+    Tail::grayImageCallback(t, img);
+  }
+  void gnssCallback(const double& t, const Vector6d& z, const Matrix6d& R) override
+  {
+    est_.Est::gnssCallback(t, z, R);
+    Tail::gnssCallback(t, z, R);
+  }
+  void rawGnssCallback(const GTime& t, const VecVec3& z, const VecMat3& R,
+                       std::vector<Satellite, aligned_allocator<Satellite>>& sat,
+                       const std::vector<bool>& slip) override
+  {
+    est_.Est::rawGnssCallback(t, z, R, sat, slip);
+    Tail::rawGnssCallback(t, z, R, sat, slip);
+  }
+
+private:
+  Est& est_;
+};
+
+// A Simulator whose estimators are fixed at compile time:
+//
+//   MyEkf ekf;
+//   MyPreintegrator preint;
+//   StaticSimulator<MyEkf, MyPreintegrator> sim(ekf, preint);
+//   sim.load(param_file);
+//
+// More estimators can still be registered with register_estimator(), and are called after
+// these through the virtual interface.
+template <typename... Estimators>
+class StaticSimulator : public Simulator
+{
+public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  StaticSimulator(Estimators&... est, bool prog_indicator=false, uint64_t seed=0) :
+    Simulator(prog_indicator, seed),
+    static_est_(est...)
+  {
+    register_estimator(&static_est_);
+  }
+
+  // Worker threads (see set_estimator_dispatch) may still be delivering to static_est_
+  ~StaticSimulator()
+  {
+    wait_for_estimators();
+  }
+
+  StaticEstimators<Estimators...>& estimators() { return static_est_; }
+
+private:
+  StaticEstimators<Estimators...> static_est_;
+};
+
+}
@@ -0,0 +1,128 @@
+// Timeline of simulator events, exported in the Chrome trace format
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "multirotor_sim/profiler.h"
+
+namespace multirotor_sim
+{
+
+// Records spans (stages and estimator callbacks) and instants (sensor firings) into a
+// fixed-capacity ring buffer.  When the buffer is full the oldest events are overwritten.
+// Event names are ProfileStages so the timeline lines up with the Profiler histograms.
+//
+// The timeline can be viewed in chrome://tracing or https://ui.perfetto.dev
+class TraceRecorder
+{
+public:
+  // Track (Chrome trace "thread") each event is drawn on
+  enum
+  {
+    SIMULATOR_TID = 0,
+    SENSOR_TID = 1,
+    ESTIMATOR_TID = 2 // estimator i is drawn on ESTIMATOR_TID + i
+  };
+
+  enum
+  {
+    SPAN = 0,
+    INSTANT = 1
+  };
+
+  struct Event
+  {
+    uint64_t wall_ns; // start time, relative to init()
+    uint32_t dur_ns;  // duration (spans only)
+    uint16_t stage;   // ProfileStage
+    uint8_t kind;     // SPAN or INSTANT
+    uint8_t tid;
+    double sim_t;     // simulated time of the event
+    double delay;     // transmission delay of a sensor measurement (s)
+  };
+
+  TraceRecorder() :
+    start_ns_(0),
+    mask_(0),
+    count_(0)
+  {}
+
+  // Allocate the ring buffer and start recording.  Capacity is rounded up to a power of two
+  void init(size_t capacity);
+  bool enabled() const { return !events_.empty(); }
+
+  uint64_t now() const { return Profiler::now_ns() - start_ns_; }
+
+  void span(ProfileStage stage, uint8_t tid, double sim_t, uint64_t start, uint64_t end)
+  {
+    uint64_t dur = end - start;
+    push(start, dur > UINT32_MAX ? UINT32_MAX : (uint32_t)dur, stage, SPAN, tid, sim_t, 0.0);
+  }
+
+  void instant(ProfileStage stage, double sim_t, double delay=0.0)
+  {
+    push(now(), 0, stage, INSTANT, SENSOR_TID, sim_t, delay);
+  }
+
+  // Number of events currently held, and number overwritten since init()
+  size_t size() const { return count_ < events_.size() ? count_ : events_.size(); }
+  uint64_t dropped() const { return count_ - size(); }
+  // i = 0 is the oldest event still in the buffer
+  const Event& event(size_t i) const { return events_[(count_ - size() + i) & mask_]; }
+  void clear() { count_ = 0; }
+
+  // Write the buffered events as Chrome trace JSON, returns false if the file can't be opened
+  bool write_chrome_trace(const std::string& filename) const;
+
+private:
+  void push(uint64_t wall_ns, uint32_t dur_ns, ProfileStage stage, uint8_t kind, uint8_t tid,
+            double sim_t, double delay)
+  {
+    if (events_.empty())
+      return;
+    Event& e = events_[count_ & mask_];
+    e.wall_ns = wall_ns;
+    e.dur_ns = dur_ns;
+    e.stage = stage;
+    e.kind = kind;
+    e.tid = tid;
+    e.sim_t = sim_t;
+    e.delay = delay;
+    ++count_;
+  }
+
+  uint64_t start_ns_;
+  uint64_t mask_;
+  uint64_t count_;
+  std::vector<Event> events_;
+};
+
+// Records its own lifetime as a span, if the recorder is enabled
+class TraceSpan
+{
+public:
+  TraceSpan(TraceRecorder& trace, ProfileStage stage, double sim_t, int tid=TraceRecorder::SIMULATOR_TID) :
+    trace_(trace.enabled() ? &trace : nullptr),
+    stage_(stage),
+    tid_(tid),
+    sim_t_(sim_t),
+    start_(trace_ ? trace_->now() : 0)
+  {}
+
+  ~TraceSpan()
+  {
+    if (trace_)
+      trace_->span(stage_, tid_, sim_t_, start_, trace_->now());
+  }
+
+private:
+  TraceRecorder* trace_;
+  ProfileStage stage_;
+  uint8_t tid_;
+  double sim_t_;
+  uint64_t start_;
+};
+
+}
@@ -0,0 +1,71 @@
+// Spatially correlated wind turbulence
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+#include <Eigen/Core>
+
+namespace multirotor_sim
+{
+
+// A frozen, divergence free field of turbulent wind velocities on a periodic grid of size^3
+// nodes, cell_size apart, with a Dryden or von Karman energy spectrum.  It is synthesized once, in
+// the wavenumber domain (each mode a random vector across its wavenumber, scaled by the spectrum)
+// and brought to space by FFT, so a run only samples it: a trilinear interpolation of the 8
+// nodes around a point.  The field tiles space, repeating every size * cell_size metres.
+//
+// A field is immutable once made.  shared() hands every caller asking for the same parameters
+// and seed the same field, so parallel runs hold one copy.
+class TurbulenceField
+{
+public:
+  enum Model { DRYDEN, VON_KARMAN };
+
+  struct Params
+  {
+    Params();
+
+    Model model;
+    int size; // nodes along each edge, a power of 2
+    double cell_size; // (m)
+    double length_scale; // turbulence scale length (m)
+    double stdev; // of each velocity component (m/s)
+  };
+
+  // Throws std::runtime_error unless size is a power of 2 and cell_size and length_scale are
+  // positive
+  TurbulenceField(const Params& params, uint64_t seed);
+  static std::shared_ptr<const TurbulenceField> shared(const Params& params, uint64_t seed);
+
+  // The wind at p (m/s)
+  Eigen::Vector3d sample(const Eigen::Vector3d& p) const;
+  // The wind at node (i, j, k)
+  Eigen::Vector3d node(int i, int j, int k) const;
+
+  const Params& params() const { return params_; }
+  uint64_t seed() const { return seed_; }
+  double period() const { return params_.size * params_.cell_size; }
+
+private:
+  Params params_;
+  uint64_t seed_;
+  int mask_;
+  double inv_cell_;
+  std::vector<float> v_; // x, y and z of each node, x fastest then y then z
+};
+
+// A discrete "1 - cosine" gust, rising from nothing to amplitude and back over duration
+struct Gust
+{
+  Gust() : start(0), duration(0), amplitude(Eigen::Vector3d::Zero()) {}
+
+  double start; // (s)
+  double duration; // (s)
+  Eigen::Vector3d amplitude; // (m/s)
+
+  Eigen::Vector3d velocity(double t) const;
+};
+
+}
@@ -7,6 +7,21 @@
 
 namespace multirotor_sim
 {
+
+// A vehicle's landmarks, viewed in storage the vehicle owns: ids[i] is the id of the landmark at
+// column i of points (inertial frame).  Valid until the vehicle's next step().
+struct LandmarkView
+{
+  LandmarkView() : size(0), ids(nullptr), pts(nullptr) {}
+  LandmarkView(int n, const int* id, const double* p) : size(n), ids(id), pts(p) {}
+
+  int size;
+  const int* ids;
+  const double* pts; // 3 x size, column major
+
+  Eigen::Map<const Eigen::Matrix3Xd> points() const { return Eigen::Map<const Eigen::Matrix3Xd>(pts, 3, size); }
+};
+
 class VehicleBase
 {
 public:
@@ -16,6 +31,22 @@ public:
   virtual void landmarkLocations(std::vector<int>& ids,
                                  std::vector<Vector3d>& pts) = 0;
   virtual Vector2d getPosition() = 0;
+
+  // Vehicles which keep their landmarks in contiguous arrays should return a view of them.  By
+  // default they are copied out of landmarkLocations, into buffers reused from call to call.
+  virtual LandmarkView landmarks()
+  {
+    landmarkLocations(lm_ids_, lm_pts_);
+    lm_array_.resize(3, lm_pts_.size());
+    for (size_t i = 0; i < lm_pts_.size(); i++)
+      lm_array_.col(i) = lm_pts_[i];
+    return LandmarkView(lm_ids_.size(), lm_ids_.data(), lm_array_.data());
+  }
+
+private:
+  std::vector<int> lm_ids_;
+  std::vector<Vector3d> lm_pts_;
+  Eigen::Matrix3Xd lm_array_;
 };
 
 }  // namespace multirotor_sim
@@ -1,11 +1,12 @@
 from plotWindow import plotWindow
+from sim_log import read_log
 import numpy as np
 import matplotlib.pyplot as plt
 
-data = np.reshape(np.fromfile('/tmp/Dynamics.Propagate.log', dtype=np.float64), (-1, 27)).T
-t = data[0,:]
-rk4 = data[1:14,:]
-euler = data[14:,:]
+data = read_log('/tmp/Dynamics.Propagate.log')['propagate']
+t = data['t']
+rk4 = data['rk4'].T
+euler = data['euler'].T
 
 
 pw = plotWindow()
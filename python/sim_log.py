@@ -0,0 +1,167 @@
+import ast
+import mmap
+import struct
+import numpy as np
+
+MAGIC = b'MSIMLOG\0'
+INDEX_MAGIC = b'MSIMIDX\0'
+VERSION = 2
+
+DEFINITION = 0
+DATA = 1
+DATA_ZSTD = 2
+DATA_LZ4 = 3
+INDEX = 4
+
+HEADER_SIZE = 16
+BLOCK_HEADER_SIZE = 16
+TRAILER_SIZE = 16
+INDEX_DTYPE = np.dtype([('offset', '<u8'), ('kind', '<u4'), ('channel', '<u4'), ('records', '<u4'),
+                        ('reserved', '<u4'), ('t_min', '<f8'), ('t_max', '<f8')])
+
+
+def _decompress(kind, payload, size):
+    if kind == DATA_ZSTD:
+        import zstandard
+        return zstandard.ZstdDecompressor().decompress(payload, max_output_size=size)
+    if kind == DATA_LZ4:
+        import lz4.block
+        return lz4.block.decompress(payload, uncompressed_size=size)
+    return payload
+
+
+class SimLog:
+    """Memory-mapped multirotor_sim::Logger file.
+
+    Only the chunks of the requested channels and time range are read (and decompressed),
+    and for uncompressed chunks only the requested fields are touched:
+
+        log = SimLog('/tmp/sim.log')
+        pos = log.read('truth', fields=['t', 'p'], t0=10.0, t1=20.0)
+        plt.plot(pos['t'], pos['p'][:, 2])
+    """
+
+    def __init__(self, filename):
+        self.file = open(filename, 'rb')
+        self.buf = mmap.mmap(self.file.fileno(), 0, access=mmap.ACCESS_READ)
+        if self.buf[:8] != MAGIC:
+            raise IOError("%s is not a multirotor_sim log" % filename)
+        version, = struct.unpack_from('<I', self.buf, 8)
+        if version != VERSION:
+            raise IOError("unsupported log version %d" % version)
+
+        self.index = self._read_index()
+        self.names = {}
+        self.dtypes = {}
+        for entry in self.index[self.index['kind'] == DEFINITION]:
+            start = int(entry['offset']) + BLOCK_HEADER_SIZE
+            kind, channel, size, records = struct.unpack_from('<IIII', self.buf, int(entry['offset']))
+            name, descr = self.buf[start:start + size].split(b'\0')[:2]
+            self.names[name.decode()] = channel
+            self.dtypes[channel] = np.dtype(ast.literal_eval(descr.decode()))
+
+    def close(self):
+        self.buf.close()
+        self.file.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+
+    def _read_index(self):
+        size = len(self.buf)
+        if size >= HEADER_SIZE + TRAILER_SIZE and self.buf[size - 8:] == INDEX_MAGIC:
+            offset, = struct.unpack_from('<Q', self.buf, size - TRAILER_SIZE)
+            kind, channel, nbytes, records = struct.unpack_from('<IIII', self.buf, offset)
+            if kind == INDEX:
+                return np.frombuffer(self.buf, dtype=INDEX_DTYPE, count=records,
+                                     offset=offset + BLOCK_HEADER_SIZE).copy()
+
+        # No index (the log wasn't closed), walk the blocks instead
+        entries = []
+        offset = HEADER_SIZE
+        while offset + BLOCK_HEADER_SIZE <= size:
+            kind, channel, nbytes, records = struct.unpack_from('<IIII', self.buf, offset)
+            if kind == INDEX or offset + BLOCK_HEADER_SIZE + nbytes > size:
+                break
+            entries.append((offset, kind, channel, records, 0, -np.inf, np.inf))
+            offset += BLOCK_HEADER_SIZE + nbytes
+        return np.array(entries, dtype=INDEX_DTYPE)
+
+    def channels(self):
+        return list(self.names.keys())
+
+    def dtype(self, name):
+        return self.dtypes[self.names[name]]
+
+    def read(self, name, fields=None, t0=None, t1=None):
+        """Return the records of a channel as a numpy structured array.
+
+        fields selects a subset of the channel's fields.  t0 and t1 restrict the records to
+        t0 <= t <= t1, for channels whose first field is 't'.
+        """
+        channel = self.names[name]
+        dtype = self.dtypes[channel]
+        fields = list(dtype.names) if fields is None else list(fields)
+        timed = dtype.names[0] == 't'
+        if not timed:
+            t0 = t1 = None
+        lo = -np.inf if t0 is None else t0
+        hi = np.inf if t1 is None else t1
+        load = fields if (t0 is None and t1 is None) or 't' in fields else ['t'] + fields
+
+        # Byte offset of each column within a chunk, per record
+        column_offset = {}
+        offset = 0
+        for f in dtype.names:
+            column_offset[f] = offset
+            offset += dtype.fields[f][0].itemsize
+
+        chunks = self.index[(self.index['channel'] == channel) & (self.index['kind'] != DEFINITION) &
+                            (self.index['kind'] != INDEX) & (self.index['t_max'] >= lo) &
+                            (self.index['t_min'] <= hi)]
+        out_dtype = np.dtype([(f, dtype.fields[f][0]) for f in load])
+        parts = []
+        for entry in chunks:
+            start = int(entry['offset'])
+            kind, _, nbytes, n = struct.unpack_from('<IIII', self.buf, start)
+            payload = memoryview(self.buf)[start + BLOCK_HEADER_SIZE:start + BLOCK_HEADER_SIZE + nbytes]
+            payload = _decompress(kind, payload, n * dtype.itemsize)
+
+            part = np.empty(n, dtype=out_dtype)
+            for f in load:
+                fdtype = dtype.fields[f][0]
+                count = n * int(np.prod(fdtype.shape, dtype=int))
+                part[f] = np.frombuffer(payload, dtype=fdtype.base, count=count,
+                                        offset=n * column_offset[f]).reshape((n,) + fdtype.shape)
+            if t0 is not None or t1 is not None:
+                part = part[(part['t'] >= lo) & (part['t'] <= hi)]
+            parts.append(part)
+
+        if len(parts) == 0:
+            data = np.zeros(0, dtype=out_dtype)
+        else:
+            data = np.concatenate(parts)
+        if load != fields:
+            data = data[fields]
+        return data
+
+
+def read_log(filename):
+    """Read every channel of a multirotor_sim::Logger file.
+
+    Returns a dict mapping channel name to a numpy structured array holding every
+    record of that channel, e.g. log['truth']['p'] is an (N, 3) array of positions.
+    """
+    with SimLog(filename) as log:
+        return dict((name, log.read(name)) for name in log.channels())
+
+
+if __name__ == '__main__':
+    import sys
+    with SimLog(sys.argv[1]) as log:
+        for name in log.channels():
+            data = log.read(name)
+            print("%-12s %8d records  %s" % (name, len(data), data.dtype.names))
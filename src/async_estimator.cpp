@@ -0,0 +1,235 @@
+#include <stdlib.h>
+#include <chrono>
+#include <new>
+
+#include "multirotor_sim/async_estimator.h"
+
+namespace multirotor_sim
+{
+
+AsyncEstimator::AsyncEstimator(EstimatorBase *est, size_t queue_size) :
+  est_(est),
+  full_(queue_size),
+  free_(queue_size),
+  submitted_(0),
+  delivered_(0),
+  stop_(false)
+{
+  slots_.resize(full_.capacity());
+  for (size_t i = 0; i < slots_.size(); i++)
+    free_.push(&slots_[i]);
+  thread_ = std::thread(&AsyncEstimator::worker, this);
+}
+
+AsyncEstimator::~AsyncEstimator()
+{
+  stop_ = true;
+  thread_.join();
+}
+
+void* AsyncEstimator::operator new(size_t size)
+{
+  void* p;
+  if (posix_memalign(&p, 64, size) != 0)
+    throw std::bad_alloc();
+  return p;
+}
+
+void AsyncEstimator::operator delete(void *p)
+{
+  free(p);
+}
+
+void AsyncEstimator::wait()
+{
+  while (delivered_.load(std::memory_order_acquire) != submitted_)
+    std::this_thread::yield();
+}
+
+AsyncEstimator::Measurement* AsyncEstimator::acquire(Type type, double t)
+{
+  // Every slot is only in use when the worker has fallen a whole queue behind
+  Measurement* m;
+  while (!free_.pop(m))
+    std::this_thread::yield();
+  m->type = type;
+  m->t = t;
+  return m;
+}
+
+void AsyncEstimator::submit(Measurement *m)
+{
+  ++submitted_;
+  full_.push(m);
+}
+
+void AsyncEstimator::worker()
+{
+  int idle = 0;
+  while (true)
+  {
+    // Check for stop before popping, so measurements made before destruction are delivered
+    bool stop = stop_;
+    Measurement* m;
+    if (full_.pop(m))
+    {
+      deliver(*m);
+      free_.push(m);
+      delivered_.fetch_add(1, std::memory_order_release);
+      idle = 0;
+    }
+    else if (stop)
+      break;
+    else if (++idle < 1000)
+      std::this_thread::yield(); // the next measurement is usually a step away
+    else
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+}
+
+void AsyncEstimator::deliver(Measurement &m)
+{
+  switch (m.type)
+  {
+  case IMU:
+    est_->imuCallback(m.t, m.z.head<6>(), m.R);
+    break;
+  case ALT:
+    est_->altCallback(m.t, m.z.head<1>(), m.R.topLeftCorner<1, 1>());
+    break;
+  case BARO:
+    est_->baroCallback(m.t, m.z.head<1>(), m.R.topLeftCorner<1, 1>());
+    break;
+  case MOCAP:
+    est_->mocapCallback(m.t, Xformd(m.z), m.R);
+    break;
+  case VELOCITY:
+    est_->velocityCallback(m.t, m.z.head<3>(), m.R.topLeftCorner<3, 3>());
+    break;
+  case VO:
+    est_->voCallback(m.t, Xformd(m.z), m.R);
+    break;
+  case IMAGE:
+    est_->imageCallback(m.t, m.img, m.R.topLeftCorner<2, 2>(), m.R_depth);
+    break;
+  case ARUCO:
+    est_->arucoCallback(m.t, Xformd(m.z), m.R);
+    break;
+  case LANDMARKS:
+    est_->landmarksCallback(m.t, m.img, m.R.topLeftCorner<2, 2>());
+    break;
+  case GRAY_IMAGE:
+    est_->grayImageCallback(m.t, m.gray);
+    m.gray.reset();
+    break;
+  case GNSS:
+    est_->gnssCallback(m.t, m.z.head<6>(), m.R);
+    break;
+  case RAW_GNSS:
+    est_->rawGnssCallback(m.gtime, m.zs, m.Rs, m.sats, m.slip);
+    break;
+  }
+}
+
+void AsyncEstimator::imuCallback(const double &t, const Vector6d &z, const Matrix6d &R)
+{
+  Measurement* m = acquire(IMU, t);
+  m->z.head<6>() = z;
+  m->R = R;
+  submit(m);
+}
+
+void AsyncEstimator::altCallback(const double &t, const Vector1d &z, const Matrix1d &R)
+{
+  Measurement* m = acquire(ALT, t);
+  m->z.head<1>() = z;
+  m->R.topLeftCorner<1, 1>() = R;
+  submit(m);
+}
+
+void AsyncEstimator::baroCallback(const double &t, const Vector1d &z, const Matrix1d &R)
+{
+  Measurement* m = acquire(BARO, t);
+  m->z.head<1>() = z;
+  m->R.topLeftCorner<1, 1>() = R;
+  submit(m);
+}
+
+void AsyncEstimator::mocapCallback(const double &t, const Xformd &z, const Matrix6d &R)
+{
+  Measurement* m = acquire(MOCAP, t);
+  m->z = z.elements();
+  m->R = R;
+  submit(m);
+}
+
+void AsyncEstimator::velocityCallback(const double &t, const Vector3d &z, const Matrix3d &R)
+{
+  Measurement* m = acquire(VELOCITY, t);
+  m->z.head<3>() = z;
+  m->R.topLeftCorner<3, 3>() = R;
+  submit(m);
+}
+
+void AsyncEstimator::voCallback(const double &t, const Xformd &z, const Matrix6d &R)
+{
+  Measurement* m = acquire(VO, t);
+  m->z = z.elements();
+  m->R = R;
+  submit(m);
+}
+
+void AsyncEstimator::imageCallback(const double &t, const ImageFeat &z, const Matrix2d &R_pix, const Matrix1d &R_depth)
+{
+  Measurement* m = acquire(IMAGE, t);
+  m->img = z;
+  m->R.topLeftCorner<2, 2>() = R_pix;
+  m->R_depth = R_depth;
+  submit(m);
+}
+
+void AsyncEstimator::arucoCallback(const double &t, const Xformd &z, const Matrix6d &R)
+{
+  Measurement* m = acquire(ARUCO, t);
+  m->z = z.elements();
+  m->R = R;
+  submit(m);
+}
+
+void AsyncEstimator::landmarksCallback(const double &t, const ImageFeat &z, const Matrix2d &R_pix)
+{
+  Measurement* m = acquire(LANDMARKS, t);
+  m->img = z;
+  m->R.topLeftCorner<2, 2>() = R_pix;
+  submit(m);
+}
+
+void AsyncEstimator::grayImageCallback(const double &t, const std::shared_ptr<const GrayImage> &img)
+{
+  Measurement* m = acquire(GRAY_IMAGE, t);
+  m->gray = img;
+  submit(m);
+}
+
+void AsyncEstimator::gnssCallback(const double &t, const Vector6d &z, const Matrix6d &R)
+{
+  Measurement* m = acquire(GNSS, t);
+  m->z.head<6>() = z;
+  m->R = R;
+  submit(m);
+}
+
+void AsyncEstimator::rawGnssCallback(const GTime &t, const VecVec3 &z, const VecMat3 &R,
+                                     std::vector<Satellite, aligned_allocator<Satellite>> &sat,
+                                     const std::vector<bool> &slip)
+{
+  Measurement* m = acquire(RAW_GNSS, t.tow_sec);
+  m->gtime = t;
+  m->zs = z;
+  m->Rs = R;
+  m->sats = sat;
+  m->slip = slip;
+  submit(m);
+}
+
+}
@@ -0,0 +1,169 @@
+#include <cmath>
+#include <limits>
+
+#include "multirotor_sim/batch_estimator.h"
+
+namespace multirotor_sim
+{
+
+void MeasurementBatch::clear()
+{
+  order.clear();
+  imu.clear();
+  alt.clear();
+  baro.clear();
+  mocap.clear();
+  velocity.clear();
+  vo.clear();
+  image.clear();
+  image_R_depth.clear();
+  aruco.clear();
+  landmarks.clear();
+  gnss.clear();
+  raw_gnss.clear();
+  gray_image.clear();
+}
+
+MeasurementBatcher::MeasurementBatcher(BatchEstimatorBase *est, double window, size_t max_size) :
+  est_(est),
+  window_(window),
+  max_size_(max_size),
+  t_(0)
+{
+  batch_.t0 = batch_.t1 = 0;
+}
+
+void MeasurementBatcher::flush()
+{
+  if (batch_.empty())
+    return;
+  est_->batchCallback(batch_);
+  batch_.clear();
+}
+
+void MeasurementBatcher::begin(double t)
+{
+  if (!batch_.empty() && t >= batch_.t1)
+    flush();
+  if (batch_.empty())
+  {
+    if (window_ > 0)
+    {
+      batch_.t0 = std::floor(t / window_) * window_;
+      batch_.t1 = batch_.t0 + window_;
+    }
+    else
+    {
+      batch_.t0 = t;
+      batch_.t1 = std::numeric_limits<double>::infinity();
+    }
+  }
+  t_ = t;
+}
+
+void MeasurementBatcher::end(MeasurementBatch::Type type, size_t index)
+{
+  MeasurementBatch::Entry entry = {(uint32_t)type, (uint32_t)index};
+  batch_.order.push_back(entry);
+  if (max_size_ > 0 && batch_.size() >= max_size_)
+    flush();
+}
+
+void MeasurementBatcher::imuCallback(const double &t, const Vector6d &z, const Matrix6d &R)
+{
+  begin(t);
+  batch_.imu.push_back(t, z, R);
+  end(MeasurementBatch::IMU, batch_.imu.size() - 1);
+}
+
+void MeasurementBatcher::altCallback(const double &t, const Vector1d &z, const Matrix1d &R)
+{
+  begin(t);
+  batch_.alt.push_back(t, z, R);
+  end(MeasurementBatch::ALT, batch_.alt.size() - 1);
+}
+
+void MeasurementBatcher::baroCallback(const double &t, const Vector1d &z, const Matrix1d &R)
+{
+  begin(t);
+  batch_.baro.push_back(t, z, R);
+  end(MeasurementBatch::BARO, batch_.baro.size() - 1);
+}
+
+void MeasurementBatcher::mocapCallback(const double &t, const Xformd &z, const Matrix6d &R)
+{
+  begin(t);
+  batch_.mocap.push_back(t, z, R);
+  end(MeasurementBatch::MOCAP, batch_.mocap.size() - 1);
+}
+
+void MeasurementBatcher::velocityCallback(const double &t, const Vector3d &z, const Matrix3d &R)
+{
+  begin(t);
+  batch_.velocity.push_back(t, z, R);
+  end(MeasurementBatch::VELOCITY, batch_.velocity.size() - 1);
+}
+
+void MeasurementBatcher::voCallback(const double &t, const Xformd &z, const Matrix6d &R)
+{
+  begin(t);
+  batch_.vo.push_back(t, z, R);
+  end(MeasurementBatch::VO, batch_.vo.size() - 1);
+}
+
+void MeasurementBatcher::imageCallback(const double &t, const ImageFeat &z, const Matrix2d &R_pix, const Matrix1d &R_depth)
+{
+  begin(t);
+  batch_.image.push_back(t, z, R_pix);
+  batch_.image_R_depth.push_back(R_depth);
+  end(MeasurementBatch::IMAGE, batch_.image.size() - 1);
+}
+
+void MeasurementBatcher::arucoCallback(const double &t, const Xformd &z, const Matrix6d &R)
+{
+  begin(t);
+  batch_.aruco.push_back(t, z, R);
+  end(MeasurementBatch::ARUCO, batch_.aruco.size() - 1);
+}
+
+void MeasurementBatcher::landmarksCallback(const double &t, const ImageFeat &z, const Matrix2d &R_pix)
+{
+  begin(t);
+  batch_.landmarks.push_back(t, z, R_pix);
+  end(MeasurementBatch::LANDMARKS, batch_.landmarks.size() - 1);
+}
+
+void MeasurementBatcher::grayImageCallback(const double &t, const std::shared_ptr<const GrayImage> &img)
+{
+  begin(t);
+  GrayImageMeasurement m;
+  m.t = t;
+  m.img = img;
+  batch_.gray_image.push_back(m);
+  end(MeasurementBatch::GRAY_IMAGE, batch_.gray_image.size() - 1);
+}
+
+void MeasurementBatcher::gnssCallback(const double &t, const Vector6d &z, const Matrix6d &R)
+{
+  begin(t);
+  batch_.gnss.push_back(t, z, R);
+  end(MeasurementBatch::GNSS, batch_.gnss.size() - 1);
+}
+
+void MeasurementBatcher::rawGnssCallback(const GTime &t, const VecVec3 &z, const VecMat3 &R,
+                                         std::vector<Satellite, aligned_allocator<Satellite>> &sat,
+                                         const std::vector<bool> &slip)
+{
+  // Raw GNSS is timestamped in GPS time, it goes in the window of the measurements around it
+  begin(t_);
+  batch_.raw_gnss.push_back(RawGnssMeasurement());
+  RawGnssMeasurement& m = batch_.raw_gnss.back();
+  m.t = t;
+  m.z = z;
+  m.R = R;
+  m.sat = sat;
+  m.slip = slip;
+  end(MeasurementBatch::RAW_GNSS, batch_.raw_gnss.size() - 1);
+}
+
+}
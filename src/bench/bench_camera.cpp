@@ -0,0 +1,75 @@
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "multirotor_sim/feature_projector.h"
+
+using namespace Eigen;
+using namespace multirotor_sim;
+
+static Camera<double> bench_camera()
+{
+  Camera<double> cam;
+  cam.focal_len_ << 250.0, 250.0;
+  cam.cam_center_ << 320.0, 240.0;
+  cam.image_size_ << 640.0, 480.0;
+  cam.distortion_.setZero();
+  cam.s_ = 0.0;
+  return cam;
+}
+
+static std::vector<Vector3d, aligned_allocator<Vector3d>> bench_landmarks(int n)
+{
+  srand(1);
+  std::vector<Vector3d, aligned_allocator<Vector3d>> pts(n);
+  for (int i = 0; i < n; i++)
+    pts[i] = Vector3d(0, 0, 10.0) + 5.0 * Vector3d::Random();
+  return pts;
+}
+
+// One feature at a time, the way Simulator::update_feature projects
+static void BM_ProjectFeaturesScalar(benchmark::State& state)
+{
+  Camera<double> cam = bench_camera();
+  std::vector<Vector3d, aligned_allocator<Vector3d>> pts = bench_landmarks(state.range(0));
+  xform::Xformd x_I2c = xform::Xformd::Identity();
+  for (auto _ : state)
+  {
+    int visible = 0;
+    for (size_t i = 0; i < pts.size(); i++)
+    {
+      Vector3d zeta = x_I2c.transformp(pts[i]);
+      if (zeta(2) < 0.0)
+        continue;
+      double depth = zeta.norm();
+      zeta /= depth;
+      Vector2d pix;
+      cam.proj(zeta, pix);
+      if ((pix.array() < 0).any() || (pix.array() > cam.image_size_.array()).any())
+        continue;
+      benchmark::DoNotOptimize(pix.data());
+      visible++;
+    }
+    benchmark::DoNotOptimize(visible);
+  }
+  state.SetItemsProcessed(state.iterations() * pts.size());
+}
+BENCHMARK(BM_ProjectFeaturesScalar)->Arg(50)->Arg(500);
+
+static void BM_ProjectFeaturesBatch(benchmark::State& state)
+{
+  Camera<double> cam = bench_camera();
+  std::vector<Vector3d, aligned_allocator<Vector3d>> pts = bench_landmarks(state.range(0));
+  xform::Xformd x_I2c = xform::Xformd::Identity();
+  FeatureProjector proj;
+  proj.resize(pts.size());
+  for (size_t i = 0; i < pts.size(); i++)
+    proj.set_point(i, pts[i]);
+  for (auto _ : state)
+  {
+    proj.project(x_I2c, cam);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * pts.size());
+}
+BENCHMARK(BM_ProjectFeaturesBatch)->Arg(50)->Arg(500);
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <yaml-cpp/yaml.h>
+
+#include "multirotor_sim/satellite.h"
+#include "multirotor_sim/gtime.h"
+#include "multirotor_sim/wsg84.h"
+
+// A temporary file of a name no other process has, removed when this one exits
+class BenchTempFile
+{
+public:
+  explicit BenchTempFile(const std::string& name) :
+    path_("/tmp/multirotor_sim_bench." + name + ".XXXXXX")
+  {
+    int fd = mkstemp(&path_[0]);
+    if (fd < 0)
+      throw std::runtime_error("Unable to create a temporary file for " + name);
+    close(fd);
+  }
+  ~BenchTempFile() { remove(path_.c_str()); }
+
+  const std::string& path() const { return path_; }
+
+private:
+  BenchTempFile(const BenchTempFile&);
+  BenchTempFile& operator=(const BenchTempFile&);
+  std::string path_;
+};
+
+// Write a parameter file based on params/sim_params.yaml with every sensor enabled and
+// return its name.  The file is written once per process.
+inline std::string bench_params()
+{
+  static std::string filename;
+  if (!filename.empty())
+    return filename;
+
+  static BenchTempFile file("params");
+  filename = file.path();
+  YAML::Node node = YAML::LoadFile(MULTIROTOR_SIM_DIR"/params/sim_params.yaml");
+  node["seed"] = 1;
+  node["tmax"] = 1e9;
+  node["log_filename"] = "";
+  node["ephemeris_filename"] = MULTIROTOR_SIM_DIR"/sample/eph.dat";
+  node["follow_vehicle"] = false;
+
+  node["imu_enabled"] = true;
+  node["alt_enabled"] = true;
+  node["baro_enabled"] = true;
+  node["mocap_enabled"] = true;
+  node["vo_enabled"] = true;
+  node["camera_enabled"] = true;
+  node["gnss_enabled"] = true;
+  node["raw_gnss_enabled"] = true;
+  node["velocity_sensor_enabled"] = true;
+  node["simple_cam_enabled"] = true;
+
+  node["velocity_update_rate"] = 50;
+  node["velocity_noise_stdev"] = 0.1;
+
+  node["simple_cam_update_rate"] = 30;
+  node["sc_cam_center"] = std::vector<double>{320, 240};
+  node["sc_image_size"] = std::vector<double>{640, 480};
+  node["sc_focal_len"] = std::vector<double>{250, 250};
+  node["aruco_enabled"] = true;
+  node["aruco_pixel_stdev"] = 1.0;
+  node["aruco_depth_stdev"] = 0.1;
+  node["landmarks_enabled"] = true;
+  node["landmarks_pixel_stdev"] = 1.0;
+  node["q_b_sc"] = std::vector<double>{1, 0, 0, 0};
+  node["p_b_sc"] = std::vector<double>{0, 0, 0};
+
+  std::ofstream out(filename);
+  out << node;
+  out.close();
+  return filename;
+}
+
+// Time and receiver position matching the default parameter file and sample ephemeris
+inline GTime bench_gps_time()
+{
+  return GTime(2026, 165029);
+}
+
+inline Eigen::Vector3d bench_receiver_ecef()
+{
+  return WSG84::lla2ecef(Eigen::Vector3d{0.702443501891, -1.9486196478, 1387.998309});
+}
+
+inline std::vector<Satellite> bench_satellites()
+{
+  std::vector<Satellite> sats;
+  for (int i = 0; i < 100; i++)
+  {
+    Satellite sat(i, sats.size());
+    sat.readFromRawFile(MULTIROTOR_SIM_DIR"/sample/eph.dat");
+    if (sat.eph_.A > 0)
+      sats.push_back(sat);
+  }
+  return sats;
+}
@@ -0,0 +1,64 @@
+#include <benchmark/benchmark.h>
+
+#include "multirotor_sim/lqr.h"
+#include "multirotor_sim/nlc.h"
+#include "bench_common.h"
+
+using namespace multirotor_sim;
+
+static max_t bench_max()
+{
+  max_t max;
+  max.roll = 1.0;
+  max.pitch = 1.0;
+  max.yaw_rate = 1.0;
+  max.throttle = 1.0;
+  max.vel = 5.0;
+  return max;
+}
+
+static void BM_LQRComputeControl(benchmark::State& state)
+{
+  LQR<double> lqr;
+  Matrix<double, 6, 1> Q_diag;
+  Q_diag << 1, 1, 10, 100, 100, 100;
+  Vector4d R_diag(10000, 1000, 1000, 1000);
+  lqr.init(0, bench_max(), 0.5, 0.5, 0.1, Q_diag.asDiagonal(), R_diag.asDiagonal());
+
+  State xhat, xc;
+  xhat.p << 0.5, -0.3, -4.8;
+  xhat.v << 0.2, 0.1, 0.0;
+  xc.p << 1.0, 0.0, -5.0;
+  double throttle;
+
+  for (auto _ : state)
+  {
+    State xc_copy = xc;
+    lqr.computeControl(xhat, xc_copy, 0.5, throttle);
+    benchmark::DoNotOptimize(throttle);
+  }
+}
+BENCHMARK(BM_LQRComputeControl);
+
+static void BM_NLCComputeControl(benchmark::State& state)
+{
+  NLC<double> nlc;
+  std::default_random_engine rng(1);
+  std::uniform_real_distribution<double> udist(-1.0, 1.0);
+  nlc.init(Matrix3d::Identity(), 2.0 * Matrix3d::Identity(), Matrix3d::Zero(), 0, bench_max(),
+           10.0, 0.01, rng, udist);
+
+  State xhat, xc;
+  xhat.p << 0.5, -0.3, -4.8;
+  xhat.v << 0.2, 0.1, 0.0;
+  xc.p << 1.0, 0.0, -5.0;
+  double throttle;
+
+  for (auto _ : state)
+  {
+    State xc_copy = xc;
+    nlc.computeControl(xhat, xc_copy, 0.004, 0.5, throttle);
+    benchmark::DoNotOptimize(throttle);
+  }
+}
+BENCHMARK(BM_NLCComputeControl);
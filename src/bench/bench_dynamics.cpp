@@ -0,0 +1,59 @@
+#include <benchmark/benchmark.h>
+
+#include "multirotor_sim/dynamics.h"
+#include "bench_common.h"
+
+using namespace multirotor_sim;
+
+static void runDynamics(benchmark::State& state, bool rk4)
+{
+  Dynamics dyn;
+  dyn.load(bench_params());
+  dyn.RK4_ = rk4;
+  const State x0 = dyn.get_state();
+  Vector4d u(dyn.mass_ * G, 0.0, 0.0, 0.0); // hover
+
+  int i = 0;
+  for (auto _ : state)
+  {
+    dyn.run(0.004, u);
+    benchmark::DoNotOptimize(dyn.get_state().arr.data());
+    if (++i == 10000)
+    {
+      dyn.set_state(x0);
+      i = 0;
+    }
+  }
+}
+
+static void BM_DynamicsRunRK4(benchmark::State& state)
+{
+  runDynamics(state, true);
+}
+BENCHMARK(BM_DynamicsRunRK4);
+
+static void BM_DynamicsRunEuler(benchmark::State& state)
+{
+  runDynamics(state, false);
+}
+BENCHMARK(BM_DynamicsRunEuler);
+
+static void BM_DynamicsF(benchmark::State& state)
+{
+  Dynamics dyn;
+  dyn.load(bench_params());
+  State x = dyn.get_state();
+  x.v << 1.0, 0.5, -0.2;
+  x.w << 0.1, -0.1, 0.05;
+  Vector4d u(dyn.mass_ * G, 0.01, -0.01, 0.0);
+  ErrorState dx;
+  Vector6d imu;
+
+  for (auto _ : state)
+  {
+    dyn.f(x, u, dx, imu);
+    benchmark::DoNotOptimize(dx.arr.data());
+    benchmark::DoNotOptimize(imu.data());
+  }
+}
+BENCHMARK(BM_DynamicsF);
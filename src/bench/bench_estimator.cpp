@@ -0,0 +1,80 @@
+#include <memory>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "multirotor_sim/estimator_wrapper.h"
+#include "multirotor_sim/static_estimator.h"
+
+using namespace multirotor_sim;
+
+// IMU pre-integration, about as little work as an estimator does per IMU sample
+class Preintegrator : public EstimatorBase
+{
+public:
+  void imuCallback(const double& t, const Vector6d& z, const Matrix6d& R) override
+  {
+    double dt = t - t_;
+    t_ = t;
+    delta_v_ += z.head<3>() * dt;
+    delta_w_ += z.tail<3>() * dt;
+  }
+  double t_ = 0;
+  Vector3d delta_v_ = Vector3d::Zero();
+  Vector3d delta_w_ = Vector3d::Zero();
+};
+
+class Preintegrator2 : public Preintegrator {};
+class Preintegrator3 : public Preintegrator {};
+
+// Delivery of one IMU sample to three pre-integrators, the way Simulator::update_imu_meas does it
+static void deliver_imu(benchmark::State& state, std::vector<EstimatorBase*> est)
+{
+  benchmark::DoNotOptimize(est.data());
+  Vector6d z = Vector6d::Random();
+  Matrix6d R = Matrix6d::Identity();
+  double t = 0;
+  for (auto _ : state)
+  {
+    t += 0.004;
+    for (size_t i = 0; i < est.size(); i++)
+      est[i]->imuCallback(t, z, R);
+  }
+}
+
+static void BM_ImuDispatchVirtual(benchmark::State& state)
+{
+  Preintegrator a;
+  Preintegrator2 b;
+  Preintegrator3 c;
+  deliver_imu(state, {&a, &b, &c});
+  benchmark::DoNotOptimize(a.delta_v_);
+}
+BENCHMARK(BM_ImuDispatchVirtual);
+
+static void BM_ImuDispatchWrapper(benchmark::State& state)
+{
+  Preintegrator p[3];
+  EstimatorWrapper w[3];
+  std::vector<EstimatorBase*> est;
+  for (int i = 0; i < 3; i++)
+  {
+    Preintegrator* pi = &p[i];
+    w[i].register_imu_cb([pi](const double& t, const Vector6d& z, const Matrix6d& R) { pi->imuCallback(t, z, R); });
+    est.push_back(&w[i]);
+  }
+  deliver_imu(state, est);
+  benchmark::DoNotOptimize(p[0].delta_v_);
+}
+BENCHMARK(BM_ImuDispatchWrapper);
+
+static void BM_ImuDispatchStatic(benchmark::State& state)
+{
+  Preintegrator a;
+  Preintegrator2 b;
+  Preintegrator3 c;
+  StaticEstimators<Preintegrator, Preintegrator2, Preintegrator3> est(a, b, c);
+  deliver_imu(state, {&est});
+  benchmark::DoNotOptimize(a.delta_v_);
+}
+BENCHMARK(BM_ImuDispatchStatic);
@@ -0,0 +1,86 @@
+#include <benchmark/benchmark.h>
+
+#include "multirotor_sim/satellite.h"
+#include "multirotor_sim/wsg84.h"
+#include "bench_common.h"
+
+static void BM_SatelliteComputePositionVelocityClock(benchmark::State& state)
+{
+  std::vector<Satellite> sats = bench_satellites();
+  GTime t = bench_gps_time();
+  Vector3d pos, vel;
+  Vector2d clock;
+
+  for (auto _ : state)
+  {
+    sats[0].computePositionVelocityClock(t, pos, vel, clock);
+    benchmark::DoNotOptimize(pos.data());
+    benchmark::DoNotOptimize(clock.data());
+  }
+}
+BENCHMARK(BM_SatelliteComputePositionVelocityClock);
+
+static void BM_SatelliteComputeMeasurement(benchmark::State& state)
+{
+  std::vector<Satellite> sats = bench_satellites();
+  GTime t = bench_gps_time();
+  Vector3d rec_pos = bench_receiver_ecef();
+  Vector3d rec_vel(1.0, 2.0, 0.5);
+  Vector2d clk(1e-8, 1e-10);
+  Vector3d z;
+
+  for (auto _ : state)
+  {
+    sats[0].computeMeasurement(t, rec_pos, rec_vel, clk, z);
+    benchmark::DoNotOptimize(z.data());
+  }
+}
+BENCHMARK(BM_SatelliteComputeMeasurement);
+
+static void BM_SatelliteIonosphericDelay(benchmark::State& state)
+{
+  std::vector<Satellite> sats = bench_satellites();
+  GTime t = bench_gps_time();
+  Vector3d rec_pos = bench_receiver_ecef();
+  Vector3d lla = WSG84::ecef2lla(rec_pos);
+  Vector2d az_el = sats[0].azimuthElevation(t, rec_pos);
+
+  for (auto _ : state)
+  {
+    double delay = sats[0].ionosphericDelay(t, lla, az_el);
+    benchmark::DoNotOptimize(delay);
+  }
+}
+BENCHMARK(BM_SatelliteIonosphericDelay);
+
+static void BM_WSG84Ecef2Lla(benchmark::State& state)
+{
+  Vector3d ecef = bench_receiver_ecef();
+  Vector3d lla;
+
+  for (auto _ : state)
+  {
+    WSG84::ecef2lla(ecef, lla);
+    benchmark::DoNotOptimize(lla.data());
+  }
+}
+BENCHMARK(BM_WSG84Ecef2Lla);
+
+static void BM_WSG84PointPositioning(benchmark::State& state)
+{
+  std::vector<Satellite> sats = bench_satellites();
+  GTime t = bench_gps_time();
+  Vector3d rec_pos = bench_receiver_ecef();
+  WSG84::VecVec3 z(sats.size());
+  for (int i = 0; i < sats.size(); i++)
+    sats[i].computeMeasurement(t, rec_pos, Vector3d::Zero(), Vector2d::Zero(), z[i]);
+
+  for (auto _ : state)
+  {
+    Vector3d xhat = Vector3d::Zero();
+    bool converged = WSG84::pointPositioning(t, z, sats, xhat);
+    benchmark::DoNotOptimize(converged);
+    benchmark::DoNotOptimize(xhat.data());
+  }
+}
+BENCHMARK(BM_WSG84PointPositioning);
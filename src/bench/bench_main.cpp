@@ -0,0 +1,35 @@
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+// Same as BENCHMARK_MAIN(), but results are also written as JSON to
+// multirotor_sim_bench.json unless another --benchmark_out is given.  Two result
+// files can be compared with tools/compare.py from the google benchmark sources.
+int main(int argc, char** argv)
+{
+  std::string out_arg = "--benchmark_out=multirotor_sim_bench.json";
+  std::string format_arg = "--benchmark_out_format=json";
+  std::vector<char*> args(argv, argv + argc);
+
+  bool has_out = false;
+  for (int i = 1; i < argc; i++)
+  {
+    if (strncmp(argv[i], "--benchmark_out=", 16) == 0)
+      has_out = true;
+  }
+  if (!has_out)
+  {
+    args.push_back(&out_arg[0]);
+    args.push_back(&format_arg[0]);
+  }
+
+  int n = args.size();
+  benchmark::Initialize(&n, args.data());
+  if (benchmark::ReportUnrecognizedArguments(n, args.data()))
+    return 1;
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
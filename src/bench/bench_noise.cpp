@@ -0,0 +1,36 @@
+#include <random>
+
+#include <benchmark/benchmark.h>
+
+#include "multirotor_sim/noise_pool.h"
+
+using namespace Eigen;
+using namespace multirotor_sim;
+
+// The noise of one IMU sample (bias walks and measurement noise), drawn one at a time the way
+// the sensor models used to
+static void BM_ImuNoiseNormalDistribution(benchmark::State& state)
+{
+  std::default_random_engine rng(1);
+  std::normal_distribution<double> normal;
+  Matrix<double, 12, 1> noise;
+  for (auto _ : state)
+  {
+    for (int i = 0; i < 12; i++)
+      noise(i) = normal(rng);
+    benchmark::DoNotOptimize(noise.data());
+  }
+}
+BENCHMARK(BM_ImuNoiseNormalDistribution);
+
+static void BM_ImuNoisePool(benchmark::State& state)
+{
+  NoisePool pool(1);
+  Matrix<double, 12, 1> noise;
+  for (auto _ : state)
+  {
+    noise = Map<const Matrix<double, 12, 1>>(pool.take(12));
+    benchmark::DoNotOptimize(noise.data());
+  }
+}
+BENCHMARK(BM_ImuNoisePool);
@@ -0,0 +1,30 @@
+#include <benchmark/benchmark.h>
+
+#include "multirotor_sim/platform_vehicle.h"
+
+using namespace Eigen;
+using namespace multirotor_sim;
+
+// Building a ten minute sea state at 20 Hz
+static void BM_ShipMotionTable(benchmark::State& state)
+{
+  MotionTable::ShipMotion m;
+  uint64_t seed = 0;
+  for (auto _ : state)
+    benchmark::DoNotOptimize(MotionTable::ship(m, seed++));
+}
+BENCHMARK(BM_ShipMotionTable)->Unit(benchmark::kMillisecond);
+
+// One step of a ship carrying a state.range(0) landmark grid
+static void BM_ShipStep(benchmark::State& state)
+{
+  PlatformVehicle veh(MotionTable::ship(MotionTable::ShipMotion(), 1));
+  veh.set_landmark_grid(state.range(0), state.range(0), 0.25);
+  for (auto _ : state)
+  {
+    veh.step(0.004);
+    benchmark::DoNotOptimize(veh.landmarks().pts);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ShipStep)->Arg(0)->Arg(10)->Arg(32);
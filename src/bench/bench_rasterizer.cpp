@@ -0,0 +1,54 @@
+#include <random>
+
+#include <benchmark/benchmark.h>
+
+#include "multirotor_sim/rasterizer.h"
+
+using namespace Eigen;
+using namespace multirotor_sim;
+
+// A VGA camera 20 m over a block of 200 boxes, looking forward and down at a marker, rendered
+// by state.range(0) threads
+static void BM_RasterizerVGA(benchmark::State& state)
+{
+  Rasterizer r(state.range(0));
+  r.set_ground(0.0);
+  std::default_random_engine gen(1);
+  std::uniform_real_distribution<double> position(-100.0, 100.0);
+  std::uniform_real_distribution<double> size(2.0, 15.0);
+  for (int i = 0; i < 200; i++)
+  {
+    Vector3d lo(position(gen), position(gen), 0.0);
+    Vector3d extent(size(gen), size(gen), -size(gen));
+    Vector3d x = extent.x() * Vector3d::UnitX(), y = extent.y() * Vector3d::UnitY(), z = extent.z() * Vector3d::UnitZ();
+    r.add_quad(lo, x, z, Rasterizer::WALL);
+    r.add_quad(lo, y, z, Rasterizer::WALL);
+    r.add_quad(lo + x, y, z, Rasterizer::WALL);
+    r.add_quad(lo + y, x, z, Rasterizer::WALL);
+    r.add_quad(lo + z, x, y, Rasterizer::WALL);
+  }
+  r.add_quad(Vector3d(-80, -1, 0), Vector3d(0, 2, 0), Vector3d(2, 0, 0), Rasterizer::MARKER);
+
+  Camera<double> cam;
+  cam.focal_len_ << 320.0, 320.0;
+  cam.cam_center_ << 320.0, 240.0;
+  cam.image_size_ << 640.0, 480.0;
+  cam.distortion_.setZero();
+  cam.s_ = 0.0;
+  // Looking north, pitched 30 degrees down
+  Matrix3d R_c2I;
+  R_c2I << 0, -0.5, 0.866, 1, 0, 0, 0, 0.866, 0.5;
+  Quaterniond q(R_c2I);
+  Matrix<double, 7, 1> arr;
+  arr << -100, 0, -20, q.w(), q.x(), q.y(), q.z();
+
+  GrayImage img;
+  for (auto _ : state)
+  {
+    arr(0) += 0.1;
+    r.render(xform::Xformd(arr), cam, img);
+    benchmark::DoNotOptimize(img.pixels.data());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_RasterizerVGA)->Arg(1)->Arg(2)->UseRealTime();
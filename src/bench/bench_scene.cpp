@@ -0,0 +1,95 @@
+#include <random>
+
+#include <benchmark/benchmark.h>
+
+#include "multirotor_sim/scene.h"
+
+using namespace Eigen;
+using namespace multirotor_sim;
+
+// A block of city: boxes on a 200 m square, seen from 20 m up
+static Scene bench_scene(int num_boxes)
+{
+  std::default_random_engine gen(1);
+  std::uniform_real_distribution<double> position(-100.0, 100.0);
+  std::uniform_real_distribution<double> size(2.0, 15.0);
+  Scene scene;
+  scene.set_ground(0.0);
+  for (int i = 0; i < num_boxes; i++)
+  {
+    Vector3d lo(position(gen), position(gen), 0.0);
+    Vector3d hi = lo + Vector3d(size(gen), size(gen), 0.0);
+    lo.z() = -size(gen);
+    scene.add_box(lo, hi);
+  }
+  scene.build();
+  return scene;
+}
+
+// A 64 x 48 grid of camera rays, looking down and forward
+static Matrix3Xd bench_rays()
+{
+  Matrix3Xd dirs(3, 64 * 48);
+  for (int v = 0; v < 48; v++)
+  {
+    for (int u = 0; u < 64; u++)
+    {
+      dirs.col(v * 64 + u) << 1.0, (u - 32) / 40.0, 0.2 + v / 60.0;
+      dirs.col(v * 64 + u).normalize();
+    }
+  }
+  return dirs;
+}
+
+static void BM_SceneCastSingle(benchmark::State& state)
+{
+  Scene scene = bench_scene(state.range(0));
+  Matrix3Xd dirs = bench_rays();
+  Vector3d origin(-100, 0, -20);
+  VectorXd ranges(dirs.cols());
+  for (auto _ : state)
+  {
+    for (Index i = 0; i < dirs.cols(); i++)
+    {
+      if (!scene.cast(origin, dirs.col(i), 500.0, ranges[i]))
+        ranges[i] = 0;
+    }
+    benchmark::DoNotOptimize(ranges.data());
+  }
+  state.SetItemsProcessed(state.iterations() * dirs.cols());
+}
+BENCHMARK(BM_SceneCastSingle)->Arg(100)->Arg(2000);
+
+static void BM_SceneCastPacket(benchmark::State& state)
+{
+  Scene scene = bench_scene(state.range(0));
+  Matrix3Xd dirs = bench_rays();
+  Vector3d origin(-100, 0, -20);
+  VectorXd ranges(dirs.cols());
+  for (auto _ : state)
+  {
+    scene.cast(origin, dirs, 500.0, ranges);
+    benchmark::DoNotOptimize(ranges.data());
+  }
+  state.SetItemsProcessed(state.iterations() * dirs.cols());
+}
+BENCHMARK(BM_SceneCastPacket)->Arg(100)->Arg(2000);
+
+// Landmarks on the ground along the same rays, most of them behind a box
+static void BM_SceneOccluded(benchmark::State& state)
+{
+  Scene scene = bench_scene(state.range(0));
+  Matrix3Xd dirs = bench_rays();
+  Vector3d origin(-100, 0, -20);
+  Matrix3Xd points(3, dirs.cols());
+  for (Index i = 0; i < dirs.cols(); i++)
+    points.col(i) = origin + dirs.col(i) * (-origin.z() / dirs(2, i));
+  Array<bool, Dynamic, 1> blocked(points.cols());
+  for (auto _ : state)
+  {
+    scene.occluded(origin, points.data(), points.cols(), blocked.data());
+    benchmark::DoNotOptimize(blocked.data());
+  }
+  state.SetItemsProcessed(state.iterations() * points.cols());
+}
+BENCHMARK(BM_SceneOccluded)->Arg(100)->Arg(2000);
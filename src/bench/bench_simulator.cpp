@@ -0,0 +1,204 @@
+#include <memory>
+
+#include <benchmark/benchmark.h>
+
+#include "multirotor_sim/simulator.h"
+#include "multirotor_sim/environment.h"
+#include "multirotor_sim/recorder.h"
+#include "bench_common.h"
+
+using namespace multirotor_sim;
+
+static void BM_EnvironmentAddPoint(benchmark::State& state)
+{
+  std::unique_ptr<Environment> env(new Environment(1));
+  env->load(bench_params());
+  Vector3d t_I_c(0, 0, -5);
+  Quatd q_I_c = Quatd::Identity();
+  Vector3d zeta;
+  Vector2d pix;
+  double depth;
+
+  for (auto _ : state)
+  {
+    int id = env->add_point(t_I_c, q_I_c, zeta, pix, depth);
+    benchmark::DoNotOptimize(id);
+    if (env->get_points().size() >= 100000)
+    {
+      state.PauseTiming();
+      env.reset(new Environment(1));
+      env->load(bench_params());
+      state.ResumeTiming();
+    }
+  }
+}
+BENCHMARK(BM_EnvironmentAddPoint);
+
+static void BM_EnvironmentGetClosestPoints(benchmark::State& state)
+{
+  Environment env(1);
+  env.load(bench_params());
+  Vector3d t_I_c(0, 0, -5);
+  Quatd q_I_c = Quatd::Identity();
+  Vector3d zeta;
+  Vector2d pix;
+  double depth;
+  while (env.get_points().size() < state.range(0))
+    env.add_point(t_I_c, q_I_c, zeta, pix, depth);
+
+  size_t ids[50];
+  double dist_sqr[50];
+  Vector3d query(0.5, -0.5, 0);
+
+  for (auto _ : state)
+  {
+    size_t found = env.get_closest_points(query, 50, 2.0, ids, dist_sqr);
+    benchmark::DoNotOptimize(found);
+  }
+}
+BENCHMARK(BM_EnvironmentGetClosestPoints)->Arg(1000)->Arg(100000);
+
+static void BM_EnvironmentGetPointsWithin(benchmark::State& state)
+{
+  Environment env(1);
+  env.load(bench_params());
+  Vector3d t_I_c(0, 0, -5);
+  Quatd q_I_c = Quatd::Identity();
+  Vector3d zeta;
+  Vector2d pix;
+  double depth;
+  while (env.get_points().size() < state.range(0))
+    env.add_point(t_I_c, q_I_c, zeta, pix, depth);
+
+  size_t ids[50];
+  double dist_sqr[50];
+  Vector3d query(0.5, -0.5, 0);
+
+  for (auto _ : state)
+  {
+    size_t found = env.get_points_within(query, 2.0, 50, ids, dist_sqr);
+    benchmark::DoNotOptimize(found);
+  }
+}
+BENCHMARK(BM_EnvironmentGetPointsWithin)->Arg(1000)->Arg(100000);
+
+// Landmarks spread over a square kilometre, seen from a tilted camera
+static void BM_EnvironmentQueryFrustum(benchmark::State& state)
+{
+  Environment env(1);
+  env.load(bench_params());
+  std::default_random_engine gen(1);
+  std::uniform_real_distribution<double> uniform(-500.0, 500.0);
+  Vector3d zeta;
+  Vector2d pix;
+  double depth;
+  while (env.get_points().size() < state.range(0))
+    env.add_point(Vector3d(uniform(gen), uniform(gen), -5), Quatd::Identity(), zeta, pix, depth);
+
+  Camera<double> cam;
+  cam.focal_len_ << 250.0, 250.0;
+  cam.cam_center_ << 320.0, 240.0;
+  cam.image_size_ << 640.0, 480.0;
+  cam.distortion_.setZero();
+  cam.s_ = 0.0;
+  Xformd x_I2c(Vector3d(0, 0, -5), Quatd::from_axis_angle(Vector3d::UnitX(), 0.6));
+  vector<size_t> ids;
+
+  for (auto _ : state)
+  {
+    size_t found = env.query_frustum(x_I2c, cam, ids);
+    benchmark::DoNotOptimize(found);
+  }
+}
+BENCHMARK(BM_EnvironmentQueryFrustum)->Arg(1000)->Arg(100000);
+
+// One full Simulator::run() step with every sensor enabled.  The loop
+// is restarted every simulated minute so the trajectory stays representative.
+static void BM_SimulatorRunAllSensors(benchmark::State& state)
+{
+  std::unique_ptr<Simulator> sim(new Simulator(false, 1));
+  sim->load(bench_params());
+  EstimatorBase est;
+  sim->register_estimator(&est);
+
+  for (auto _ : state)
+  {
+    if (sim->t_ > 60.0)
+    {
+      state.PauseTiming();
+      sim.reset(new Simulator(false, 1));
+      sim->load(bench_params());
+      sim->register_estimator(&est);
+      state.ResumeTiming();
+    }
+    sim->run();
+  }
+}
+BENCHMARK(BM_SimulatorRunAllSensors);
+
+// Replay of 10 simulated seconds of every sensor into an estimator, to compare against
+// regenerating the same measurements with BM_SimulatorRunAllSensors
+static void BM_ReplayAllSensors(benchmark::State& state)
+{
+  BenchTempFile rec_file("rec");
+  const std::string& filename = rec_file.path();
+  {
+    std::unique_ptr<Simulator> sim(new Simulator(false, 1));
+    sim->load(bench_params());
+    MeasurementRecorder rec;
+    rec.open(filename);
+    sim->register_estimator(&rec);
+    while (sim->t_ < 10.0)
+      sim->run();
+  }
+
+  MeasurementReplayer replay;
+  replay.open(filename);
+  EstimatorBase est;
+  replay.register_estimator(&est);
+  uint64_t records = 0;
+  for (auto _ : state)
+  {
+    replay.rewind();
+    records += replay.run();
+  }
+  state.SetItemsProcessed(records);
+}
+BENCHMARK(BM_ReplayAllSensors)->Unit(benchmark::kMillisecond);
+
+// Stands in for an estimator whose IMU propagation takes a while
+class SlowEstimator : public EstimatorBase
+{
+public:
+  void imuCallback(const double& t, const Vector6d& z, const Matrix6d& R) override
+  {
+    for (int i = 0; i < 200; i++)
+      P_ = (P_ * 0.5 + R * 0.5).eval();
+    benchmark::DoNotOptimize(P_.data());
+  }
+  Matrix6d P_ = Matrix6d::Identity();
+};
+
+// One simulated second with three slow estimators, for each Simulator::EstimatorDispatch
+static void BM_ThreeEstimators(benchmark::State& state)
+{
+  SlowEstimator est[3];
+  for (auto _ : state)
+  {
+    state.PauseTiming();
+    std::unique_ptr<Simulator> sim(new Simulator(false, 1));
+    sim->load(bench_params());
+    sim->set_estimator_dispatch((Simulator::EstimatorDispatch)state.range(0));
+    for (int i = 0; i < 3; i++)
+      sim->register_estimator(&est[i]);
+    state.ResumeTiming();
+    while (sim->t_ < 1.0)
+      sim->run();
+    sim->wait_for_estimators();
+  }
+}
+BENCHMARK(BM_ThreeEstimators)
+    ->Arg(Simulator::DISPATCH_SYNC)
+    ->Arg(Simulator::DISPATCH_BARRIER)
+    ->Arg(Simulator::DISPATCH_FREE_RUNNING)
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
@@ -0,0 +1,35 @@
+#include <benchmark/benchmark.h>
+
+#include "multirotor_sim/turbulence.h"
+
+using namespace Eigen;
+using namespace multirotor_sim;
+
+// Synthesizing a state.range(0)^3 field
+static void BM_TurbulenceGenerate(benchmark::State& state)
+{
+  TurbulenceField::Params params;
+  params.size = state.range(0);
+  uint64_t seed = 0;
+  for (auto _ : state)
+  {
+    TurbulenceField field(params, seed++);
+    benchmark::DoNotOptimize(field.node(0, 0, 0));
+  }
+}
+BENCHMARK(BM_TurbulenceGenerate)->Arg(32)->Arg(64)->Unit(benchmark::kMillisecond);
+
+// The wind along a flight through a 64^3 field, one sample per step
+static void BM_TurbulenceSample(benchmark::State& state)
+{
+  std::shared_ptr<const TurbulenceField> field = TurbulenceField::shared(TurbulenceField::Params(), 1);
+  Vector3d p(0.0, 0.0, -10.0);
+  const Vector3d step(0.02, 0.013, -0.001);
+  for (auto _ : state)
+  {
+    p += step;
+    benchmark::DoNotOptimize(field->sample(p));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TurbulenceSample);
@@ -61,6 +61,14 @@ void ReferenceController::computeControl(const double& t, const State &x, const
   s_prev_ = throttle;
 }
 
+void ReferenceController::reseed(uint64_t seed)
+{
+  rng_.seed(seed);
+  udist_.reset();
+  nlc_.rng_ = rng_;
+  nlc_.udist_ = udist_;
+}
+
 void ReferenceController::load(const std::string filename)
 {
   if(file_exists(filename))
@@ -3,7 +3,16 @@
 
 namespace multirotor_sim
 {
-Dynamics::Dynamics() {}
+Dynamics::Dynamics() :
+  wind_enabled_(false),
+  vw_(Vector3d::Zero()),
+  vw_mean_(Vector3d::Zero()),
+  t_(0.0),
+  turbulence_offset_(Vector3d::Zero()),
+  gust_rate_(0.0),
+  gust_stdev_(0.0),
+  gust_duration_(0.0)
+{}
 
 
 void Dynamics::load(std::string filename)
@@ -27,9 +36,9 @@ void Dynamics::load(std::string filename)
   get_yaml_node("wind_init_stdev", filename, vw_init_var);
   get_yaml_node("wind_walk_stdev", filename, vw_walk_stdev_);
   get_yaml_node("enable_wind", filename, wind_enabled_);
-  vw_ = vw_init_var * Eigen::Vector3d::Random();
+  vw_mean_ = vw_init_var * Eigen::Vector3d::Random();
   if (!wind_enabled_)
-    vw_.setZero();
+    vw_mean_.setZero();
 
   int seed;
   get_yaml_node("seed", filename, seed);
@@ -37,6 +46,33 @@ void Dynamics::load(std::string filename)
     seed = std::chrono::system_clock::now().time_since_epoch().count();
   rng_ = std::default_random_engine(seed);
 
+  // Turbulence is made once per field seed and shared by every simulator using it
+  int turbulence_model = 0;
+  int turbulence_seed = -1;
+  TurbulenceField::Params turbulence;
+  get_yaml_node("wind_turbulence", filename, turbulence_model, false);
+  get_yaml_node("wind_turbulence_stdev", filename, turbulence.stdev, false);
+  get_yaml_node("wind_turbulence_length", filename, turbulence.length_scale, false);
+  get_yaml_node("wind_turbulence_grid_size", filename, turbulence.size, false);
+  get_yaml_node("wind_turbulence_cell_size", filename, turbulence.cell_size, false);
+  get_yaml_node("wind_turbulence_seed", filename, turbulence_seed, false);
+  turbulence_.reset();
+  if (wind_enabled_ && turbulence_model > 0)
+  {
+    turbulence.model = turbulence_model == 1 ? TurbulenceField::DRYDEN : TurbulenceField::VON_KARMAN;
+    turbulence_ = TurbulenceField::shared(turbulence, turbulence_seed < 0 ? seed : turbulence_seed);
+  }
+
+  gust_rate_ = 0.0;
+  gust_stdev_ = 1.0;
+  gust_duration_ = 2.0;
+  get_yaml_node("wind_gust_rate", filename, gust_rate_, false);
+  get_yaml_node("wind_gust_stdev", filename, gust_stdev_, false);
+  get_yaml_node("wind_gust_duration", filename, gust_duration_, false);
+  if (!wind_enabled_)
+    gust_rate_ = 0.0;
+  gust_ = Gust();
+
   Vector3d inertia_diag;
   get_yaml_eigen("x0", filename, x_.arr);
   if (get_yaml_eigen<Vector3d>("inertia", filename, inertia_diag))
@@ -44,6 +80,10 @@ void Dynamics::load(std::string filename)
     inertia_matrix_ = inertia_diag.asDiagonal();
     inertia_inv_ = inertia_matrix_.inverse();
   }
+
+  t_ = 0.0;
+  turbulence_offset_.setZero();
+  update_wind(0.0);
 }
 
 // u = [F(N), Taux(N-m), Tauy, Tauz]
@@ -101,7 +141,31 @@ void Dynamics::run(const double dt, const Vector4d &u)
   // Update wind velocity for next iteration
   if (wind_enabled_)
   {
-    vw_ += randomNormal<Eigen::Vector3d>(vw_walk_stdev_, standard_normal_dist_, rng_) * dt;
+    vw_mean_ += randomNormal<Eigen::Vector3d>(vw_walk_stdev_, standard_normal_dist_, rng_) * dt;
+    update_wind(dt);
+  }
+}
+
+// The turbulence is frozen, blown past by the mean wind.  Gusts come at random, one at a time,
+// the wait for the next drawn as each one ends.
+void Dynamics::update_wind(double dt)
+{
+  t_ += dt;
+  vw_ = vw_mean_;
+  if (turbulence_)
+  {
+    turbulence_offset_ += vw_mean_ * dt;
+    vw_ += turbulence_->sample(x_.p - turbulence_offset_);
+  }
+  if (gust_rate_ > 0.0)
+  {
+    if (t_ >= gust_.start + gust_.duration)
+    {
+      gust_.start = t_ + std::exponential_distribution<double>(gust_rate_)(rng_);
+      gust_.duration = gust_duration_;
+      gust_.amplitude = randomNormal<Eigen::Vector3d>(gust_stdev_, standard_normal_dist_, rng_);
+    }
+    vw_ += gust_.velocity(t_);
   }
 }
 
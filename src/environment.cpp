@@ -1,3 +1,8 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
 #include "geometry/support.h"
 #include "nanoflann_eigen/nanoflann_eigen.h"
 
@@ -5,9 +10,78 @@
 
     
 Environment::Environment(int seed)
-  : uniform_(-1.0, 1.0),
+  : kd_tree_(nullptr),
+    grid_cell_size_(2.0),
+    map_ids_(0),
+    seed_(seed),
+    tile_size_(0.0),
+    tile_landmarks_(200),
+    tile_radius_(100.0),
+    max_tiles_(100),
+    tile_clock_(0),
+    uniform_(-1.0, 1.0),
     generator_(seed)
-{}
+{
+  floor_level_ = 0;
+  scene_.set_ground(0.0);
+}
+
+Environment::Environment(const Environment& other)
+  : kd_tree_(nullptr)
+{
+  *this = other;
+}
+
+Environment& Environment::operator=(const Environment& other)
+{
+  if (this == &other)
+    return *this;
+  point_idx_ = other.point_idx_;
+  points_ = other.points_;
+  generator_ = other.generator_;
+  uniform_ = other.uniform_;
+  normal_ = other.normal_;
+  floor_level_ = other.floor_level_;
+  scene_ = other.scene_;
+  max_offset_ = other.max_offset_;
+  img_size_ = other.img_size_;
+  img_center_ = other.img_center_;
+  finv_ = other.finv_;
+  grid_cell_size_ = other.grid_cell_size_;
+  grid_ = other.grid_;
+  map_ = other.map_;
+  map_ids_ = other.map_ids_;
+  seed_ = other.seed_;
+  tile_size_ = other.tile_size_;
+  tile_landmarks_ = other.tile_landmarks_;
+  tile_radius_ = other.tile_radius_;
+  max_tiles_ = other.max_tiles_;
+  tiles_ = other.tiles_;
+  tile_clock_ = other.tile_clock_;
+
+  // The tree indexes points_ by reference, so it can't be shared with other
+  delete kd_tree_;
+  kd_tree_ = nullptr;
+  if (other.kd_tree_)
+  {
+    kd_tree_ = new KDTree3d(3, points_, 10);
+    if (!points_.pts.empty())
+      kd_tree_->addPoints(0, points_.pts.size() - 1);
+  }
+  return *this;
+}
+
+Environment::~Environment()
+{
+  delete kd_tree_;
+}
+
+void Environment::reseed(uint64_t seed)
+{
+  generator_.seed(seed);
+  uniform_.reset();
+  normal_.reset();
+}
 
 void Environment::load(string filename)
 {
@@ -17,19 +91,148 @@ void Environment::load(string filename)
   get_yaml_eigen("focal_len", filename, focal_len);
   get_yaml_eigen("cam_center", filename, img_center_);
   finv_ = focal_len.cwiseInverse();
+  get_yaml_node("landmark_grid_cell_size", filename, grid_cell_size_, false);
+  if (grid_cell_size_ <= 0)
+    throw std::runtime_error("landmark_grid_cell_size must be positive");
+  get_yaml_node("world_tile_size", filename, tile_size_, false);
+  get_yaml_node("world_tile_landmarks", filename, tile_landmarks_, false);
+  get_yaml_node("world_tile_radius", filename, tile_radius_, false);
+  get_yaml_node("world_max_tiles", filename, max_tiles_, false);
+  if (tiled())
+  {
+    if (tile_landmarks_ <= 0)
+      throw std::runtime_error("world_tile_landmarks must be positive");
+    // Every tile around the camera has to fit at once
+    int span = (int)std::ceil(2.0 * tile_radius_ / tile_size_) + 1;
+    if (span * span > max_tiles_)
+      throw std::runtime_error("world_max_tiles is less than the " + std::to_string(span * span)
+                               + " tiles within world_tile_radius");
+  }
 
   int seed;
   get_yaml_node("seed", filename, seed);
   if (seed == 0)
     seed = std::chrono::system_clock::now().time_since_epoch().count();
   generator_ = std::default_random_engine(seed);
+  seed_ = seed;
   srand(seed);
 
   point_idx_ = 0;
   floor_level_ = 0;
+
+  load_scene(filename);
+
+  delete kd_tree_;
+  kd_tree_ = new KDTree3d(3, points_, 10);
+  grid_.clear();
+  tiles_.clear();
+  tile_clock_ = 0;
+  map_.reset();
+  map_ids_ = 0;
+
+  std::string map_filename;
+  if (get_yaml_node("landmark_map_filename", filename, map_filename, false) && !map_filename.empty())
+    open_map(map_filename);
+}
+
+// Obstacles, as flat lists of numbers (see params/sim_params.yaml)
+void Environment::load_scene(string filename)
+{
+  std::vector<double> walls, boxes;
+  get_yaml_node("walls", filename, walls, false);
+  get_yaml_node("boxes", filename, boxes, false);
+  if (walls.size() % 8 != 0 || boxes.size() % 6 != 0)
+    throw std::runtime_error("walls need 8 numbers each and boxes 6, in " + filename);
+  scene_.clear();
+  scene_.set_ground(floor_level_);
+  for (size_t i = 0; i < walls.size(); i += 8)
+    scene_.add_wall(Map<Vector3d>(&walls[i]), Map<Vector3d>(&walls[i+3]), walls[i+6], walls[i+7]);
+  for (size_t i = 0; i < boxes.size(); i += 6)
+    scene_.add_box(Map<Vector3d>(&boxes[i]), Map<Vector3d>(&boxes[i+3]));
+  scene_.build();
+}
+
+void Environment::open_map(const string& filename)
+{
+  if (tiled())
+    throw std::runtime_error("A tiled world can't also use a landmark map");
+  map_ = std::make_shared<multirotor_sim::LandmarkMap>(filename);
+  map_ids_ = map_->id_count();
+  grid_cell_size_ = map_->cell_size();
+
+  // The map replaces the points so far
+  points_.pts.clear();
+  point_idx_ = 0;
+  grid_.clear();
+  delete kd_tree_;
   kd_tree_ = new KDTree3d(3, points_, 10);
 }
 
+void Environment::save_map(const string& filename) const
+{
+  if (tiled())
+    throw std::runtime_error("A tiled world is generated, it can't be saved");
+
+  struct Entry
+  {
+    uint64_t key;
+    uint64_t id;
+    Vector3i index;
+    Vector3d pt;
+    bool operator<(const Entry& other) const
+    {
+      return key < other.key || (key == other.key && id < other.id);
+    }
+  };
+  std::vector<Entry> entries;
+  Entry e;
+  for (auto it = grid_.begin(); it != grid_.end(); ++it)
+  {
+    e.key = it->first;
+    e.index = it->second.index;
+    for (size_t k = 0; k < it->second.ids.size(); k++)
+    {
+      e.id = it->second.ids[k];
+      e.pt = it->second.pts[k];
+      entries.push_back(e);
+    }
+  }
+  for (size_t c = 0; map_ && c < map_->num_cells(); c++)
+  {
+    const multirotor_sim::LandmarkMap::Cell& cell = map_->cells()[c];
+    e.key = cell.key;
+    e.index = Map<const Vector3i>(cell.index);
+    for (uint64_t k = cell.begin; k < cell.begin + cell.count; k++)
+    {
+      e.id = map_->ids()[k];
+      e.pt = Map<const Vector3d>(map_->points() + 3 * k);
+      entries.push_back(e);
+    }
+  }
+  std::sort(entries.begin(), entries.end());
+
+  std::vector<multirotor_sim::LandmarkMap::Cell> cells;
+  std::vector<double> points;
+  std::vector<uint64_t> ids;
+  for (size_t i = 0; i < entries.size(); i++)
+  {
+    if (cells.empty() || cells.back().key != entries[i].key)
+    {
+      multirotor_sim::LandmarkMap::Cell cell;
+      cell.key = entries[i].key;
+      Map<Vector3i>(cell.index) = entries[i].index;
+      cell.reserved = 0;
+      cell.begin = i;
+      cell.count = 0;
+      cells.push_back(cell);
+    }
+    cells.back().count++;
+    points.insert(points.end(), entries[i].pt.data(), entries[i].pt.data() + 3);
+    ids.push_back(entries[i].id);
+  }
+  multirotor_sim::LandmarkMap::write(filename, grid_cell_size_, cells, points, ids);
+}
+
 bool Environment::get_center_img_center_on_ground_plane(const Xformd& x_I2c, Vector3d& point)
 {
   Vector3d zeta_I = x_I2c.rota(e_z);
@@ -48,7 +251,7 @@ bool Environment::get_center_img_center_on_ground_plane(const Xformd& x_I2c, Vec
 int Environment::add_point(const Vector3d& t_I_c, const Quatd& q_I_c, Vector3d& zeta, Vector2d& pix, double& depth)
 {
   // Choose a random pixel (assume that image center is at center of camera)
-  pix.setRandom();
+  pix << uniform_(generator_), uniform_(generator_);
   pix = 0.45 * pix.cwiseProduct(img_size_); // stay away from the edges of image
 
   // Calculate the Unit Vector
@@ -60,9 +263,14 @@ int Environment::add_point(const Vector3d& t_I_c, const Quatd& q_I_c, Vector3d&
   // Rotate the Unit vector into inertial coordatines
   Vector3d zeta_I = q_I_c.rota(zeta);
 
-  // Find where zeta crosses the floor
-  double h = -1.0 * (t_I_c(2) + uniform_(generator_) * max_offset_);
-  depth = h / (zeta_I(2));
+  // Find where zeta meets the scene.  Points on the floor are spread about it, by moving the
+  // floor up or down by up to max_offset_ for each one.
+  double offset = uniform_(generator_) * max_offset_;
+  int surface;
+  if (!scene_.cast(t_I_c, zeta_I, std::numeric_limits<double>::infinity(), depth, &surface))
+    return -1;
+  if (surface == multirotor_sim::Scene::GROUND)
+    depth = -(t_I_c(2) - floor_level_ + offset) / zeta_I(2);
   if (depth < 0.5 || depth > 100.0 )
   {
     return -1;
@@ -73,30 +281,464 @@ int Environment::add_point(const Vector3d& t_I_c, const Quatd& q_I_c, Vector3d&
     Vector3d new_point = t_I_c + depth * zeta_I;
     points_.pts.push_back(new_point);
     kd_tree_->addPoints(idx, idx);
-    return idx;
+    grid_insert(map_ids_ + idx, new_point);
+    return map_ids_ + idx;
   }
 }
 
+namespace
+{
+
+// nanoflann result set for the k nearest points within a radius.  Like nanoflann's KNNResultSet,
+// kept sorted by insertion, but the radius bounds the search until k points are found.
+class BoundedKNNResultSet
+{
+public:
+  BoundedKNNResultSet(size_t capacity, double radius_sqr, size_t* indices, double* dists) :
+    capacity_(capacity), count_(0), radius_sqr_(radius_sqr), indices_(indices), dists_(dists)
+  {}
+
+  void init() { count_ = 0; }
+  size_t size() const { return count_; }
+  bool full() const { return count_ == capacity_; }
+  double worstDist() const { return full() ? dists_[capacity_ - 1] : radius_sqr_; }
+
+  bool addPoint(double dist, size_t index)
+  {
+    if (dist >= worstDist())
+      return true;
+    size_t i = count_ < capacity_ ? count_++ : capacity_ - 1;
+    for (; i > 0 && dists_[i - 1] > dist; i--)
+    {
+      dists_[i] = dists_[i - 1];
+      indices_[i] = indices_[i - 1];
+    }
+    dists_[i] = dist;
+    indices_[i] = index;
+    return true;
+  }
+
+private:
+  size_t capacity_;
+  size_t count_;
+  double radius_sqr_;
+  size_t* indices_;
+  double* dists_;
+};
+
+// nanoflann result set for every point within a radius, into a fixed array rather than
+// RadiusResultSet's growing vector of pairs.  Stops the search once the array is full.
+class BoundedRadiusResultSet
+{
+public:
+  BoundedRadiusResultSet(size_t capacity, double radius_sqr, size_t* indices, double* dists) :
+    capacity_(capacity), count_(0), radius_sqr_(radius_sqr), indices_(indices), dists_(dists)
+  {}
+
+  void init() { count_ = 0; }
+  size_t size() const { return count_; }
+  bool full() const { return count_ == capacity_; }
+  double worstDist() const { return radius_sqr_; }
+
+  bool addPoint(double dist, size_t index)
+  {
+    if (dist < radius_sqr_ && count_ < capacity_)
+    {
+      indices_[count_] = index;
+      dists_[count_] = dist;
+      count_++;
+    }
+    return count_ < capacity_;
+  }
+
+private:
+  size_t capacity_;
+  size_t count_;
+  double radius_sqr_;
+  size_t* indices_;
+  double* dists_;
+};
+
+}
+
 bool Environment::get_closest_points(const Vector3d& query_pt,
       int num_pts, double max_dist, vector<Vector3d, aligned_allocator<Vector3d>>& pts, vector<size_t>& ids)
 {
-  std::vector<size_t> ret_index(num_pts);
+  ids.resize(num_pts);
   std::vector<double> dist_sqr(num_pts);
-  nanoflann::KNNResultSet<double> resultSet(num_pts);
-  resultSet.init(&ret_index[0], &dist_sqr[0]);
-  kd_tree_->findNeighbors(resultSet, query_pt.data(), nanoflann::SearchParams(10));
+  ids.resize(get_closest_points(query_pt, num_pts, max_dist, ids.data(), dist_sqr.data()));
 
   pts.clear();
+  for (size_t i = 0; i < ids.size(); i++)
+    pts.push_back(get_point(ids[i]));
+  return pts.size() > 0;
+}
+
+size_t Environment::get_closest_points(const Vector3d& query_pt, size_t capacity, double max_dist,
+                                       size_t* ids, double* dist_sqr) const
+{
+  if (capacity == 0)
+    return 0;
+  BoundedKNNResultSet result(capacity, max_dist*max_dist, ids, dist_sqr);
+  if (tiled() || map_)
+    grid_search(query_pt, max_dist, result);
+  else
+    kd_tree_->findNeighbors(result, query_pt.data(), nanoflann::SearchParams(10));
+  return result.size();
+}
+
+size_t Environment::get_points_within(const Vector3d& query_pt, double max_dist, size_t capacity,
+                                      size_t* ids, double* dist_sqr) const
+{
+  if (capacity == 0)
+    return 0;
+  BoundedRadiusResultSet result(capacity, max_dist*max_dist, ids, dist_sqr);
+  if (tiled() || map_)
+    grid_search(query_pt, max_dist, result);
+  else
+    kd_tree_->findNeighbors(result, query_pt.data(), nanoflann::SearchParams(10));
+  return result.size();
+}
+
+// 21 bits of each coordinate, so the grid only aliases cells millions of cells apart
+static inline uint64_t grid_key(const Vector3i& index)
+{
+  return ((uint64_t)(index(0) & 0x1FFFFF) << 42)
+       | ((uint64_t)(index(1) & 0x1FFFFF) << 21)
+       |  (uint64_t)(index(2) & 0x1FFFFF);
+}
+
+void Environment::grid_insert(size_t id, const Vector3d& pt)
+{
+  Vector3i index = (pt / grid_cell_size_).array().floor().cast<int>();
+  GridCell& cell = grid_[grid_key(index)];
+  cell.index = index;
+  cell.ids.push_back(id);
+  cell.pts.push_back(pt);
+}
+
+void Environment::grid_erase(size_t id, const Vector3d& pt)
+{
+  Vector3i index = (pt / grid_cell_size_).array().floor().cast<int>();
+  auto it = grid_.find(grid_key(index));
+  if (it == grid_.end())
+    return;
+  GridCell& cell = it->second;
+  for (size_t k = 0; k < cell.ids.size(); k++)
+  {
+    if (cell.ids[k] != id)
+      continue;
+    cell.ids[k] = cell.ids.back();
+    cell.pts[k] = cell.pts.back();
+    cell.ids.pop_back();
+    cell.pts.pop_back();
+    break;
+  }
+  if (cell.ids.empty())
+    grid_.erase(it);
+}
+
+// Offers the points of a cell to a nanoflann-style result set, false once it wants no more
+template <typename ResultSet>
+static bool offer_cell(const Vector3d& query_pt, const uint64_t* ids, const double* pts, size_t n,
+                       ResultSet& result)
+{
+  for (size_t k = 0; k < n; k++)
+  {
+    double dist = (Map<const Vector3d>(pts + 3 * k) - query_pt).squaredNorm();
+    if (dist < result.worstDist() && !result.addPoint(dist, ids[k]))
+      return false;
+  }
+  return true;
+}
+
+// Offers every point of the cells within max_dist of query_pt to a nanoflann-style result set,
+// for the queries in a tiled world or over a landmark map, which have no kd-tree
+template <typename ResultSet>
+void Environment::grid_search(const Vector3d& query_pt, double max_dist, ResultSet& result) const
+{
+  const Vector3i lo = ((query_pt.array() - max_dist) / grid_cell_size_).floor().cast<int>();
+  const Vector3i hi = ((query_pt.array() + max_dist) / grid_cell_size_).floor().cast<int>();
+  Vector3i index;
+  for (index(0) = lo(0); index(0) <= hi(0); index(0)++)
+    for (index(1) = lo(1); index(1) <= hi(1); index(1)++)
+      for (index(2) = lo(2); index(2) <= hi(2); index(2)++)
+      {
+        uint64_t key = grid_key(index);
+        auto it = grid_.find(key);
+        if (it != grid_.end()
+            && !offer_cell(query_pt, it->second.ids.data(), it->second.pts[0].data(), it->second.ids.size(), result))
+          return;
+        const multirotor_sim::LandmarkMap::Cell* cell = map_ ? map_->find(key) : nullptr;
+        if (cell && !offer_cell(query_pt, map_->ids() + cell->begin, map_->points() + 3 * cell->begin,
+                                cell->count, result))
+          return;
+      }
+}
+
+// Tiles are keyed like grid cells, on a plane
+static inline uint64_t tile_key(const Vector2i& index)
+{
+  return ((uint64_t)(uint32_t)index(0) << 32) | (uint32_t)index(1);
+}
+
+// The splitmix64 finalizer, to hash the seed, tile and landmark into independent bits
+static inline uint64_t mix(uint64_t z)
+{
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+Vector3d Environment::tile_point(const Vector2i& index, int i) const
+{
+  // Each coordinate from its own hash, so a landmark doesn't depend on the others in the tile
+  uint64_t h = mix(mix(seed_ + 0x9e3779b97f4a7c15ull) ^ tile_key(index)) ^ (uint64_t)i;
+  Vector3d u;
+  for (int j = 0; j < 3; j++)
+    u(j) = (mix(h + (j + 1) * 0x9e3779b97f4a7c15ull) >> 11) * (1.0 / 9007199254740992.0);
+
+  // Spread over the tile, and about the floor as add_point does
+  return Vector3d((index(0) + u(0)) * tile_size_,
+                  (index(1) + u(1)) * tile_size_,
+                  floor_level_ + (2.0 * u(2) - 1.0) * max_offset_);
+}
+
+// A tile's place on a square spiral out from tile (0, 0): ring r (the tiles r from the origin
+// along x or y) follows the (2r - 1)^2 tiles inside it, counterclockwise from (r, 1 - r)
+static uint64_t tile_ordinal(const Vector2i& index)
+{
+  const int64_t x = index(0), y = index(1);
+  const int64_t r = std::max(std::abs(x), std::abs(y));
+  if (r == 0)
+    return 0;
+  const int64_t base = (2 * r - 1) * (2 * r - 1);
+  if (x == r && y > -r)
+    return base + (y + r - 1);
+  if (y == r)
+    return base + 2 * r + (r - 1 - x);
+  if (x == -r)
+    return base + 4 * r + (r - 1 - y);
+  return base + 6 * r + (x + r - 1);
+}
+
+static Vector2i tile_index(uint64_t ordinal)
+{
+  if (ordinal == 0)
+    return Vector2i::Zero();
+  int64_t r = (int64_t)((std::sqrt((double)ordinal) + 1.0) / 2.0);
+  while ((2 * r + 1) * (2 * r + 1) <= (int64_t)ordinal)
+    r++;
+  while ((2 * r - 1) * (2 * r - 1) > (int64_t)ordinal)
+    r--;
+  const int64_t k = ordinal - (2 * r - 1) * (2 * r - 1);
+  const int64_t o = k % (2 * r);
+  switch (k / (2 * r))
+  {
+  case 0: return Vector2i((int)r, (int)(o + 1 - r));
+  case 1: return Vector2i((int)(r - 1 - o), (int)r);
+  case 2: return Vector2i((int)-r, (int)(r - 1 - o));
+  default: return Vector2i((int)(o + 1 - r), (int)-r);
+  }
+}
+
+void Environment::load_tile(const Vector2i& index)
+{
+  const uint64_t ordinal = tile_ordinal(index);
+  if ((ordinal + 1) * tile_landmarks_ > (uint64_t)std::numeric_limits<int>::max())
+    throw std::runtime_error("The tiled world ran out of landmark ids this far from the origin");
+
+  Tile& tile = tiles_[tile_key(index)];
+  tile.index = index;
+  tile.ordinal = ordinal;
+  tile.last_used = tile_clock_;
+  for (int i = 0; i < tile_landmarks_; i++)
+    grid_insert(tile.ordinal * tile_landmarks_ + i, tile_point(index, i));
+}
+
+void Environment::evict_tile(uint64_t key)
+{
+  auto it = tiles_.find(key);
+  const Tile& tile = it->second;
+  for (int i = 0; i < tile_landmarks_; i++)
+    grid_erase(tile.ordinal * tile_landmarks_ + i, tile_point(tile.index, i));
+  tiles_.erase(it);
+}
+
+void Environment::update_tiles(const Vector3d& center)
+{
+  if (!tiled())
+    return;
+
+  tile_clock_++;
+  const Vector2i lo = ((center.head<2>().array() - tile_radius_) / tile_size_).floor().cast<int>();
+  const Vector2i hi = ((center.head<2>().array() + tile_radius_) / tile_size_).floor().cast<int>();
+  Vector2i index;
+  for (index(0) = lo(0); index(0) <= hi(0); index(0)++)
+    for (index(1) = lo(1); index(1) <= hi(1); index(1)++)
+    {
+      auto it = tiles_.find(tile_key(index));
+      if (it != tiles_.end())
+        it->second.last_used = tile_clock_;
+      else
+        load_tile(index);
+    }
+
+  // Evict the least recently used down to the cap.  The tiles just used are never among them,
+  // since load() checks they all fit.
+  while (tiles_.size() > (size_t)max_tiles_)
+  {
+    auto lru = tiles_.begin();
+    for (auto it = tiles_.begin(); it != tiles_.end(); ++it)
+    {
+      if (it->second.last_used < lru->second.last_used)
+        lru = it;
+    }
+    evict_tile(lru->first);
+  }
+}
+
+bool Environment::has_point(size_t id) const
+{
+  if (tiled())
+    return id <= (size_t)std::numeric_limits<int>::max();
+  if (id < map_ids_)
+    return map_->has_point(id);
+  return id - map_ids_ < points_.pts.size();
+}
+
+Vector3d Environment::get_point(size_t id) const
+{
+  if (tiled())
+    return tile_point(tile_index(id / tile_landmarks_), id % tile_landmarks_);
+  if (id < map_ids_)
+    return map_->point(id);
+  return points_.pts[id - map_ids_];
+}
+
+size_t Environment::query_frustum(const Xformd& x_I2c, const Camera<double>& cam, vector<size_t>& ids,
+                                  double min_depth, double max_depth) const
+{
   ids.clear();
-  for (int i = 0; i < resultSet.size(); i++)
+
+  // Bearings to the image corners, in the inertial frame.  Distortion is only undone at the
+  // corners, so under strong distortion the sides of the frustum are approximate.
+  const Vector3d& t = x_I2c.t();
+  const Vector3d axis = x_I2c.rota(e_z);
+  Vector2d corner_pix[4] = {Vector2d(0, 0), Vector2d(cam.image_size_(0), 0),
+                            cam.image_size_, Vector2d(0, cam.image_size_(1))};
+  Vector3d corners[4];
+  for (int i = 0; i < 4; i++)
   {
-    if (dist_sqr[i] < max_dist*max_dist)
+    Vector3d zeta;
+    cam.invProj(corner_pix[i], 1.0, zeta);
+    corners[i] = x_I2c.rota(zeta);
+  }
+
+  // Frustum planes, n.p + d >= 0 inside: the four sides through the camera, one in front of it,
+  // and one at max_depth along the axis (no point within max_depth is beyond it)
+  Vector3d n[6];
+  double d[6];
+  for (int i = 0; i < 4; i++)
+  {
+    n[i] = corners[i].cross(corners[(i+1) % 4]);
+    if (n[i].dot(axis) < 0)
+      n[i] = -n[i];
+  }
+  n[4] = axis;
+  n[5] = -axis;
+  for (int i = 0; i < 5; i++)
+    d[i] = -n[i].dot(t);
+  d[5] = axis.dot(t) + max_depth;
+
+  // Bounding box of the frustum, clipped to max_depth around the camera
+  Vector3d lo = t, hi = t;
+  for (int i = 0; i < 4; i++)
+  {
+    Vector3d far_corner = t + corners[i] * (max_depth / corners[i].dot(axis));
+    lo = lo.cwiseMin(far_corner);
+    hi = hi.cwiseMax(far_corner);
+  }
+  lo = lo.cwiseMax(t - Vector3d::Constant(max_depth));
+  hi = hi.cwiseMin(t + Vector3d::Constant(max_depth));
+  const Vector3i lo_cell = (lo / grid_cell_size_).array().floor().cast<int>();
+  const Vector3i hi_cell = (hi / grid_cell_size_).array().floor().cast<int>();
+
+  // A cell of the grid or the map, its points as consecutive x, y, z
+  auto visit = [&](const Vector3i& index, const uint64_t* cell_ids, const double* pts, size_t count)
+  {
+    if ((index.array() < lo_cell.array()).any() || (index.array() > hi_cell.array()).any())
+      return;
+
+    // The cell is outside when its corner furthest along a plane's normal is behind the plane
+    const Vector3d cell_lo = index.cast<double>() * grid_cell_size_;
+    for (int i = 0; i < 6; i++)
     {
-      pts.push_back(points_.pts[ret_index[i]]);
-      ids.push_back(ret_index[i]);
+      Vector3d extreme = cell_lo;
+      for (int j = 0; j < 3; j++)
+      {
+        if (n[i](j) > 0)
+          extreme(j) += grid_cell_size_;
+      }
+      if (n[i].dot(extreme) + d[i] < 0)
+        return;
     }
+
+    for (size_t k = 0; k < count; k++)
+    {
+      Vector3d zeta = x_I2c.transformp(Map<const Vector3d>(pts + 3 * k));
+      if (zeta(2) <= 0.0)
+        continue;
+      double depth = zeta.norm();
+      if (depth < min_depth || depth > max_depth)
+        continue;
+      Vector2d pix;
+      cam.proj(zeta / depth, pix);
+      if ((pix.array() < 0).any() || (pix.array() > cam.image_size_.array()).any())
+        continue;
+      ids.push_back(cell_ids[k]);
+    }
+  };
+  auto visit_grid = [&](const GridCell& cell)
+  {
+    visit(cell.index, cell.ids.data(), cell.pts[0].data(), cell.ids.size());
+  };
+  auto visit_map = [&](const multirotor_sim::LandmarkMap::Cell& cell)
+  {
+    visit(Map<const Vector3i>(cell.index), map_->ids() + cell.begin, map_->points() + 3 * cell.begin,
+          cell.count);
+  };
+
+  // Look up the cells in the bounding box, unless there are fewer occupied cells than that
+  const Vector3d span = (hi_cell - lo_cell).cast<double>().array() + 1.0;
+  const size_t num_map_cells = map_ ? map_->num_cells() : 0;
+  if (span.prod() <= (double)(grid_.size() + num_map_cells))
+  {
+    Vector3i index;
+    for (index(0) = lo_cell(0); index(0) <= hi_cell(0); index(0)++)
+      for (index(1) = lo_cell(1); index(1) <= hi_cell(1); index(1)++)
+        for (index(2) = lo_cell(2); index(2) <= hi_cell(2); index(2)++)
+        {
+          uint64_t key = grid_key(index);
+          auto it = grid_.find(key);
+          if (it != grid_.end())
+            visit_grid(it->second);
+          const multirotor_sim::LandmarkMap::Cell* cell = map_ ? map_->find(key) : nullptr;
+          if (cell)
+            visit_map(*cell);
+        }
   }
-  return pts.size() > 0;
+  else
+  {
+    for (auto it = grid_.begin(); it != grid_.end(); ++it)
+      visit_grid(it->second);
+    for (size_t c = 0; c < num_map_cells; c++)
+      visit_map(map_->cells()[c]);
+  }
+
+  // Cells come out in hash order
+  std::sort(ids.begin(), ids.end());
+  return ids.size();
 }
 
 //void Environment::move_point(int id)
@@ -0,0 +1,99 @@
+#include "multirotor_sim/feature_projector.h"
+
+using namespace Eigen;
+
+namespace multirotor_sim
+{
+
+FeatureProjector::FeatureProjector() :
+  n_(0)
+{}
+
+void FeatureProjector::resize(int n)
+{
+  n_ = n;
+  if (n <= px_.size())
+    return;
+
+  int capacity = std::max<int>(2 * px_.size(), n);
+  px_.conservativeResize(capacity);
+  py_.conservativeResize(capacity);
+  pz_.conservativeResize(capacity);
+  zx_.resize(capacity);
+  zy_.resize(capacity);
+  zz_.resize(capacity);
+  u_.resize(capacity);
+  v_.resize(capacity);
+  depth_.resize(capacity);
+  visible_.resize(capacity);
+}
+
+void FeatureProjector::set_points(const Ref<const Matrix3Xd> &pts)
+{
+  resize(pts.cols());
+  px_.head(n_) = pts.row(0).transpose().array();
+  py_.head(n_) = pts.row(1).transpose().array();
+  pz_.head(n_) = pts.row(2).transpose().array();
+}
+
+void FeatureProjector::project(const xform::Xformd &x_I2c, const Camera<double> &cam)
+{
+  // The first n_ of each array, mapped as aligned so Eigen vectorizes without peeling (head()
+  // would lose the alignment, and run at half the speed)
+  typedef Map<ArrayXd, Aligned> Column;
+  Column px(px_.data(), n_), py(py_.data(), n_), pz(pz_.data(), n_);
+  Column zx(zx_.data(), n_), zy(zy_.data(), n_), zz(zz_.data(), n_);
+  Column u(u_.data(), n_), v(v_.data(), n_);
+  Column depth(depth_.data(), n_);
+
+  // Same transform as Xformd::transformp, R (p - t), with R's columns the rotated axes
+  Matrix3d R;
+  R.col(0) = x_I2c.q().rotp(Vector3d::UnitX());
+  R.col(1) = x_I2c.q().rotp(Vector3d::UnitY());
+  R.col(2) = x_I2c.q().rotp(Vector3d::UnitZ());
+  const Vector3d Rt = R * x_I2c.t();
+  zx = R(0, 0) * px + R(0, 1) * py + R(0, 2) * pz - Rt(0);
+  zy = R(1, 0) * px + R(1, 1) * py + R(1, 2) * pz - Rt(1);
+  zz = R(2, 0) * px + R(2, 1) * py + R(2, 2) * pz - Rt(2);
+  visible_.head(n_) = zz >= 0.0;
+
+  // Divisions are slow, so take one reciprocal each for the depth and the image plane (u and v
+  // hold them until the pixels are computed) and multiply
+  depth = (zx.square() + zy.square() + zz.square()).sqrt();
+  v = depth.inverse();
+  zx *= v;
+  zy *= v;
+  zz *= v;
+  v = zz.inverse();
+  u = zx * v; // normalized image coordinates
+  v = zy * v;
+
+  // Radial-tangential distortion, as Camera::Distort
+  if (!cam.distortion_.isZero())
+  {
+    const double k1 = cam.distortion_(0);
+    const double k2 = cam.distortion_(1);
+    const double p1 = cam.distortion_(2);
+    const double p2 = cam.distortion_(3);
+    const double k3 = cam.distortion_(4);
+    // A plain loop, since both coordinates are updated from both
+    for (int i = 0; i < n_; i++)
+    {
+      const double x = u[i], y = v[i];
+      const double r2 = x * x + y * y;
+      const double g = 1.0 + r2 * (k1 + r2 * (k2 + r2 * k3));
+      u[i] = g * (x + 2.0 * p1 * x * y + p2 * (r2 + 2.0 * x * x));
+      v[i] = g * (y + 2.0 * p2 * x * y + p1 * (r2 + 2.0 * y * y));
+    }
+  }
+
+  u = cam.focal_len_(0) * u + cam.s_ * v + cam.cam_center_(0);
+  v = cam.focal_len_(1) * v + cam.cam_center_(1);
+
+  // In frame when the pixel's distance to the nearest edge isn't negative, found with vectorized
+  // mins so only one comparison makes a bool
+  visible_.head(n_) = visible_.head(n_)
+                    && (u.min(cam.image_size_(0) - u).min(v.min(cam.image_size_(1) - v)) >= 0.0);
+}
+
+}
@@ -0,0 +1,118 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <stdexcept>
+
+#include "multirotor_sim/landmark_map.h"
+
+namespace multirotor_sim
+{
+
+static const char MAP_MAGIC[8] = {'M', 'S', 'I', 'M', 'M', 'A', 'P', '\0'};
+
+struct MapHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+  double cell_size;
+  uint64_t num_cells;
+  uint64_t num_points;
+  uint64_t id_count;
+};
+
+const uint64_t LandmarkMap::NO_SLOT;
+
+LandmarkMap::LandmarkMap(const std::string &filename)
+{
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw std::runtime_error("Unable to open landmark map " + filename);
+  struct stat st;
+  if (fstat(fd, &st) != 0)
+  {
+    ::close(fd);
+    throw std::runtime_error("Unable to stat landmark map " + filename);
+  }
+  size_ = st.st_size;
+  void* data = size_ >= sizeof(MapHeader) ? mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+  ::close(fd);
+  if (data == MAP_FAILED)
+    throw std::runtime_error("Unable to map landmark map " + filename);
+  data_ = (const uint8_t*)data;
+
+  MapHeader header;
+  memcpy(&header, data_, sizeof(header));
+  size_t expected = sizeof(MapHeader) + header.num_cells * sizeof(Cell)
+                    + header.num_points * (3 * sizeof(double) + sizeof(uint64_t))
+                    + header.id_count * sizeof(uint64_t);
+  if (memcmp(header.magic, MAP_MAGIC, sizeof(MAP_MAGIC)) != 0 || header.version != VERSION
+      || expected != size_)
+  {
+    munmap(data, size_);
+    throw std::runtime_error(filename + " is not a multirotor_sim landmark map");
+  }
+
+  cell_size_ = header.cell_size;
+  num_cells_ = header.num_cells;
+  num_points_ = header.num_points;
+  id_count_ = header.id_count;
+  cells_ = (const Cell*)(data_ + sizeof(MapHeader));
+  points_ = (const double*)(cells_ + num_cells_);
+  ids_ = (const uint64_t*)(points_ + 3 * num_points_);
+  slots_ = ids_ + num_points_;
+}
+
+LandmarkMap::~LandmarkMap()
+{
+  munmap((void*)data_, size_);
+}
+
+void LandmarkMap::write(const std::string &filename, double cell_size, const std::vector<Cell> &cells,
+                        const std::vector<double> &points, const std::vector<uint64_t> &ids)
+{
+  uint64_t id_count = ids.empty() ? 0 : *std::max_element(ids.begin(), ids.end()) + 1;
+  std::vector<uint64_t> slots(id_count, NO_SLOT);
+  for (size_t i = 0; i < ids.size(); i++)
+    slots[ids[i]] = i;
+
+  MapHeader header;
+  memcpy(header.magic, MAP_MAGIC, sizeof(MAP_MAGIC));
+  header.version = VERSION;
+  header.reserved = 0;
+  header.cell_size = cell_size;
+  header.num_cells = cells.size();
+  header.num_points = ids.size();
+  header.id_count = id_count;
+
+  FILE* file = fopen(filename.c_str(), "wb");
+  if (!file)
+    throw std::runtime_error("Unable to write landmark map " + filename);
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+            && fwrite(cells.data(), sizeof(Cell), cells.size(), file) == cells.size()
+            && fwrite(points.data(), sizeof(double), points.size(), file) == points.size()
+            && fwrite(ids.data(), sizeof(uint64_t), ids.size(), file) == ids.size()
+            && fwrite(slots.data(), sizeof(uint64_t), slots.size(), file) == slots.size();
+  // A full disk may only show when the buffer is flushed
+  if (fclose(file) != 0)
+    ok = false;
+  if (!ok)
+  {
+    remove(filename.c_str());
+    throw std::runtime_error("Unable to write landmark map " + filename);
+  }
+}
+
+const LandmarkMap::Cell* LandmarkMap::find(uint64_t key) const
+{
+  const Cell* end = cells_ + num_cells_;
+  const Cell* it = std::lower_bound(cells_, end, key,
+                                    [](const Cell& cell, uint64_t k) { return cell.key < k; });
+  return (it != end && it->key == key) ? it : nullptr;
+}
+
+}
@@ -0,0 +1,443 @@
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <limits>
+
+#ifdef MULTIROTOR_SIM_USE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef MULTIROTOR_SIM_USE_LZ4
+#include <lz4.h>
+#endif
+
+#include "multirotor_sim/logger.h"
+
+namespace multirotor_sim
+{
+
+static const char LOG_MAGIC[8] = {'M', 'S', 'I', 'M', 'L', 'O', 'G', '\0'};
+static const char INDEX_MAGIC[8] = {'M', 'S', 'I', 'M', 'I', 'D', 'X', '\0'};
+
+static size_t type_size(Logger::Type type)
+{
+  switch (type)
+  {
+  case Logger::F64: return 8;
+  case Logger::F32: return 4;
+  case Logger::I64: return 8;
+  case Logger::I32: return 4;
+  case Logger::U32: return 4;
+  case Logger::U8: return 1;
+  }
+  return 0;
+}
+
+static const char* numpy_type(Logger::Type type)
+{
+  switch (type)
+  {
+  case Logger::F64: return "<f8";
+  case Logger::F32: return "<f4";
+  case Logger::I64: return "<i8";
+  case Logger::I32: return "<i4";
+  case Logger::U32: return "<u4";
+  case Logger::U8: return "u1";
+  }
+  return "";
+}
+
+Logger::Channel& Logger::Channel::add(const std::string &name, Type type, int rows, int cols)
+{
+  Field f;
+  f.name = name;
+  f.type = type;
+  f.rows = rows;
+  f.cols = cols;
+  fields_.push_back(f);
+  record_size_ += type_size(type) * rows * cols;
+  return *this;
+}
+
+std::string Logger::Channel::numpy_dtype() const
+{
+  std::stringstream ss;
+  ss << "[";
+  for (size_t i = 0; i < fields_.size(); i++)
+  {
+    const Field& f = fields_[i];
+    ss << (i > 0 ? ", " : "") << "('" << f.name << "', '" << numpy_type(f.type) << "'";
+    if (f.cols > 1)
+      ss << ", (" << f.rows << ", " << f.cols << ")";
+    else if (f.rows > 1)
+      ss << ", (" << f.rows << ",)";
+    ss << ")";
+  }
+  ss << "]";
+  return ss.str();
+}
+
+Logger::Logger(size_t block_size) :
+  block_size_(block_size),
+  file_(nullptr),
+  bytes_written_(0),
+  compression_(NONE),
+  compression_level_(1),
+  offset_(0),
+  async_(false),
+  buffer_size_(0),
+  num_buffers_(0),
+  policy_(BLOCK),
+  current_(nullptr),
+  queue_depth_(0),
+  stop_(false),
+  dropped_blocks_(0),
+  dropped_bytes_(0)
+{}
+
+Logger::~Logger()
+{
+  close();
+}
+
+void Logger::set_async(size_t buffer_size, int num_buffers, Backpressure policy)
+{
+  async_ = true;
+  buffer_size_ = buffer_size;
+  num_buffers_ = num_buffers < 2 ? 2 : num_buffers;
+  policy_ = policy;
+}
+
+void Logger::set_sync()
+{
+  async_ = false;
+}
+
+bool Logger::has_compression(Compression compression)
+{
+  switch (compression)
+  {
+  case NONE: return true;
+#ifdef MULTIROTOR_SIM_USE_ZSTD
+  case ZSTD: return true;
+#endif
+#ifdef MULTIROTOR_SIM_USE_LZ4
+  case LZ4: return true;
+#endif
+  default: return false;
+  }
+}
+
+bool Logger::set_compression(Compression compression, int level)
+{
+  if (!has_compression(compression))
+    return false;
+  compression_ = compression;
+  compression_level_ = level;
+  return true;
+}
+
+bool Logger::open(const std::string &filename)
+{
+  close();
+  file_ = fopen(filename.c_str(), "wb");
+  if (!file_)
+    return false;
+
+  uint32_t header[2] = {VERSION, 0};
+  fwrite(LOG_MAGIC, 1, sizeof(LOG_MAGIC), file_);
+  fwrite(header, sizeof(uint32_t), 2, file_);
+  bytes_written_ = HEADER_SIZE;
+  offset_ = HEADER_SIZE;
+  index_.clear();
+  dropped_blocks_ = 0;
+  dropped_bytes_ = 0;
+
+  if (async_)
+  {
+    pool_.assign(num_buffers_, Buffer());
+    full_.reset(num_buffers_);
+    free_.reset(num_buffers_);
+    for (size_t i = 0; i < pool_.size(); i++)
+    {
+      pool_[i].reserve(buffer_size_);
+      free_.push(&pool_[i]);
+    }
+    current_ = nullptr;
+    queue_depth_ = 0;
+    stop_ = false;
+    writer_ = std::thread(&Logger::writer_thread, this);
+  }
+
+  for (size_t i = 0; i < channels_.size(); i++)
+  {
+    channels_[i].records = 0;
+    write_definition(channels_[i]);
+  }
+  return true;
+}
+
+void Logger::close()
+{
+  if (!file_)
+    return;
+  flush();
+  if (writer_.joinable())
+  {
+    stop_ = true;
+    writer_.join();
+  }
+
+  // The index and trailer go last, once the writer thread has emptied its queue and every
+  // block's offset is known
+  uint64_t index_offset = offset_;
+  write_index();
+  fwrite(&index_offset, sizeof(index_offset), 1, file_);
+  fwrite(INDEX_MAGIC, 1, sizeof(INDEX_MAGIC), file_);
+  bytes_written_ += TRAILER_SIZE;
+  fclose(file_);
+  file_ = nullptr;
+}
+
+int Logger::add_channel(const Channel &channel)
+{
+  channels_.push_back(ChannelBuffer(channel));
+  ChannelBuffer& buf = channels_.back();
+  size_t rs = channel.record_size() > 0 ? channel.record_size() : 1;
+  size_t records_per_block = block_size_ / rs > 0 ? block_size_ / rs : 1;
+  buf.block.resize(records_per_block * rs);
+  if (file_)
+    write_definition(buf);
+  return channels_.size() - 1;
+}
+
+Logger::Record Logger::record(int channel)
+{
+  ChannelBuffer& buf = channels_[channel];
+  size_t rs = buf.def.record_size();
+  if (!file_)
+    return Record(nullptr, 0);
+
+  if ((buf.records + 1) * rs > buf.block.size())
+    write_block(channel);
+
+  uint8_t* ptr = buf.block.data() + buf.records * rs;
+  memset(ptr, 0, rs);
+  ++buf.records;
+  return Record(ptr, rs);
+}
+
+void Logger::flush()
+{
+  if (!file_)
+    return;
+  for (size_t i = 0; i < channels_.size(); i++)
+  {
+    if (channels_[i].records > 0)
+      write_block(i);
+  }
+  if (writer_.joinable())
+  {
+    if (current_ && !current_->empty())
+      submit_buffer();
+    while (queue_depth_ > 0)
+      std::this_thread::yield();
+  }
+  fflush(file_);
+}
+
+void Logger::write_definition(ChannelBuffer &buf)
+{
+  std::string def = buf.def.name() + '\0' + buf.def.numpy_dtype() + '\0';
+  uint32_t id = &buf - channels_.data();
+  IndexEntry entry = {0, DEFINITION, id, 0, 0,
+                      -std::numeric_limits<double>::infinity(), std::numeric_limits<double>::infinity()};
+  write(entry, (const uint8_t*)def.data(), def.size());
+}
+
+void Logger::write_block(int id)
+{
+  ChannelBuffer& buf = channels_[id];
+  const std::vector<Field>& fields = buf.def.fields();
+  size_t rs = buf.def.record_size();
+  size_t size = buf.records * rs;
+
+  IndexEntry entry = {0, DATA, (uint32_t)id, buf.records, 0,
+                      -std::numeric_limits<double>::infinity(), std::numeric_limits<double>::infinity()};
+  if (!fields.empty() && fields[0].name == "t" && fields[0].type == F64 && fields[0].rows * fields[0].cols == 1)
+  {
+    memcpy(&entry.t_min, buf.block.data(), sizeof(double));
+    entry.t_max = entry.t_min;
+    for (uint32_t r = 1; r < buf.records; r++)
+    {
+      double t;
+      memcpy(&t, buf.block.data() + r * rs, sizeof(double));
+      entry.t_min = std::min(entry.t_min, t);
+      entry.t_max = std::max(entry.t_max, t);
+    }
+  }
+
+  // Transpose the records into columns
+  columns_.resize(size);
+  uint8_t* dst = columns_.data();
+  size_t field_offset = 0;
+  for (size_t f = 0; f < fields.size(); f++)
+  {
+    size_t fs = type_size(fields[f].type) * fields[f].rows * fields[f].cols;
+    const uint8_t* src = buf.block.data() + field_offset;
+    for (uint32_t r = 0; r < buf.records; r++, src += rs, dst += fs)
+      memcpy(dst, src, fs);
+    field_offset += fs;
+  }
+
+  write(entry, columns_.data(), size);
+  buf.records = 0;
+}
+
+size_t Logger::compress(const uint8_t* src, size_t size)
+{
+  // Returns the compressed size, or 0 to store the chunk uncompressed
+  switch (compression_)
+  {
+#ifdef MULTIROTOR_SIM_USE_ZSTD
+  case ZSTD:
+  {
+    compressed_.resize(ZSTD_compressBound(size));
+    size_t n = ZSTD_compress(compressed_.data(), compressed_.size(), src, size, compression_level_);
+    return ZSTD_isError(n) || n >= size ? 0 : n;
+  }
+#endif
+#ifdef MULTIROTOR_SIM_USE_LZ4
+  case LZ4:
+  {
+    compressed_.resize(LZ4_compressBound(size));
+    int n = LZ4_compress_default((const char*)src, (char*)compressed_.data(), size, compressed_.size());
+    return n <= 0 || (size_t)n >= size ? 0 : n;
+  }
+#endif
+  default:
+    return 0;
+  }
+}
+
+void Logger::write_index()
+{
+  IndexEntry entry = {0, INDEX, 0, (uint32_t)index_.size(), 0, 0.0, 0.0};
+  emit(entry, (const uint8_t*)index_.data(), index_.size() * sizeof(IndexEntry));
+}
+
+bool Logger::write(const IndexEntry& entry, const uint8_t *data, uint32_t size)
+{
+  if (!writer_.joinable())
+  {
+    emit(entry, data, size);
+    return true;
+  }
+
+  // Blocks go to the writer thread as they are, behind their index entry, and it compresses
+  // them, so compression costs the recording thread nothing
+  size_t n = sizeof(IndexEntry) + sizeof(size) + size;
+  if (current_ && current_->size() + n > buffer_size_ && !current_->empty())
+    submit_buffer();
+  if (!current_ && !acquire_buffer(entry.kind == DEFINITION || policy_ == BLOCK))
+  {
+    ++dropped_blocks_;
+    dropped_bytes_ += BLOCK_HEADER_SIZE + size;
+    return false;
+  }
+  current_->insert(current_->end(), (const uint8_t*)&entry, (const uint8_t*)&entry + sizeof(IndexEntry));
+  current_->insert(current_->end(), (const uint8_t*)&size, (const uint8_t*)&size + sizeof(size));
+  current_->insert(current_->end(), data, data + size);
+  return true;
+}
+
+void Logger::emit(IndexEntry entry, const uint8_t *data, uint32_t size)
+{
+  if (entry.kind == DATA)
+  {
+    size_t compressed_size = compress(data, size);
+    if (compressed_size > 0)
+    {
+      entry.kind = compression_ == ZSTD ? DATA_ZSTD : DATA_LZ4;
+      data = compressed_.data();
+      size = compressed_size;
+    }
+  }
+
+  uint32_t header[4] = {entry.kind, entry.channel, size, entry.records};
+  fwrite(header, sizeof(uint32_t), 4, file_);
+  fwrite(data, 1, size, file_);
+  entry.offset = offset_;
+  if (entry.kind != INDEX)
+    index_.push_back(entry);
+  bytes_written_ += BLOCK_HEADER_SIZE + size;
+  offset_ += BLOCK_HEADER_SIZE + size;
+}
+
+bool Logger::acquire_buffer(bool wait)
+{
+  while (!free_.pop(current_))
+  {
+    if (!wait)
+    {
+      current_ = nullptr;
+      return false;
+    }
+    std::this_thread::yield();
+  }
+  return true;
+}
+
+void Logger::submit_buffer()
+{
+  // The queue holds every buffer of the pool, so this never fails
+  ++queue_depth_;
+  full_.push(current_);
+  current_ = nullptr;
+}
+
+void Logger::writer_thread()
+{
+  while (true)
+  {
+    // Check for stop before popping, so buffers submitted before close() are always written
+    bool stop = stop_;
+    Buffer* buf;
+    if (full_.pop(buf))
+    {
+      // Each block behind its index entry and size
+      const uint8_t* p = buf->data();
+      const uint8_t* end = p + buf->size();
+      while (p < end)
+      {
+        IndexEntry entry;
+        uint32_t size;
+        memcpy(&entry, p, sizeof(entry));
+        memcpy(&size, p + sizeof(entry), sizeof(size));
+        p += sizeof(entry) + sizeof(size);
+        emit(entry, p, size);
+        p += size;
+      }
+      buf->clear();
+      free_.push(buf);
+      --queue_depth_;
+    }
+    else if (stop)
+      break;
+    else
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+}
+
+bool Logger::write_numpy_dtypes(const std::string &filename) const
+{
+  std::ofstream file(filename);
+  if (!file.is_open())
+    return false;
+  file << "# Generated by multirotor_sim::Logger\n";
+  file << "import numpy as np\n\n";
+  for (size_t i = 0; i < channels_.size(); i++)
+    file << channels_[i].def.name() << " = np.dtype(" << channels_[i].def.numpy_dtype() << ")\n";
+  return true;
+}
+
+}
@@ -0,0 +1,195 @@
+#include <cmath>
+#include <random>
+#include <stdexcept>
+
+#include "multirotor_sim/motion_table.h"
+
+using namespace Eigen;
+
+namespace multirotor_sim
+{
+
+static inline double wrap_angle(double a)
+{
+  return a - 2.0 * M_PI * std::floor((a + M_PI) / (2.0 * M_PI));
+}
+
+MotionTable::MotionTable(double dt, const Samples &samples, const Pose &drift) :
+  dt_(dt),
+  inv_dt_(1.0 / dt),
+  samples_(samples),
+  drift_(drift)
+{
+  if (samples.cols() < 1 || !(dt > 0.0))
+    throw std::runtime_error("A motion table needs at least one sample and a positive dt");
+}
+
+MotionTable::ShipMotion::ShipMotion() :
+  start(Vector3d::Zero()),
+  heading(0.0),
+  speed(5.0),
+  heave_stdev(0.5),
+  heave_period(8.0),
+  roll_stdev(0.05),
+  roll_period(10.0),
+  pitch_stdev(0.02),
+  pitch_period(7.0),
+  yaw_stdev(0.01),
+  yaw_period(12.0),
+  duration(600.0),
+  dt(0.05)
+{}
+
+// Catmull-Rom through the samples around i, continued past either end with the drift
+MotionTable::Pose MotionTable::operator()(double t) const
+{
+  const double s = t * inv_dt_;
+  const double i = std::floor(s);
+  const double f = s - i;
+  const long n = samples_.cols();
+  long k = (long)i - 1;
+  long lap = k >= 0 ? k / n : -((-k + n - 1) / n);
+  k -= lap * n;
+
+  Pose p[4];
+  for (int j = 0; j < 4; j++)
+  {
+    p[j] = samples_.col(k) + (double)lap * drift_;
+    if (++k == n)
+    {
+      k = 0;
+      lap++;
+    }
+  }
+  return p[1] + 0.5 * f * ((p[2] - p[0])
+                           + f * ((2.0 * p[0] - 5.0 * p[1] + 4.0 * p[2] - p[3])
+                                  + f * (3.0 * (p[1] - p[2]) + p[3] - p[0])));
+}
+
+// Every frequency is a whole number of cycles over the table, so the table repeats without a seam.
+// Each sinusoid is advanced by rotating its phasor a sample at a time, rather than calling sin
+// for every sample of every component.
+std::shared_ptr<const MotionTable> MotionTable::ship(const ShipMotion &m, uint64_t seed)
+{
+  const long n = std::max<long>(std::lround(m.duration / m.dt), 1);
+  const double dt = m.duration / n;
+  const double dw = 2.0 * M_PI / m.duration;
+  std::mt19937_64 gen(seed);
+  std::uniform_real_distribution<double> phase(0.0, 2.0 * M_PI);
+
+  Samples samples(SIZE, n);
+  for (long i = 0; i < n; i++)
+  {
+    const double t = i * dt;
+    samples.col(i) << m.start.x() + m.speed * std::cos(m.heading) * t,
+                      m.start.y() + m.speed * std::sin(m.heading) * t,
+                      m.start.z(), 0.0, 0.0, m.heading;
+  }
+
+  const int dofs[4] = {Z, ROLL, PITCH, YAW};
+  const double stdevs[4] = {m.heave_stdev, m.roll_stdev, m.pitch_stdev, m.yaw_stdev};
+  const double periods[4] = {m.heave_period, m.roll_period, m.pitch_period, m.yaw_period};
+  for (int d = 0; d < 4; d++)
+  {
+    if (stdevs[d] <= 0.0)
+      continue;
+
+    // Harmonics from half to three times the peak frequency, or the nearest one to it
+    const double wp = 2.0 * M_PI / periods[d];
+    long k0 = std::max<long>(std::ceil(0.5 * wp / dw), 1);
+    long k1 = std::floor(3.0 * wp / dw);
+    if (k1 < k0)
+      k0 = k1 = std::max<long>(std::lround(wp / dw), 1);
+    std::vector<double> spectrum(k1 - k0 + 1);
+    double total = 0.0;
+    for (long k = k0; k <= k1; k++)
+    {
+      const double r = wp / (k * dw);
+      spectrum[k - k0] = std::pow(r, 5) * std::exp(-1.25 * std::pow(r, 4));
+      total += spectrum[k - k0];
+    }
+
+    // The variance of a sum of sinusoids is the sum of their squared amplitudes over 2
+    for (long k = k0; k <= k1; k++)
+    {
+      const double amplitude = stdevs[d] * std::sqrt(2.0 * spectrum[k - k0] / total);
+      const double phi = phase(gen);
+      const double c = std::cos(k * dw * dt), s = std::sin(k * dw * dt);
+      double re = amplitude * std::cos(phi), im = amplitude * std::sin(phi);
+      for (long i = 0; i < n; i++)
+      {
+        samples(dofs[d], i) += re;
+        const double next = re * c - im * s;
+        im = re * s + im * c;
+        re = next;
+      }
+    }
+  }
+
+  Pose drift = Pose::Zero();
+  drift(X) = m.speed * std::cos(m.heading) * m.duration;
+  drift(Y) = m.speed * std::sin(m.heading) * m.duration;
+  return std::make_shared<const MotionTable>(dt, samples, drift);
+}
+
+// Uniform Catmull-Rom through the closed loop of waypoints, u in [0, waypoints.size())
+static Vector3d loop_spline(const std::vector<Vector3d> &w, double u)
+{
+  const long m = w.size();
+  const long j = std::min<long>(std::floor(u), m - 1);
+  const double f = u - j;
+  const Vector3d& p0 = w[(j + m - 1) % m];
+  const Vector3d& p1 = w[j];
+  const Vector3d& p2 = w[(j + 1) % m];
+  const Vector3d& p3 = w[(j + 2) % m];
+  return p1 + 0.5 * f * ((p2 - p0) + f * ((2.0 * p0 - 5.0 * p1 + 4.0 * p2 - p3)
+                                          + f * (3.0 * (p1 - p2) + p3 - p0)));
+}
+
+// The spline is reparameterized by arc length from a dense polyline of it, and sampled at equal
+// distances along it.  Yaw follows the direction between neighbouring samples, unwrapped, so a lap
+// drifts by the turns made.
+std::shared_ptr<const MotionTable> MotionTable::path(const std::vector<Vector3d> &waypoints, double speed, double dt)
+{
+  if (waypoints.size() < 2 || !(speed > 0.0))
+    throw std::runtime_error("A path needs at least two waypoints and a positive speed");
+
+  const int DENSE = 64; // polyline points per segment
+  const long m = waypoints.size();
+  std::vector<double> length(m * DENSE + 1, 0.0);
+  Vector3d prev = waypoints[0];
+  for (long i = 1; i <= m * DENSE; i++)
+  {
+    const Vector3d p = loop_spline(waypoints, (double)i / DENSE);
+    length[i] = length[i - 1] + (p - prev).norm();
+    prev = p;
+  }
+
+  const double lap = length.back();
+  const long n = std::max<long>(std::lround(lap / (speed * dt)), 3);
+  Samples samples = Samples::Zero(SIZE, n);
+  long seg = 0;
+  for (long k = 0; k < n; k++)
+  {
+    const double s = lap * k / n;
+    while (length[seg + 1] < s)
+      seg++;
+    const double span = length[seg + 1] - length[seg];
+    const double u = (seg + (span > 0.0 ? (s - length[seg]) / span : 0.0)) / DENSE;
+    samples.block<3, 1>(X, k) = loop_spline(waypoints, u);
+  }
+
+  double yaw = 0.0;
+  for (long k = 0; k < n; k++)
+  {
+    const Vector3d d = samples.block<3, 1>(X, (k + 1) % n) - samples.block<3, 1>(X, (k + n - 1) % n);
+    const double heading = std::atan2(d.y(), d.x());
+    yaw = k == 0 ? heading : yaw + wrap_angle(heading - yaw);
+    samples(YAW, k) = yaw;
+  }
+  Pose drift = Pose::Zero();
+  drift(YAW) = yaw + wrap_angle(samples(YAW, 0) - yaw) - samples(YAW, 0);
+  return std::make_shared<const MotionTable>(lap / (speed * n), samples, drift);
+}
+
+}
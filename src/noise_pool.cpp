@@ -0,0 +1,125 @@
+#include <cmath>
+
+#include "multirotor_sim/noise_pool.h"
+
+namespace multirotor_sim
+{
+
+// Ziggurat of 128 layers (Marsaglia and Tsang, in the form of Doornik's ZIGNOR)
+static const int ZIG_LAYERS = 128;
+static const double ZIG_R = 3.442619855899; // start of the tail
+static const double ZIG_V = 9.91256303526217e-3; // area of each layer
+
+struct Ziggurat
+{
+  double x[ZIG_LAYERS + 1]; // right edge of each layer
+  double ratio[ZIG_LAYERS]; // x[i+1] / x[i], below which a sample is inside the density
+
+  Ziggurat()
+  {
+    double f = std::exp(-0.5 * ZIG_R * ZIG_R);
+    x[0] = ZIG_V / f;
+    x[1] = ZIG_R;
+    x[ZIG_LAYERS] = 0;
+    for (int i = 2; i < ZIG_LAYERS; i++)
+    {
+      x[i] = std::sqrt(-2.0 * std::log(ZIG_V / x[i-1] + f));
+      f = std::exp(-0.5 * x[i] * x[i]);
+    }
+    for (int i = 0; i < ZIG_LAYERS; i++)
+      ratio[i] = x[i+1] / x[i];
+  }
+};
+
+static const Ziggurat ZIG;
+
+static inline uint64_t rotl(uint64_t x, int k)
+{
+  return (x << k) | (x >> (64 - k));
+}
+
+// Spreads one seed over the generator state, as recommended for xoshiro
+static inline uint64_t splitmix64(uint64_t& x)
+{
+  uint64_t z = (x += 0x9e3779b97f4a7c15ull);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+NoisePool::NoisePool(uint64_t seed, size_t block_size) :
+  block_(block_size)
+{
+  this->seed(seed);
+}
+
+void NoisePool::seed(uint64_t seed)
+{
+  for (int i = 0; i < 4; i++)
+    s_[i] = splitmix64(seed);
+  pos_ = block_.size();
+}
+
+uint64_t NoisePool::next()
+{
+  // xoshiro256++, whose low bits are as random as the high ones (they pick the layer)
+  uint64_t result = rotl(s_[0] + s_[3], 23) + s_[0];
+  uint64_t t = s_[1] << 17;
+  s_[2] ^= s_[0];
+  s_[3] ^= s_[1];
+  s_[1] ^= s_[2];
+  s_[0] ^= s_[3];
+  s_[2] ^= t;
+  s_[3] = rotl(s_[3], 45);
+  return result;
+}
+
+double NoisePool::uniform()
+{
+  // The top 53 bits, offset so log() never sees 0
+  return ((next() >> 11) + 1) * (1.0 / 9007199254740992.0);
+}
+
+double NoisePool::sample()
+{
+  while (true)
+  {
+    // The layer from the low bits, a uniform in [-1, 1) from the high bits
+    uint64_t bits = next();
+    int i = bits & (ZIG_LAYERS - 1);
+    double u = (bits >> 11) * (2.0 / 9007199254740992.0) - 1.0;
+
+    // Inside the layer's rectangle, 99% of the time
+    if (std::abs(u) < ZIG.ratio[i])
+      return u * ZIG.x[i];
+
+    if (i == 0)
+    {
+      // The tail beyond ZIG_R
+      double x, y;
+      do
+      {
+        x = std::log(uniform()) / ZIG_R;
+        y = std::log(uniform());
+      } while (-2.0 * y < x * x);
+      return u < 0 ? x - ZIG_R : ZIG_R - x;
+    }
+
+    // Between the rectangle and the density
+    double x = u * ZIG.x[i];
+    double f0 = std::exp(-0.5 * (ZIG.x[i] * ZIG.x[i] - x * x));
+    double f1 = std::exp(-0.5 * (ZIG.x[i+1] * ZIG.x[i+1] - x * x));
+    if (f1 + uniform() * (f0 - f1) < 1.0)
+      return x;
+  }
+}
+
+void NoisePool::refill()
+{
+  double* p = block_.data();
+  for (Eigen::Index i = 0; i < block_.size(); i++)
+    p[i] = sample();
+  pos_ = 0;
+}
+
+}
@@ -0,0 +1,96 @@
+#include <stdexcept>
+
+#include "multirotor_sim/platform_vehicle.h"
+
+using namespace Eigen;
+
+namespace multirotor_sim
+{
+
+PlatformVehicle::PlatformVehicle(std::shared_ptr<const MotionTable> motion, double t0) :
+  motion_(motion),
+  t_(t0),
+  x_I2b_(xform::Xformd::Identity()),
+  p_b_a_(Vector3d::Zero()),
+  q_b_a_(quat::Quatd::Identity()),
+  lm_b_(3, 0),
+  lm_I_(3, 0)
+{
+  update();
+}
+
+void PlatformVehicle::reset(double t0)
+{
+  t_ = t0;
+  update();
+}
+
+void PlatformVehicle::set_aruco(const Vector3d &p_b_a, const quat::Quatd &q_b_a)
+{
+  p_b_a_ = p_b_a;
+  q_b_a_ = q_b_a;
+  update();
+}
+
+void PlatformVehicle::set_landmarks(const std::vector<int> &ids, const Matrix3Xd &p_b)
+{
+  if ((Eigen::Index)ids.size() != p_b.cols())
+    throw std::runtime_error("PlatformVehicle::set_landmarks needs one id for each landmark");
+  ids_ = ids;
+  lm_b_ = p_b;
+  lm_I_.resize(3, p_b.cols());
+  update();
+}
+
+void PlatformVehicle::set_landmark_grid(int rows, int cols, double spacing, const Vector3d &center, int first_id)
+{
+  std::vector<int> ids(rows * cols);
+  Matrix3Xd p_b(3, rows * cols);
+  for (int r = 0; r < rows; r++)
+  {
+    for (int c = 0; c < cols; c++)
+    {
+      const int i = r * cols + c;
+      ids[i] = first_id + i;
+      p_b.col(i) = center + spacing * Vector3d(r - 0.5 * (rows - 1), c - 0.5 * (cols - 1), 0.0);
+    }
+  }
+  set_landmarks(ids, p_b);
+}
+
+void PlatformVehicle::step(const double &dt)
+{
+  t_ += dt;
+  update();
+}
+
+void PlatformVehicle::landmarkLocations(std::vector<int> &ids, std::vector<Vector3d> &pts)
+{
+  ids = ids_;
+  pts.resize(lm_I_.cols());
+  for (int i = 0; i < lm_I_.cols(); i++)
+    pts[i] = lm_I_.col(i);
+}
+
+void PlatformVehicle::update()
+{
+  const MotionTable::Pose pose = (*motion_)(t_);
+  const quat::Quatd q_I_b = quat::Quatd::from_euler(pose(MotionTable::ROLL), pose(MotionTable::PITCH),
+                                                     pose(MotionTable::YAW));
+  x_I2b_ = xform::Xformd(Vector3d(pose.head<3>()), q_I_b);
+  const xform::Xformd x_I2a = x_I2b_ * xform::Xformd(p_b_a_, q_b_a_);
+  p_I_a_ = x_I2a.t();
+  q_I_a_ = x_I2a.q();
+
+  if (lm_b_.cols() > 0)
+  {
+    Matrix3d R_b2I;
+    R_b2I.col(0) = x_I2b_.q().rota(Vector3d::UnitX());
+    R_b2I.col(1) = x_I2b_.q().rota(Vector3d::UnitY());
+    R_b2I.col(2) = x_I2b_.q().rota(Vector3d::UnitZ());
+    lm_I_.noalias() = R_b2I * lm_b_;
+    lm_I_.colwise() += x_I2b_.t();
+  }
+}
+
+}  // namespace multirotor_sim
@@ -0,0 +1,534 @@
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <Eigen/Geometry>
+
+#include "multirotor_sim/rasterizer.h"
+
+using namespace Eigen;
+
+namespace multirotor_sim
+{
+
+typedef Array<float, 8, 1> Span;
+typedef Array<int, 8, 1> Surface;
+
+static const double NEAR = 0.05; // closest a surface is drawn, for bounding quads (m)
+static const float W_MIN = 1e-3f; // 1/z beyond which nothing is drawn (1 km)
+static const uint8_t SKY = 200;
+
+// ArUco DICT_4X4_50 marker 0, one row of bits (1 white) per entry
+static const uint8_t MARKER_BITS[4][4] = {{1, 0, 1, 1}, {0, 1, 0, 1}, {0, 0, 1, 1}, {0, 0, 1, 0}};
+
+static inline uint64_t splitmix64(uint64_t x)
+{
+  x += 0x9e3779b97f4a7c15ull;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  return x ^ (x >> 31);
+}
+
+// floor(log2(x)) of a normal positive float, from its exponent bits
+static inline int floor_log2(float x)
+{
+  uint32_t bits;
+  memcpy(&bits, &x, sizeof(bits));
+  return (int)((bits >> 23) & 0xff) - 127;
+}
+
+static inline int floor_int(float x)
+{
+  int i = (int)x;
+  return i - (x < i);
+}
+
+std::shared_ptr<GrayImage> ImagePool::acquire(int width, int height)
+{
+  for (size_t n = 0; n < images_.size(); n++)
+  {
+    std::shared_ptr<GrayImage>& img = images_[(next_ + n) % images_.size()];
+    if (img.use_count() == 1)
+    {
+      // Whoever released it last may have been reading it on another thread
+      std::atomic_thread_fence(std::memory_order_acquire);
+      next_ = (next_ + n + 1) % images_.size();
+      img->resize(width, height);
+      return img;
+    }
+  }
+  images_.push_back(std::make_shared<GrayImage>());
+  images_.back()->resize(width, height);
+  return images_.back();
+}
+
+Rasterizer::Rasterizer(int num_threads) :
+  has_ground_(false),
+  ground_(0),
+  ground_texel_size_(0.05),
+  img_(nullptr),
+  tiles_x_(0),
+  tiles_y_(0),
+  ground_visible_(false),
+  next_tile_(0),
+  frame_(0),
+  busy_(0),
+  stop_(false)
+{
+  build_noise(ground_texture_, 9, 1);
+  build_noise(wall_texture_, 8, 2);
+  build_marker(marker_texture_);
+
+  if (num_threads <= 0)
+    num_threads = std::max<int>(std::thread::hardware_concurrency(), 1);
+  buffers_.resize(num_threads);
+  for (size_t i = 0; i < buffers_.size(); i++)
+  {
+    buffers_[i].depth.resize(TILE * TILE);
+    buffers_[i].surface.resize(TILE * TILE);
+  }
+  for (int i = 1; i < num_threads; i++)
+    workers_.push_back(std::thread(&Rasterizer::worker, this, i));
+}
+
+Rasterizer::~Rasterizer()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  start_.notify_all();
+  for (size_t i = 0; i < workers_.size(); i++)
+    workers_[i].join();
+}
+
+// Value noise: octaves of smoothly interpolated random lattices, from a quarter of the texture
+// down to 2 texels, each periodic over the texture so it tiles
+void Rasterizer::build_noise(Texture &tex, int log2_size, uint64_t seed)
+{
+  const int size = 1 << log2_size;
+  std::vector<float> sum(size * size, 0.0f);
+  for (int cell = size / 4, octave = 0; cell >= 2; cell /= 2, octave++)
+  {
+    const int lattice = size / cell;
+    const float amplitude = std::pow((float)cell, 0.35f);
+    std::vector<float> values(lattice * lattice);
+    for (size_t i = 0; i < values.size(); i++)
+      values[i] = (splitmix64(seed * 0x100000001b3ull + octave * 0x10000ull + i) >> 40) / (float)(1 << 24);
+    for (int y = 0; y < size; y++)
+    {
+      const int j = y / cell;
+      float fy = (y % cell) / (float)cell;
+      fy = fy * fy * (3 - 2 * fy);
+      for (int x = 0; x < size; x++)
+      {
+        const int i = x / cell;
+        float fx = (x % cell) / (float)cell;
+        fx = fx * fx * (3 - 2 * fx);
+        const int i1 = (i + 1) % lattice, j1 = (j + 1) % lattice;
+        const float top = values[j * lattice + i] + fx * (values[j * lattice + i1] - values[j * lattice + i]);
+        const float bottom = values[j1 * lattice + i] + fx * (values[j1 * lattice + i1] - values[j1 * lattice + i]);
+        sum[y * size + x] += amplitude * (top + fy * (bottom - top));
+      }
+    }
+  }
+
+  // Stretched to most of the range, clear of 0 and 255 which only markers use
+  const float lo = *std::min_element(sum.begin(), sum.end());
+  const float hi = *std::max_element(sum.begin(), sum.end());
+  tex.log2_size = log2_size;
+  tex.levels.assign(1, std::vector<uint8_t>(size * size));
+  for (int i = 0; i < size * size; i++)
+    tex.levels[0][i] = (uint8_t)(16.0f + 223.0f * (sum[i] - lo) / (hi - lo));
+  build_mips(tex);
+}
+
+// 8 x 8 cells of 8 texels: the white margin, the black border and the 4 x 4 bits
+void Rasterizer::build_marker(Texture &tex)
+{
+  tex.log2_size = 6;
+  tex.levels.assign(1, std::vector<uint8_t>(64 * 64));
+  for (int y = 0; y < 64; y++)
+  {
+    for (int x = 0; x < 64; x++)
+    {
+      const int row = y / 8, col = x / 8;
+      uint8_t value;
+      if (row == 0 || row == 7 || col == 0 || col == 7)
+        value = 255;
+      else if (row == 1 || row == 6 || col == 1 || col == 6)
+        value = 0;
+      else
+        value = MARKER_BITS[row - 2][col - 2] ? 255 : 0;
+      tex.levels[0][y * 64 + x] = value;
+    }
+  }
+  build_mips(tex);
+}
+
+void Rasterizer::build_mips(Texture &tex)
+{
+  for (int size = 1 << (tex.log2_size - 1); size >= 1; size /= 2)
+  {
+    const std::vector<uint8_t>& src = tex.levels.back();
+    std::vector<uint8_t> dst(size * size);
+    for (int y = 0; y < size; y++)
+    {
+      for (int x = 0; x < size; x++)
+      {
+        const uint8_t* s = src.data() + 2 * y * 2 * size + 2 * x;
+        dst[y * size + x] = (s[0] + s[1] + s[2 * size] + s[2 * size + 1] + 2) / 4;
+      }
+    }
+    tex.levels.push_back(dst);
+  }
+}
+
+void Rasterizer::set_ground(double level, double texel_size)
+{
+  has_ground_ = true;
+  ground_ = level;
+  ground_texel_size_ = texel_size;
+}
+
+int Rasterizer::add_quad(const Vector3d &corner, const Vector3d &u, const Vector3d &v, Material material,
+                         double texel_size)
+{
+  Quad q;
+  q.corner = corner;
+  q.u = u;
+  q.v = v;
+  q.material = material;
+  q.texel_size = texel_size;
+  quads_.push_back(q);
+  return quads_.size() - 1;
+}
+
+void Rasterizer::move_quad(int i, const Vector3d &corner, const Vector3d &u, const Vector3d &v)
+{
+  quads_[i].corner = corner;
+  quads_[i].u = u;
+  quads_[i].v = v;
+}
+
+// The plane's functions of the pixel coordinates, from the ray through pixel (x, y), which is
+// d = D0 + Dx x + Dy y in the camera frame (with d_z = 1, so depth along it is z).  A point z d
+// on the plane n . (z d - c) = 0 has 1/z = (n . d) / (n . c), and texture coordinate
+// a = k_a (z d - c) . u = z k_a (d . u) - k_a (c . u).  Returns false if the camera is in the
+// plane.
+bool Rasterizer::setup_plane(const Vector3d &corner, const Vector3d &u, const Vector3d &v,
+                             double a_texels, double b_texels, Plane &p) const
+{
+  const Matrix3d R = R_c2I_.transpose();
+  const Vector3d c = R * (corner - t_);
+  const Vector3d uc = R * u, vc = R * v;
+  const Vector3d n = uc.cross(vc);
+  const double nc = n.dot(c);
+  if (std::abs(nc) < 1e-9 * n.norm())
+    return false;
+
+  const Vector3d D0(-cx_ / fx_ + s_ * cy_ / (fx_ * fy_), -cy_ / fy_, 1.0);
+  const Vector3d Dx(1.0 / fx_, 0.0, 0.0);
+  const Vector3d Dy(-s_ / (fx_ * fy_), 1.0 / fy_, 0.0);
+  const double ka = a_texels / uc.squaredNorm(), kb = b_texels / vc.squaredNorm();
+  p.w[0] = n.dot(D0) / nc;
+  p.w[1] = n.dot(Dx) / nc;
+  p.w[2] = n.dot(Dy) / nc;
+  p.a[0] = ka * uc.dot(D0);
+  p.a[1] = ka * uc.dot(Dx);
+  p.a[2] = ka * uc.dot(Dy);
+  p.b[0] = kb * vc.dot(D0);
+  p.b[1] = kb * vc.dot(Dx);
+  p.b[2] = kb * vc.dot(Dy);
+  p.a0 = ka * uc.dot(c);
+  p.b0 = kb * vc.dot(c);
+  p.a_max = a_texels;
+  p.b_max = b_texels;
+  p.lod_scale = a_texels / uc.norm() * 2.0 / (fx_ + fy_);
+  return true;
+}
+
+void Rasterizer::render(const xform::Xformd &x_I2c, const Camera<double> &cam, GrayImage &img)
+{
+  img.resize(std::round(cam.image_size_(0)), std::round(cam.image_size_(1)));
+  img_ = &img;
+  R_c2I_.col(0) = x_I2c.q().rota(Vector3d::UnitX());
+  R_c2I_.col(1) = x_I2c.q().rota(Vector3d::UnitY());
+  R_c2I_.col(2) = x_I2c.q().rota(Vector3d::UnitZ());
+  t_ = x_I2c.t();
+  fx_ = cam.focal_len_(0);
+  fy_ = cam.focal_len_(1);
+  cx_ = cam.cam_center_(0);
+  cy_ = cam.cam_center_(1);
+  s_ = cam.s_;
+  tiles_x_ = (img.width + TILE - 1) / TILE;
+  tiles_y_ = (img.height + TILE - 1) / TILE;
+  bins_.resize(tiles_x_ * tiles_y_);
+  for (size_t i = 0; i < bins_.size(); i++)
+    bins_[i].clear();
+
+  // Light from above and to one side, so faces facing different ways differ
+  const Vector3d sun = Vector3d(0.3, 0.2, -1.0).normalized();
+
+  // The ground texture's origin is snapped to a whole period near the camera, so the texture
+  // stays put as the camera moves and the coordinates stay small
+  ground_visible_ = false;
+  if (has_ground_)
+  {
+    const Texture& tex = ground_texture_;
+    const double texels = 1 << tex.log2_size;
+    const double period = texels * ground_texel_size_;
+    const Vector3d origin(std::floor(t_.x() / period) * period, std::floor(t_.y() / period) * period, ground_);
+    Plane& p = ground_plane_;
+    ground_visible_ = setup_plane(origin, period * Vector3d::UnitX(), period * Vector3d::UnitY(), texels, texels, p);
+    p.a_max = p.b_max = std::numeric_limits<float>::infinity();
+    p.shade = 0.6 + 0.4 * std::max(-sun.z(), 0.0);
+    p.texture = &tex;
+    p.wrap = true;
+  }
+
+  planes_.clear();
+  for (size_t i = 0; i < quads_.size(); i++)
+  {
+    const Quad& q = quads_[i];
+    Plane p;
+    const bool marker = q.material == MARKER;
+    p.texture = marker ? &marker_texture_ : &wall_texture_;
+    const double size = 1 << p.texture->log2_size;
+    const double a_texels = marker ? size : q.u.norm() / q.texel_size;
+    const double b_texels = marker ? size : q.v.norm() / q.texel_size;
+    if (!setup_plane(q.corner, q.u, q.v, a_texels, b_texels, p))
+      continue;
+    p.wrap = !marker;
+    const Vector3d n = q.u.cross(q.v).normalized();
+    p.shade = marker ? 1.0 : 0.6 + 0.4 * std::abs(n.dot(sun));
+
+    // Bounds of the part of the rectangle in front of the near plane
+    Vector3d corners[4] = {q.corner, q.corner + q.u, q.corner + q.u + q.v, q.corner + q.v};
+    for (int k = 0; k < 4; k++)
+      corners[k] = R_c2I_.transpose() * (corners[k] - t_);
+    double x_lo = std::numeric_limits<double>::infinity(), x_hi = -x_lo;
+    double y_lo = x_lo, y_hi = x_hi;
+    for (int k = 0; k < 4; k++)
+    {
+      const Vector3d& a = corners[k];
+      const Vector3d& b = corners[(k + 1) % 4];
+      Vector3d clipped[2];
+      int m = 0;
+      if (a.z() >= NEAR)
+        clipped[m++] = a;
+      if ((a.z() >= NEAR) != (b.z() >= NEAR))
+        clipped[m++] = a + (NEAR - a.z()) / (b.z() - a.z()) * (b - a);
+      for (int j = 0; j < m; j++)
+      {
+        const double xn = clipped[j].x() / clipped[j].z(), yn = clipped[j].y() / clipped[j].z();
+        const double px = fx_ * xn + s_ * yn + cx_, py = fy_ * yn + cy_;
+        x_lo = std::min(x_lo, px);
+        x_hi = std::max(x_hi, px);
+        y_lo = std::min(y_lo, py);
+        y_hi = std::max(y_hi, py);
+      }
+    }
+    // Clamped before converting, as corners just past the near plane project far off the image
+    if (!(x_lo <= x_hi) || !(y_lo <= y_hi))
+      continue;
+    p.x0 = std::min(std::max(std::floor(x_lo), 0.0), (double)img.width);
+    p.y0 = std::min(std::max(std::floor(y_lo), 0.0), (double)img.height);
+    p.x1 = std::max(std::min(std::ceil(x_hi) + 1.0, (double)img.width), 0.0);
+    p.y1 = std::max(std::min(std::ceil(y_hi) + 1.0, (double)img.height), 0.0);
+    if (p.x0 >= p.x1 || p.y0 >= p.y1)
+      continue;
+
+    for (int ty = p.y0 / TILE; ty <= (p.y1 - 1) / TILE; ty++)
+    {
+      for (int tx = p.x0 / TILE; tx <= (p.x1 - 1) / TILE; tx++)
+        bins_[ty * tiles_x_ + tx].push_back(planes_.size());
+    }
+    planes_.push_back(p);
+  }
+
+  next_tile_ = 0;
+  if (!workers_.empty())
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      frame_++;
+      busy_ = workers_.size();
+    }
+    start_.notify_all();
+  }
+  render_tiles(buffers_[0]);
+  if (!workers_.empty())
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this]() { return busy_ == 0; });
+  }
+  img_ = nullptr;
+}
+
+void Rasterizer::worker(int index)
+{
+  uint64_t frame = 0;
+  while (true)
+  {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      start_.wait(lock, [&]() { return stop_ || frame_ != frame; });
+      if (stop_)
+        return;
+      frame = frame_;
+    }
+    render_tiles(buffers_[index]);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (--busy_ == 0)
+        done_.notify_one();
+    }
+  }
+}
+
+void Rasterizer::render_tiles(TileBuffer &buffer)
+{
+  const int num_tiles = tiles_x_ * tiles_y_;
+  for (int tile = next_tile_++; tile < num_tiles; tile = next_tile_++)
+    render_tile(tile, buffer);
+}
+
+// Visibility first, then one texture lookup per pixel, however many surfaces overlap it
+void Rasterizer::render_tile(int tile, TileBuffer &buffer)
+{
+  const int x0 = (tile % tiles_x_) * TILE, y0 = (tile / tiles_x_) * TILE;
+  const int x1 = std::min(x0 + TILE, img_->width), y1 = std::min(y0 + TILE, img_->height);
+  float* depth = buffer.depth.data();
+  int* surface = buffer.surface.data();
+  draw_ground(x0, y0, x1, y1, depth, surface);
+  const std::vector<int>& bin = bins_[tile];
+  for (size_t i = 0; i < bin.size(); i++)
+  {
+    const Plane& p = planes_[bin[i]];
+    draw_plane(p, bin[i], std::max(x0, p.x0), std::max(y0, p.y0), std::min(x1, p.x1), std::min(y1, p.y1),
+               depth, surface);
+  }
+  shade(x0, y0, x1, y1, depth, surface);
+}
+
+// The texture at (a, b) in texels, interpolated bilinearly in the mip level where a texel is
+// about a pixel.  Marker textures are clamped at their edges rather than wrapped
+inline float Rasterizer::sample(const Texture &tex, float a, float b, float texels_per_pixel, bool wrap)
+{
+  const int lod = texels_per_pixel > 1.0f ? std::min(floor_log2(texels_per_pixel), tex.log2_size) : 0;
+  const int size = 1 << (tex.log2_size - lod);
+  const float scale = 1.0f / (1 << lod);
+  const float fa = a * scale - 0.5f, fb = b * scale - 0.5f;
+  int a0 = floor_int(fa), b0 = floor_int(fb);
+  const float da = fa - a0, db = fb - b0;
+  int a1 = a0 + 1, b1 = b0 + 1;
+  if (wrap)
+  {
+    a0 &= size - 1;
+    a1 &= size - 1;
+    b0 &= size - 1;
+    b1 &= size - 1;
+  }
+  else
+  {
+    a0 = std::min(std::max(a0, 0), size - 1);
+    a1 = std::min(std::max(a1, 0), size - 1);
+    b0 = std::min(std::max(b0, 0), size - 1);
+    b1 = std::min(std::max(b1, 0), size - 1);
+  }
+  const uint8_t* level = tex.levels[lod].data();
+  const float top = level[b0 * size + a0] + da * (level[b0 * size + a1] - level[b0 * size + a0]);
+  const float bottom = level[b1 * size + a0] + da * (level[b1 * size + a1] - level[b1 * size + a0]);
+  return top + db * (bottom - top);
+}
+
+// The tile's buffers cover TILE x TILE pixels from the tile's corner (x0 and y0 are always a
+// tile corner here): depth holds 1/z, 0 for the sky, and surface the plane seen, GROUND or SKY
+void Rasterizer::draw_ground(int x0, int y0, int x1, int y1, float *depth, int *surface)
+{
+  const Span lanes = (Span() << 0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f).finished();
+  const Plane& p = ground_plane_;
+  for (int y = y0; y < y1; y++)
+  {
+    float* depth_row = depth + (y - y0) * TILE;
+    int* surface_row = surface + (y - y0) * TILE;
+    if (!ground_visible_)
+    {
+      std::fill(depth_row, depth_row + TILE, 0.0f);
+      std::fill(surface_row, surface_row + TILE, (int)SKY_SURFACE);
+      continue;
+    }
+    const float w_row = p.w[0] + p.w[2] * (y + 0.5f);
+    for (int x = x0; x < x1; x += 8)
+    {
+      const Span w = w_row + p.w[1] * (lanes + (float)x);
+      const Array<bool, 8, 1> visible = w > W_MIN;
+      Map<Span>(depth_row + (x - x0)) = visible.select(w, Span::Zero());
+      Map<Surface>(surface_row + (x - x0)) = visible.select(Surface::Constant(GROUND_SURFACE),
+                                                            Surface::Constant(SKY_SURFACE));
+    }
+  }
+}
+
+void Rasterizer::draw_plane(const Plane &p, int index, int x0, int y0, int x1, int y1, float *depth,
+                            int *surface)
+{
+  const Span lanes = (Span() << 0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f).finished();
+  const Span lane_index = (Span() << 0, 1, 2, 3, 4, 5, 6, 7).finished();
+  const int tile_x = x0 - x0 % TILE, tile_y = y0 - y0 % TILE;
+  // Runs start at multiples of 8 from the tile's corner, so they never leave the tile
+  const int x_start = x0 - (x0 - tile_x) % 8;
+  for (int y = y0; y < y1; y++)
+  {
+    float* depth_row = depth + (y - tile_y) * TILE;
+    int* surface_row = surface + (y - tile_y) * TILE;
+    const float yc = y + 0.5f;
+    const float w_row = p.w[0] + p.w[2] * yc, a_row = p.a[0] + p.a[2] * yc, b_row = p.b[0] + p.b[2] * yc;
+    for (int x = x_start; x < x1; x += 8)
+    {
+      const Span xc = lanes + (float)x;
+      const Span w = w_row + p.w[1] * xc;
+      Map<Span> d(depth_row + (x - tile_x));
+      const Span z = w.inverse();
+      const Span a = (a_row + p.a[1] * xc) * z - p.a0;
+      const Span b = (b_row + p.b[1] * xc) * z - p.b0;
+      const Span column = lane_index + (float)x;
+      const Array<bool, 8, 1> inside = w > d && w > W_MIN && a >= 0.0f && a < p.a_max && b >= 0.0f && b < p.b_max
+                                       && column >= (float)x0 && column < (float)x1;
+      d = inside.select(w, d);
+      Map<Surface> s(surface_row + (x - tile_x));
+      s = inside.select(Surface::Constant(index), s);
+    }
+  }
+}
+
+// Textures the surface left in front at each pixel, from its 1/z in the depth buffer
+void Rasterizer::shade(int x0, int y0, int x1, int y1, const float *depth, const int *surface)
+{
+  for (int y = y0; y < y1; y++)
+  {
+    uint8_t* row = img_->row(y);
+    const float* depth_row = depth + (y - y0) * TILE;
+    const int* surface_row = surface + (y - y0) * TILE;
+    const float yc = y + 0.5f;
+    for (int x = x0; x < x1; x++)
+    {
+      const int s = surface_row[x - x0];
+      if (s == SKY_SURFACE)
+      {
+        row[x] = SKY;
+        continue;
+      }
+      const Plane& p = s == GROUND_SURFACE ? ground_plane_ : planes_[s];
+      const float xc = x + 0.5f;
+      const float z = 1.0f / depth_row[x - x0];
+      const float a = (p.a[0] + p.a[1] * xc + p.a[2] * yc) * z - p.a0;
+      const float b = (p.b[0] + p.b[1] * xc + p.b[2] * yc) * z - p.b0;
+      row[x] = (uint8_t)(p.shade * sample(*p.texture, a, b, z * p.lod_scale, p.wrap));
+    }
+  }
+}
+
+}
@@ -0,0 +1,435 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <stdexcept>
+
+#include "multirotor_sim/recorder.h"
+
+namespace multirotor_sim
+{
+
+static const char REC_MAGIC[8] = {'M', 'S', 'I', 'M', 'R', 'E', 'C', '\0'};
+
+MeasurementRecorder::MeasurementRecorder() :
+  file_(nullptr),
+  failed_(false),
+  num_records_(0)
+{}
+
+MeasurementRecorder::~MeasurementRecorder()
+{
+  close();
+}
+
+bool MeasurementRecorder::open(const std::string &filename)
+{
+  close();
+  failed_ = false;
+  satellites_.clear();
+  num_records_ = 0;
+  file_ = fopen(filename.c_str(), "wb");
+  if (!file_)
+    return false;
+  uint32_t header[2] = {recording::VERSION, 0};
+  if (fwrite(REC_MAGIC, 1, sizeof(REC_MAGIC), file_) != sizeof(REC_MAGIC)
+      || fwrite(header, sizeof(uint32_t), 2, file_) != 2)
+  {
+    failed_ = true;
+    close();
+    return false;
+  }
+  return true;
+}
+
+bool MeasurementRecorder::close()
+{
+  if (file_)
+  {
+    // A full disk may only show when the buffer is flushed
+    if (fclose(file_) != 0)
+      failed_ = true;
+    file_ = nullptr;
+  }
+  return !failed_;
+}
+
+void MeasurementRecorder::begin(recording::Type type)
+{
+  record_.resize(recording::RECORD_HEADER_SIZE);
+  uint32_t t = type;
+  memcpy(record_.data(), &t, sizeof(t));
+}
+
+void MeasurementRecorder::put(const void *data, size_t size)
+{
+  record_.insert(record_.end(), (const uint8_t*)data, (const uint8_t*)data + size);
+}
+
+void MeasurementRecorder::end()
+{
+  uint32_t size = record_.size() - recording::RECORD_HEADER_SIZE;
+  memcpy(record_.data() + sizeof(uint32_t), &size, sizeof(size));
+  record_.resize((record_.size() + 7) & ~7, 0);
+  if (!file_)
+    return;
+  if (fwrite(record_.data(), 1, record_.size(), file_) != record_.size())
+  {
+    failed_ = true;
+    close();
+    return;
+  }
+  ++num_records_;
+}
+
+void MeasurementRecorder::put_image(const ImageFeat &z)
+{
+  int32_t id = z.id;
+  uint32_t npix = z.pixs.size();
+  uint32_t nids = z.feat_ids.size();
+  put(id);
+  put(z.t);
+  put(npix);
+  put(nids);
+  for (uint32_t i = 0; i < npix; i++)
+    put_matrix(z.pixs[i]);
+  for (uint32_t i = 0; i < nids; i++)
+    put((int32_t)z.feat_ids[i]);
+}
+
+void MeasurementRecorder::imuCallback(const double &t, const Vector6d &z, const Matrix6d &R)
+{
+  begin(recording::IMU); put(t); put_matrix(z); put_matrix(R); end();
+}
+
+void MeasurementRecorder::altCallback(const double &t, const Vector1d &z, const Matrix1d &R)
+{
+  begin(recording::ALT); put(t); put_matrix(z); put_matrix(R); end();
+}
+
+void MeasurementRecorder::baroCallback(const double &t, const Vector1d &z, const Matrix1d &R)
+{
+  begin(recording::BARO); put(t); put_matrix(z); put_matrix(R); end();
+}
+
+void MeasurementRecorder::mocapCallback(const double &t, const Xformd &z, const Matrix6d &R)
+{
+  begin(recording::MOCAP); put(t); put_matrix(z.elements()); put_matrix(R); end();
+}
+
+void MeasurementRecorder::velocityCallback(const double &t, const Vector3d &z, const Matrix3d &R)
+{
+  begin(recording::VELOCITY); put(t); put_matrix(z); put_matrix(R); end();
+}
+
+void MeasurementRecorder::voCallback(const double &t, const Xformd &z, const Matrix6d &R)
+{
+  begin(recording::VO); put(t); put_matrix(z.elements()); put_matrix(R); end();
+}
+
+void MeasurementRecorder::imageCallback(const double &t, const ImageFeat &z, const Matrix2d &R_pix, const Matrix1d &R_depth)
+{
+  begin(recording::IMAGE); put(t); put_matrix(R_pix); put_matrix(R_depth); put_image(z); end();
+}
+
+void MeasurementRecorder::arucoCallback(const double &t, const Xformd &z, const Matrix6d &R)
+{
+  begin(recording::ARUCO); put(t); put_matrix(z.elements()); put_matrix(R); end();
+}
+
+void MeasurementRecorder::landmarksCallback(const double &t, const ImageFeat &z, const Matrix2d &R_pix)
+{
+  begin(recording::LANDMARKS); put(t); put_matrix(R_pix); put_image(z); end();
+}
+
+void MeasurementRecorder::gnssCallback(const double &t, const Vector6d &z, const Matrix6d &R)
+{
+  begin(recording::GNSS); put(t); put_matrix(z); put_matrix(R); end();
+}
+
+void MeasurementRecorder::rawGnssCallback(const GTime &t, const VecVec3 &z, const VecMat3 &R,
+                                          std::vector<Satellite, aligned_allocator<Satellite>> &sat,
+                                          const std::vector<bool> &slip)
+{
+  // The satellites (and their ephemerides) hardly ever change, only record them when they do
+  begin(recording::SATELLITES);
+  put((uint32_t)sat.size());
+  for (size_t i = 0; i < sat.size(); i++)
+  {
+    put((int32_t)sat[i].id_);
+    put((int32_t)sat[i].idx_);
+    put(sat[i].eph_);
+  }
+  if (record_.size() != satellites_.size() || memcmp(record_.data(), satellites_.data(), record_.size()) != 0)
+  {
+    satellites_ = record_;
+    end();
+  }
+
+  begin(recording::RAW_GNSS);
+  put(t.week);
+  put(t.tow_sec);
+  put((uint32_t)z.size());
+  for (size_t i = 0; i < z.size(); i++)
+    put_matrix(z[i]);
+  for (size_t i = 0; i < R.size(); i++)
+    put_matrix(R[i]);
+  for (size_t i = 0; i < slip.size(); i++)
+    put((uint8_t)slip[i]);
+  end();
+}
+
+
+MeasurementReplayer::MeasurementReplayer() :
+  data_(nullptr),
+  size_(0),
+  pos_(0),
+  ptr_(nullptr),
+  end_(nullptr),
+  t_(0),
+  type_(recording::NUM_TYPES)
+{}
+
+MeasurementReplayer::~MeasurementReplayer()
+{
+  close();
+}
+
+void MeasurementReplayer::open(const std::string &filename)
+{
+  close();
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw std::runtime_error("Unable to open recording " + filename);
+  struct stat st;
+  if (fstat(fd, &st) != 0)
+  {
+    ::close(fd);
+    throw std::runtime_error("Unable to stat recording " + filename);
+  }
+  size_ = st.st_size;
+  void* data = size_ > 0 ? mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+  ::close(fd);
+  if (data == MAP_FAILED)
+    throw std::runtime_error("Unable to map recording " + filename);
+  data_ = (const uint8_t*)data;
+  madvise(data, size_, MADV_SEQUENTIAL);
+
+  uint32_t version = 0;
+  if (size_ >= recording::HEADER_SIZE)
+    memcpy(&version, data_ + sizeof(REC_MAGIC), sizeof(version));
+  if (version != recording::VERSION || memcmp(data_, REC_MAGIC, sizeof(REC_MAGIC)) != 0)
+  {
+    close();
+    throw std::runtime_error(filename + " is not a multirotor_sim recording");
+  }
+  rewind();
+}
+
+void MeasurementReplayer::close()
+{
+  if (data_)
+    munmap((void*)data_, size_);
+  data_ = nullptr;
+  size_ = 0;
+}
+
+void MeasurementReplayer::rewind()
+{
+  pos_ = recording::HEADER_SIZE;
+  t_ = 0;
+  type_ = recording::NUM_TYPES;
+  sats_.clear();
+}
+
+void MeasurementReplayer::register_estimator(EstimatorBase *est)
+{
+  est_.push_back(est);
+}
+
+bool MeasurementReplayer::step()
+{
+  while (pos_ + recording::RECORD_HEADER_SIZE <= size_)
+  {
+    uint32_t header[2];
+    memcpy(header, data_ + pos_, sizeof(header));
+    size_t next = pos_ + ((recording::RECORD_HEADER_SIZE + header[1] + 7) & ~7);
+    if (next > size_)
+      return false; // truncated record
+    ptr_ = data_ + pos_ + recording::RECORD_HEADER_SIZE;
+    pos_ = next;
+    deliver((recording::Type)header[0], ptr_ + header[1]);
+    if (header[0] != recording::SATELLITES)
+      return true;
+  }
+  return false;
+}
+
+uint64_t MeasurementReplayer::run()
+{
+  uint64_t n = 0;
+  while (step())
+    ++n;
+  return n;
+}
+
+void MeasurementReplayer::need(size_t size) const
+{
+  if (size > (size_t)(end_ - ptr_))
+    throw std::runtime_error("Record overruns its payload in recording");
+}
+
+void MeasurementReplayer::get_image(ImageFeat &z)
+{
+  int32_t id;
+  uint32_t npix, nids;
+  get(id);
+  get(z.t);
+  get(npix);
+  get(nids);
+  // Checked before resizing, so a corrupt count can't allocate
+  need((size_t)npix * sizeof(double) * 2 + (size_t)nids * sizeof(int32_t));
+  z.id = id;
+  z.pixs.resize(npix);
+  z.feat_ids.resize(nids);
+  for (uint32_t i = 0; i < npix; i++)
+    get_matrix(z.pixs[i]);
+  for (uint32_t i = 0; i < nids; i++)
+  {
+    int32_t fid;
+    get(fid);
+    z.feat_ids[i] = fid;
+  }
+}
+
+void MeasurementReplayer::deliver(recording::Type type, const uint8_t* end)
+{
+  end_ = end;
+  double t;
+  switch (type)
+  {
+  case recording::IMU:
+  case recording::GNSS:
+  {
+    Vector6d z;
+    Matrix6d R;
+    get(t); get_matrix(z); get_matrix(R);
+    for (estVec::iterator it = est_.begin(); it != est_.end(); it++)
+    {
+      if (type == recording::IMU)
+        (*it)->imuCallback(t, z, R);
+      else
+        (*it)->gnssCallback(t, z, R);
+    }
+    break;
+  }
+  case recording::ALT:
+  case recording::BARO:
+  {
+    Vector1d z;
+    Matrix1d R;
+    get(t); get_matrix(z); get_matrix(R);
+    for (estVec::iterator it = est_.begin(); it != est_.end(); it++)
+    {
+      if (type == recording::ALT)
+        (*it)->altCallback(t, z, R);
+      else
+        (*it)->baroCallback(t, z, R);
+    }
+    break;
+  }
+  case recording::MOCAP:
+  case recording::VO:
+  case recording::ARUCO:
+  {
+    Matrix<double, 7, 1> arr;
+    Matrix6d R;
+    get(t); get_matrix(arr); get_matrix(R);
+    Xformd z(arr);
+    for (estVec::iterator it = est_.begin(); it != est_.end(); it++)
+    {
+      if (type == recording::MOCAP)
+        (*it)->mocapCallback(t, z, R);
+      else if (type == recording::VO)
+        (*it)->voCallback(t, z, R);
+      else
+        (*it)->arucoCallback(t, z, R);
+    }
+    break;
+  }
+  case recording::VELOCITY:
+  {
+    Vector3d z;
+    Matrix3d R;
+    get(t); get_matrix(z); get_matrix(R);
+    for (estVec::iterator it = est_.begin(); it != est_.end(); it++)
+      (*it)->velocityCallback(t, z, R);
+    break;
+  }
+  case recording::IMAGE:
+  {
+    Matrix2d R_pix;
+    Matrix1d R_depth;
+    get(t); get_matrix(R_pix); get_matrix(R_depth); get_image(img_);
+    for (estVec::iterator it = est_.begin(); it != est_.end(); it++)
+      (*it)->imageCallback(t, img_, R_pix, R_depth);
+    break;
+  }
+  case recording::LANDMARKS:
+  {
+    Matrix2d R_pix;
+    get(t); get_matrix(R_pix); get_image(img_);
+    for (estVec::iterator it = est_.begin(); it != est_.end(); it++)
+      (*it)->landmarksCallback(t, img_, R_pix);
+    break;
+  }
+  case recording::SATELLITES:
+  {
+    uint32_t n;
+    get(n);
+    need((size_t)n * (2 * sizeof(int32_t) + sizeof(eph_t)));
+    sats_.clear();
+    for (uint32_t i = 0; i < n; i++)
+    {
+      int32_t id, idx;
+      get(id);
+      get(idx);
+      sats_.push_back(Satellite(id, idx));
+      get(sats_.back().eph_);
+    }
+    return;
+  }
+  case recording::RAW_GNSS:
+  {
+    GTime gt;
+    uint32_t n;
+    get(gt.week);
+    get(gt.tow_sec);
+    get(n);
+    need((size_t)n * (sizeof(double) * (3 + 9) + sizeof(uint8_t)));
+    z_.resize(n);
+    R_.resize(n);
+    slip_.resize(n);
+    for (uint32_t i = 0; i < n; i++)
+      get_matrix(z_[i]);
+    for (uint32_t i = 0; i < n; i++)
+      get_matrix(R_[i]);
+    for (uint32_t i = 0; i < n; i++)
+    {
+      uint8_t s;
+      get(s);
+      slip_[i] = s;
+    }
+    t = gt.tow_sec;
+    for (estVec::iterator it = est_.begin(); it != est_.end(); it++)
+      (*it)->rawGnssCallback(gt, z_, R_, sats_, slip_);
+    break;
+  }
+  default:
+    throw std::runtime_error("Unknown record type in recording");
+  }
+  t_ = t;
+  type_ = type;
+}
+
+}
@@ -0,0 +1,352 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <Eigen/Geometry>
+
+#include "multirotor_sim/scene.h"
+
+using namespace Eigen;
+
+namespace multirotor_sim
+{
+
+static const int LEAF_SIZE = 4;
+static const int MAX_DEPTH = 64; // of the traversal stack, far more than a median split needs
+
+// 1/d, with a huge finite value for d = 0 so the slab tests never see 0 * inf
+static inline double safe_inverse(double d)
+{
+  return std::abs(d) > 1e-15 ? 1.0 / d : 1e15;
+}
+
+Scene::Scene() :
+  has_ground_(false),
+  ground_(0)
+{}
+
+void Scene::clear()
+{
+  has_ground_ = false;
+  rects_.clear();
+  nodes_.clear();
+}
+
+void Scene::set_ground(double level)
+{
+  has_ground_ = true;
+  ground_ = level;
+}
+
+void Scene::add_rect(const Vector3d &corner, const Vector3d &u, const Vector3d &v)
+{
+  Rect r;
+  r.corner = corner;
+  r.u = u;
+  r.v = v;
+  r.normal = u.cross(v);
+  r.u_inv_sqr = 1.0 / u.squaredNorm();
+  r.v_inv_sqr = 1.0 / v.squaredNorm();
+  rects_.push_back(r);
+}
+
+void Scene::add_wall(const Vector3d &bottom_left, const Vector3d &normal, double width, double height)
+{
+  Vector3d along = normal.cross(Vector3d::UnitZ()).normalized();
+  add_rect(bottom_left, width * along, -height * Vector3d::UnitZ());
+}
+
+void Scene::add_box(const Vector3d &lo, const Vector3d &hi)
+{
+  const Vector3d size = hi - lo;
+  const Vector3d x = size.x() * Vector3d::UnitX();
+  const Vector3d y = size.y() * Vector3d::UnitY();
+  const Vector3d z = size.z() * Vector3d::UnitZ();
+  add_rect(lo, x, y);
+  add_rect(lo, y, z);
+  add_rect(lo, z, x);
+  add_rect(hi, -x, -y);
+  add_rect(hi, -y, -z);
+  add_rect(hi, -z, -x);
+}
+
+void Scene::build()
+{
+  nodes_.clear();
+  if (!rects_.empty())
+    build_node(0, rects_.size());
+}
+
+// Splits the rectangles at the median of their centres along the widest axis, reordering
+// rects_ so every leaf's are contiguous
+int Scene::build_node(int first, int count)
+{
+  Node node;
+  node.lo.setConstant(std::numeric_limits<double>::infinity());
+  node.hi.setConstant(-std::numeric_limits<double>::infinity());
+  Vector3d centre_lo = node.lo, centre_hi = node.hi;
+  for (int i = first; i < first + count; i++)
+  {
+    const Rect& r = rects_[i];
+    Vector3d far_corner = r.corner + r.u + r.v;
+    node.lo = node.lo.cwiseMin(r.corner).cwiseMin(far_corner).cwiseMin(r.corner + r.u).cwiseMin(r.corner + r.v);
+    node.hi = node.hi.cwiseMax(r.corner).cwiseMax(far_corner).cwiseMax(r.corner + r.u).cwiseMax(r.corner + r.v);
+    Vector3d centre = r.corner + 0.5 * (r.u + r.v);
+    centre_lo = centre_lo.cwiseMin(centre);
+    centre_hi = centre_hi.cwiseMax(centre);
+  }
+  node.left = node.right = -1;
+  node.axis = 0;
+  node.first = first;
+  node.count = count;
+  int index = nodes_.size();
+  nodes_.push_back(node);
+  if (count <= LEAF_SIZE)
+    return index;
+
+  int axis;
+  (centre_hi - centre_lo).maxCoeff(&axis);
+  int half = count / 2;
+  std::nth_element(rects_.begin() + first, rects_.begin() + first + half, rects_.begin() + first + count,
+                   [axis](const Rect& a, const Rect& b)
+  {
+    return (2.0 * a.corner + a.u + a.v)(axis) < (2.0 * b.corner + b.u + b.v)(axis);
+  });
+  int left = build_node(first, half);
+  int right = build_node(first + half, count - half);
+  nodes_[index].left = left;
+  nodes_[index].right = right;
+  nodes_[index].axis = axis;
+  nodes_[index].count = 0;
+  return index;
+}
+
+double Scene::intersect(const Rect &r, const Vector3d &origin, const Vector3d &dir) const
+{
+  double denom = r.normal.dot(dir);
+  if (std::abs(denom) < 1e-12)
+    return std::numeric_limits<double>::infinity();
+  double t = r.normal.dot(r.corner - origin) / denom;
+  Vector3d p = origin + t * dir - r.corner;
+  double a = p.dot(r.u) * r.u_inv_sqr;
+  double b = p.dot(r.v) * r.v_inv_sqr;
+  if (t <= 0 || a < 0 || a > 1 || b < 0 || b > 1)
+    return std::numeric_limits<double>::infinity();
+  return t;
+}
+
+bool Scene::cast(const Vector3d &origin, const Vector3d &dir, double max_range, double &range, int *surface) const
+{
+  double best = max_range;
+  int hit = NONE;
+  if (has_ground_)
+  {
+    double t = (ground_ - origin.z()) / dir.z();
+    if (t > 0 && t < best)
+    {
+      best = t;
+      hit = GROUND;
+    }
+  }
+
+  if (!nodes_.empty())
+  {
+    const Vector3d inv(safe_inverse(dir.x()), safe_inverse(dir.y()), safe_inverse(dir.z()));
+    int stack[MAX_DEPTH];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0)
+    {
+      const Node& node = nodes_[stack[--top]];
+      const Array3d t0 = (node.lo - origin).array() * inv.array();
+      const Array3d t1 = (node.hi - origin).array() * inv.array();
+      if (std::max(t0.min(t1).maxCoeff(), 0.0) > std::min(t0.max(t1).minCoeff(), best))
+        continue;
+
+      if (node.count > 0)
+      {
+        for (int i = node.first; i < node.first + node.count; i++)
+        {
+          double t = intersect(rects_[i], origin, dir);
+          if (t < best)
+          {
+            best = t;
+            hit = i;
+          }
+        }
+      }
+      else if (dir(node.axis) > 0)
+      {
+        // Nearer child on top, so its hits cull more of the other
+        stack[top++] = node.right;
+        stack[top++] = node.left;
+      }
+      else
+      {
+        stack[top++] = node.left;
+        stack[top++] = node.right;
+      }
+    }
+  }
+
+  if (hit == NONE)
+    return false;
+  range = best;
+  if (surface)
+    *surface = hit;
+  return true;
+}
+
+// The distance along each ray of a packet to rectangle r, infinite where it misses, with array
+// arithmetic and selects rather than branches
+Scene::Lane Scene::intersect(const Rect &r, const Vector3d &origin, const Lane &dx, const Lane &dy,
+                             const Lane &dz) const
+{
+  const Lane denom = r.normal.x() * dx + r.normal.y() * dy + r.normal.z() * dz;
+  const double num = r.normal.dot(r.corner - origin);
+  // Rays parallel to the rectangle get t = -1, so they fail the t > 0 test below
+  const Lane t = (denom.abs() > 1e-12).select(num / denom, Lane::Constant(-1.0));
+  const Lane px = origin.x() - r.corner.x() + t * dx;
+  const Lane py = origin.y() - r.corner.y() + t * dy;
+  const Lane pz = origin.z() - r.corner.z() + t * dz;
+  const Lane a = (px * r.u.x() + py * r.u.y() + pz * r.u.z()) * r.u_inv_sqr;
+  const Lane b = (px * r.v.x() + py * r.v.y() + pz * r.v.z()) * r.v_inv_sqr;
+  // Inside when a, 1 - a, b and 1 - b are all non-negative
+  const Lane inside = a.min(1.0 - a).min(b.min(1.0 - b));
+  return (inside >= 0.0 && t > 0.0).select(t, Lane::Constant(std::numeric_limits<double>::infinity()));
+}
+
+void Scene::cast(const Vector3d &origin, const Matrix3Xd &dirs, double max_range, VectorXd &ranges) const
+{
+  ranges.resize(dirs.cols());
+  for (Index i = 0; i < dirs.cols(); i += PACKET)
+    cast_packet(origin, dirs.col(i).data(), std::min<Index>(PACKET, dirs.cols() - i), max_range, ranges.data() + i);
+}
+
+// Pops nodes off a packet's traversal stack until it reaches a leaf that some ray overlaps before
+// its reach t_max (rays with a negative reach are finished), and returns it, or -1 once the stack
+// is empty.  Inner nodes push their children, nearer on top so its hits cull more of the other;
+// the rays in a packet are coherent, so the first one's direction picks which that is.
+int Scene::next_leaf(const Vector3d &origin, const Lane &ix, const Lane &iy, const Lane &iz, const Lane &t_max,
+                     int *stack, int &top) const
+{
+  while (top > 0)
+  {
+    const int index = stack[--top];
+    const Node& node = nodes_[index];
+    const Lane tx0 = (node.lo.x() - origin.x()) * ix, tx1 = (node.hi.x() - origin.x()) * ix;
+    const Lane ty0 = (node.lo.y() - origin.y()) * iy, ty1 = (node.hi.y() - origin.y()) * iy;
+    const Lane tz0 = (node.lo.z() - origin.z()) * iz, tz1 = (node.hi.z() - origin.z()) * iz;
+    const Lane t_near = tx0.min(tx1).max(ty0.min(ty1)).max(tz0.min(tz1)).max(0.0);
+    const Lane t_far = tx0.max(tx1).min(ty0.max(ty1)).min(tz0.max(tz1)).min(t_max);
+    if (!(t_near <= t_far).any())
+      continue;
+
+    if (node.count > 0)
+      return index;
+    if ((node.axis == 0 ? ix : node.axis == 1 ? iy : iz)[0] > 0)
+    {
+      stack[top++] = node.right;
+      stack[top++] = node.left;
+    }
+    else
+    {
+      stack[top++] = node.left;
+      stack[top++] = node.right;
+    }
+  }
+  return -1;
+}
+
+// Up to PACKET rays (x, y, z consecutive), the last repeated to fill the packet.  Every lane's
+// nearest hit is tracked at once: a node is entered if any ray's slab interval overlaps it, and a
+// rectangle is tested against all rays together.
+void Scene::cast_packet(const Vector3d &origin, const double *dirs, int n, double max_range, double *ranges) const
+{
+  Lane dx, dy, dz;
+  for (int k = 0; k < PACKET; k++)
+  {
+    const double* d = dirs + 3 * std::min(k, n - 1);
+    dx[k] = d[0];
+    dy[k] = d[1];
+    dz[k] = d[2];
+  }
+
+  Lane best = Lane::Constant(max_range);
+  if (has_ground_)
+  {
+    Lane t = (ground_ - origin.z()) / dz; // inf or nan for level rays, which the compare drops
+    best = (t > 0.0).select(best.min(t), best);
+  }
+
+  if (!nodes_.empty())
+  {
+    Lane ix, iy, iz;
+    for (int k = 0; k < PACKET; k++)
+    {
+      ix[k] = safe_inverse(dx[k]);
+      iy[k] = safe_inverse(dy[k]);
+      iz[k] = safe_inverse(dz[k]);
+    }
+
+    int stack[MAX_DEPTH];
+    int top = 0;
+    stack[top++] = 0;
+    for (int leaf; (leaf = next_leaf(origin, ix, iy, iz, best, stack, top)) >= 0;)
+    {
+      const Node& node = nodes_[leaf];
+      for (int i = node.first; i < node.first + node.count; i++)
+        best = best.min(intersect(rects_[i], origin, dx, dy, dz));
+    }
+  }
+
+  for (int k = 0; k < n; k++)
+    ranges[k] = best[k] < max_range ? best[k] : std::numeric_limits<double>::infinity();
+}
+
+void Scene::occluded(const Vector3d &origin, const double *points, int n, bool *blocked) const
+{
+  for (int i = 0; i < n; i += PACKET)
+    occluded_packet(origin, points + 3 * i, std::min<int>(PACKET, n - i), blocked + i);
+}
+
+// As cast_packet, but with unnormalized rays from origin to each point, so t = 1 at the point.
+// Any hit short of it blocks a ray, which sets its reach negative so no more nodes are entered
+// for it.
+void Scene::occluded_packet(const Vector3d &origin, const double *points, int n, bool *blocked) const
+{
+  // Just short of the point, so a landmark on a wall doesn't hide itself
+  const double limit = 1.0 - 1e-6;
+  Lane reach = Lane::Constant(limit);
+  if (!nodes_.empty())
+  {
+    Lane dx, dy, dz, ix, iy, iz;
+    for (int k = 0; k < PACKET; k++)
+    {
+      const double* p = points + 3 * std::min(k, n - 1);
+      dx[k] = p[0] - origin.x();
+      dy[k] = p[1] - origin.y();
+      dz[k] = p[2] - origin.z();
+      ix[k] = safe_inverse(dx[k]);
+      iy[k] = safe_inverse(dy[k]);
+      iz[k] = safe_inverse(dz[k]);
+    }
+
+    int stack[MAX_DEPTH];
+    int top = 0;
+    stack[top++] = 0;
+    for (int leaf; (leaf = next_leaf(origin, ix, iy, iz, reach, stack, top)) >= 0;)
+    {
+      const Node& node = nodes_[leaf];
+      for (int i = node.first; i < node.first + node.count; i++)
+        reach = (intersect(rects_[i], origin, dx, dy, dz) < limit).select(-1.0, reach);
+      if ((reach < 0.0).all())
+        break;
+    }
+  }
+
+  for (int k = 0; k < n; k++)
+    blocked[k] = reach[k] < 0.0;
+}
+
+}
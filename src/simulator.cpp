@@ -1,23 +1,57 @@
 #include "simulator.h"
 #include <Eigen/StdVector>
 #include <chrono>
+#include <cmath>
+#include <limits>
 
 #include "multirotor_sim/estimator_base.h"
 #include "multirotor_sim/controller.h"
+#include "multirotor_sim/platform_vehicle.h"
 
 using namespace std;
 
 namespace  multirotor_sim
 {
 
+// Optional <prefix>_latency and <prefix>_latency_jitter parameters (seconds)
+static LatencyModel load_latency(const std::string& prefix, const std::string& filename)
+{
+  LatencyModel latency;
+  get_yaml_node(prefix + "_latency", filename, latency.latency, false);
+  get_yaml_node(prefix + "_latency_jitter", filename, latency.jitter, false);
+  return latency;
+}
+
+// Makes sensor the next to deliver if its line's first measurement is released before (or with,
+// but made before) the current next, whose release time and timestamp are release and t
+template <typename T>
+static void next_release(const DelayLine<T>& line, int sensor, int& next, double& release, double& t)
+{
+  if (line.empty())
+    return;
+  const typename DelayLine<T>::Entry& e = line.front();
+  if (e.release < release || (e.release == release && (next < 0 || e.t < t)))
+  {
+    next = sensor;
+    release = e.release;
+    t = e.t;
+  }
+}
 
 Simulator::Simulator(bool prog_indicator, uint64_t seed) :
   seed_(seed == 0 ? std::chrono::system_clock::now().time_since_epoch().count() : seed),
   env_(seed_),
   rng_(seed_),
   uniform_(0.0, 1.0),
+  noise_(seed_ + 2),
   prog_indicator_(prog_indicator),
-  t_round_off_(1e7)
+  t_round_off_(1e7),
+  log_landmarks_(-1),
+  dispatch_(DISPATCH_SYNC),
+  estimator_queue_size_(1024),
+  render_camera_images_(false),
+  render_simple_cam_images_(false),
+  aruco_quad_(-1)
 {
   cont_ = static_cast<ControllerBase*>(&ref_con_);
   traj_ = static_cast<TrajectoryBase*>(&ref_con_);
@@ -30,8 +64,10 @@ Simulator::~Simulator()
   if (prog_indicator_)
     cout << endl;
 
-  if (log_.is_open())
-    log_.close();
+  log_.close();
+
+  if (trace_.enabled() && !trace_filename_.empty())
+    trace_.write_chrome_trace(trace_filename_);
 }
 
 
@@ -45,15 +81,62 @@ void Simulator::load(string filename)
   if (seed_ == 0)
     seed_ = std::chrono::system_clock::now().time_since_epoch().count();
   rng_ = default_random_engine(seed_);
+  noise_.seed(seed_ + 2);
   srand(seed_);
 
-  // Log
+  // Event timeline (optional)
+  int trace_capacity = 1 << 18;
+  get_yaml_node("trace_filename", filename, trace_filename_, false);
+  get_yaml_node("trace_capacity", filename, trace_capacity, false);
+  if (!trace_filename_.empty())
+    trace_.init(trace_capacity);
+
+  // Log, written from a separate thread by default so run() doesn't wait on the disk
   get_yaml_node("log_filename", filename, log_filename_);
-  if (!log_filename_.empty())
+  bool log_async = true;
+  bool log_drop_when_full = false;
+  int log_buffer_size = 1 << 20;
+  int log_num_buffers = 4;
+  get_yaml_node("log_async", filename, log_async, false);
+  get_yaml_node("log_buffer_size", filename, log_buffer_size, false);
+  get_yaml_node("log_num_buffers", filename, log_num_buffers, false);
+  get_yaml_node("log_drop_when_full", filename, log_drop_when_full, false);
+  if (log_async)
+    log_.set_async(log_buffer_size, log_num_buffers, log_drop_when_full ? Logger::DROP : Logger::BLOCK);
+  else
+    log_.set_sync();
+  std::string log_compression = "none";
+  get_yaml_node("log_compression", filename, log_compression, false);
+  Logger::Compression compression = log_compression == "zstd" ? Logger::ZSTD
+                                  : log_compression == "lz4" ? Logger::LZ4
+                                  : Logger::NONE;
+  if ((compression == Logger::NONE && log_compression != "none") || !log_.set_compression(compression))
+    throw std::runtime_error("Unsupported log_compression " + log_compression);
+
+  // Recording of estimator callbacks (optional), delivered before any other estimator
+  std::string record_filename;
+  get_yaml_node("record_filename", filename, record_filename, false);
+  if (!record_filename.empty())
   {
-    log_.open(log_filename_);
+    if (!recorder_.open(record_filename))
+      throw std::runtime_error("Unable to open recording " + record_filename);
+    est_.insert(est_.begin(), &recorder_);
   }
 
+  // Estimators can run on their own threads, fed through lock-free queues
+  std::string dispatch = "sync";
+  int queue_size = 1024;
+  get_yaml_node("estimator_dispatch", filename, dispatch, false);
+  get_yaml_node("estimator_queue_size", filename, queue_size, false);
+  if (dispatch == "sync")
+    set_estimator_dispatch(DISPATCH_SYNC, queue_size);
+  else if (dispatch == "barrier")
+    set_estimator_dispatch(DISPATCH_BARRIER, queue_size);
+  else if (dispatch == "free_running")
+    set_estimator_dispatch(DISPATCH_FREE_RUNNING, queue_size);
+  else
+    throw std::runtime_error("Unknown estimator_dispatch " + dispatch);
+
   get_yaml_node("follow_vehicle", filename, follow_vehicle_);
 
   // Initialize Desired sensors
@@ -91,12 +174,18 @@ void Simulator::load(string filename)
   if (raw_gnss_enabled_)
     init_raw_gnss();
 
-  // Load sub-class parameters
+  // Load sub-class parameters.  The altimeter and renderer see the obstacles without the camera
   if (camera_enabled_)
     env_.load(filename);
+  else
+    env_.load_scene(filename);
+  init_renderer();
   dyn_.load(filename);
   ref_con_.load(filename);
 
+  if (!log_filename_.empty())
+    init_log();
+
   // Start Progress Bar
   if (prog_indicator_)
     prog_.init(std::round(tmax_/dt_), 40);
@@ -110,19 +199,52 @@ bool Simulator::run()
 {
   if (t_ < tmax_ - dt_ / 2.0) // Subtract half time step to prevent occasional extra iteration
   {
+    PROFILE_SCOPE(prof_, PROF_RUN);
+    // Stamped with the time the step advances to, as the spans inside it are
+    TraceSpan span(trace_, PROF_RUN, t_ + dt_);
+
     // Propagate forward in time and get new control input and true acceleration
     t_ += dt_;
-    landing_veh_->step(dt_);
-    traj_->getCommandedState(t_, xc_, ur_);
+    {
+      PROFILE_SCOPE(prof_, PROF_VEHICLE);
+      landing_veh_->step(dt_);
+    }
+    {
+      PROFILE_SCOPE(prof_, PROF_TRAJECTORY);
+      traj_->getCommandedState(t_, xc_, ur_);
+    }
 
     if (follow_vehicle_)
       xc_.p.block<2, 1>(0, 0) += landing_veh_->getPosition();
 
-    cont_->computeControl(t_, dyn_.get_state(), xc_, ur_, u_);
-    dyn_.run(dt_, compute_low_level_control(u_));
+    {
+      PROFILE_SCOPE(prof_, PROF_CONTROL);
+      TraceSpan span(trace_, PROF_CONTROL, t_);
+      cont_->computeControl(t_, dyn_.get_state(), xc_, ur_, u_);
+    }
+    {
+      PROFILE_SCOPE(prof_, PROF_DYNAMICS);
+      TraceSpan span(trace_, PROF_DYNAMICS, t_);
+      dyn_.run(dt_, compute_low_level_control(u_));
+    }
+    if (log_.is_open())
+    {
+      log_.record(log_truth_) << t_ << dyn_.get_state().arr;
+      log_.record(log_commanded_) << t_ << xc_.arr;
+      log_.record(log_input_) << t_ << u_ << ur_;
+    }
     if (prog_indicator_)
+    {
+      PROFILE_SCOPE(prof_, PROF_PROGRESS);
       prog_.print(t_/dt_);
+    }
     update_measurements();
+    if (dispatch_ == DISPATCH_BARRIER)
+    {
+      PROFILE_SCOPE(prof_, PROF_ESTIMATOR_WAIT);
+      TraceSpan span(trace_, PROF_ESTIMATOR_WAIT, t_);
+      wait_for_estimators();
+    }
     return true;
   }
   else
@@ -142,6 +264,51 @@ void Simulator::init_platform()
     w_err_prev_ = Vector3d::Zero();
 }
 
+void Simulator::init_log()
+{
+  if (!log_.open(log_filename_))
+    throw std::runtime_error("Unable to open log file " + log_filename_);
+
+  log_truth_ = log_.add_channel(Logger::Channel("truth").add("t", Logger::F64)
+                                .add("p", Logger::F64, 3).add("q", Logger::F64, 4)
+                                .add("v", Logger::F64, 3).add("w", Logger::F64, 3));
+  log_commanded_ = log_.add_channel(Logger::Channel("commanded").add("t", Logger::F64)
+                                    .add("p", Logger::F64, 3).add("q", Logger::F64, 4)
+                                    .add("v", Logger::F64, 3).add("w", Logger::F64, 3));
+  log_input_ = log_.add_channel(Logger::Channel("input").add("t", Logger::F64)
+                                .add("u", Logger::F64, 4).add("ur", Logger::F64, 4));
+  log_imu_ = log_.add_channel(Logger::Channel("imu").add("t", Logger::F64)
+                              .add("accel", Logger::F64, 3).add("gyro", Logger::F64, 3));
+  log_alt_ = log_.add_channel(Logger::Channel("alt").add("t", Logger::F64).add("z", Logger::F64));
+  log_baro_ = log_.add_channel(Logger::Channel("baro").add("t", Logger::F64).add("z", Logger::F64));
+  log_mocap_ = log_.add_channel(Logger::Channel("mocap").add("t", Logger::F64).add("pub_t", Logger::F64)
+                                .add("p", Logger::F64, 3).add("q", Logger::F64, 4));
+  log_velocity_ = log_.add_channel(Logger::Channel("velocity").add("t", Logger::F64)
+                                   .add("v", Logger::F64, 3));
+  log_vo_ = log_.add_channel(Logger::Channel("vo").add("t", Logger::F64)
+                             .add("p", Logger::F64, 3).add("q", Logger::F64, 4));
+  log_aruco_ = log_.add_channel(Logger::Channel("aruco").add("t", Logger::F64)
+                                .add("p", Logger::F64, 3).add("q", Logger::F64, 4));
+  log_gnss_ = log_.add_channel(Logger::Channel("gnss").add("t", Logger::F64)
+                               .add("p_ecef", Logger::F64, 3).add("v_ecef", Logger::F64, 3));
+  if (raw_gnss_enabled_)
+  {
+    // One row of [pseudorange, pseudorange rate, carrier phase] per satellite
+    int n = satellites_.size();
+    log_raw_gnss_ = log_.add_channel(Logger::Channel("raw_gnss").add("t", Logger::F64)
+                                     .add("week", Logger::I64).add("tow", Logger::F64)
+                                     .add("z", Logger::F64, n, 3).add("slip", Logger::U8, n));
+  }
+  // Records are fixed size, so the landmark channel holds up to log_max_landmarks, with the
+  // count of those measured in n and the unused entries padded (with id -1)
+  int max_landmarks = 64;
+  get_yaml_node("log_max_landmarks", param_filename_, max_landmarks, false);
+  max_landmarks = std::max(max_landmarks, 1);
+  log_landmarks_ = log_.add_channel(Logger::Channel("landmarks").add("t", Logger::F64)
+                                    .add("n", Logger::I32).add("ids", Logger::I32, max_landmarks)
+                                    .add("pixs", Logger::F64, max_landmarks, 2));
+}
+
 void Simulator::init_imu()
 {
   // Load IMU parameters
@@ -177,6 +344,8 @@ void Simulator::init_imu()
   imu_R_.topLeftCorner<3,3>() = accel_noise * accel_noise * I_3x3;
   imu_R_.bottomRightCorner<3,3>() = gyro_noise * gyro_noise * I_3x3;
   last_imu_update_ = 0.0;
+  imu_latency_ = load_latency("imu", param_filename_);
+  imu_delay_.clear();
 }
 
 
@@ -199,6 +368,11 @@ void Simulator::init_simple_cam()
 
   lm_pixel_R_ = lm_pixel_noise_stdev_ * lm_pixel_noise_stdev_ * I_2x2;
 
+  const double aruco_pos_std = 0.1;
+  const double aruco_att_std = 0.1;
+  aruco_R_ = aruco_pos_std * aruco_pos_std * Matrix6d::Identity();
+  aruco_R_.bottomRightCorner(3, 3) = aruco_att_std * aruco_att_std * Eigen::Matrix3d::Identity();
+
   get_yaml_eigen("q_b_sc", param_filename_, x_b2sc_.q_.arr_);
   get_yaml_eigen("p_b_sc", param_filename_, x_b2sc_.t_);
 
@@ -207,6 +381,9 @@ void Simulator::init_simple_cam()
   //static const int num_feats = 1;
   //sc_feats_.reserve(num_feats);
   last_simple_cam_update_ = 0.;
+  simple_cam_latency_ = load_latency("simple_cam", param_filename_);
+  aruco_delay_.clear();
+  landmarks_delay_.clear();
 }
 
 
@@ -246,7 +423,15 @@ void Simulator::init_camera()
   depth_R_ << depth_noise * depth_noise;
 
   tracked_points_.reserve(num_features_);
+  tracked_ids_.reserve(num_features_);
+  frustum_ids_.clear();
+  frustum_next_ = 0;
+  num_candidates_ = next_candidate_ = 0;
+  occlusion_points_.resize(3, std::max<int>(num_features_, Scene::PACKET));
+  occluded_.resize(occlusion_points_.cols());
   img_.reserve(num_features_);
+  camera_latency_ = LatencyModel(camera_transmission_time_, camera_transmission_noise_);
+  camera_delay_.clear();
 }
 
 
@@ -260,6 +445,8 @@ void Simulator::init_altimeter()
   altimeter_noise_stdev_ = altimeter_noise * !use_altimeter_truth;
   alt_R_ << altimeter_noise * altimeter_noise;
   last_altimeter_update_ = 0.0;
+  alt_latency_ = load_latency("altimeter", param_filename_);
+  alt_delay_.clear();
 }
 
 void Simulator::init_baro()
@@ -279,6 +466,8 @@ void Simulator::init_baro()
   baro_bias_ = normal_(rng_) * baro_bias_walk_stdev_;
   baro_R_ << baro_noise * baro_noise;
   last_baro_update_ = 0.0;
+  baro_latency_ = load_latency("baro", param_filename_);
+  baro_delay_.clear();
 }
 
 
@@ -298,6 +487,8 @@ void Simulator::init_vo()
   vo_R_.setIdentity();
   vo_R_.block<3,3>(0,0) *= vo_translation_noise * vo_translation_noise;
   vo_R_.block<3,3>(3,3) *= vo_rotation_noise * vo_rotation_noise;
+  vo_latency_ = load_latency("vo", param_filename_);
+  vo_delay_.clear();
 }
 
 
@@ -325,6 +516,8 @@ void Simulator::init_mocap()
 
   last_mocap_update_ = 0.0;
   next_mocap_measurement_ = 0.0;
+  mocap_latency_ = LatencyModel(mocap_transmission_time_, mocap_transmission_noise_);
+  mocap_delay_.clear();
 }
 
 
@@ -339,6 +532,8 @@ void Simulator::init_velocity()
 
   last_velocity_update_ = 0.0;
   next_velocity_measurement_ = 0.0;
+  velocity_latency_ = load_latency("velocity", param_filename_);
+  velocity_delay_.clear();
 }
 
 
@@ -369,6 +564,8 @@ void Simulator::init_gnss()
   //gnss_vel_block = X_e2n_.q().R().transpose() * gnss_vel_block * X_e2n_.q().R();
 
   last_gnss_update_ = 0.0;
+  gnss_latency_ = load_latency("gnss", param_filename_);
+  gnss_delay_.clear();
 }
 
 void Simulator::init_raw_gnss()
@@ -419,13 +616,100 @@ void Simulator::init_raw_gnss()
 
   clock_bias_ = uniform_(rng_) * clock_init_stdev_;
   last_raw_gnss_update_ = 0.0;
+  raw_gnss_latency_ = load_latency("raw_gnss", param_filename_);
+  raw_gnss_delay_.clear();
+}
+
+// Rendered images of the environment's ground and obstacles, and of the ArUco marker, mirroring
+// what the feature and simple camera measurements see
+void Simulator::init_renderer()
+{
+  bool render_camera = false;
+  bool render_simple_cam = false;
+  int threads = 1;
+  double ground_texel_size = 0.05;
+  double wall_texel_size = 0.02;
+  double aruco_size = 1.0;
+  get_yaml_node("render_camera_images", param_filename_, render_camera, false);
+  get_yaml_node("render_simple_cam_images", param_filename_, render_simple_cam, false);
+  get_yaml_node("render_threads", param_filename_, threads, false);
+  get_yaml_node("render_ground_texel_size", param_filename_, ground_texel_size, false);
+  get_yaml_node("render_wall_texel_size", param_filename_, wall_texel_size, false);
+  get_yaml_node("render_aruco_size", param_filename_, aruco_size, false);
+  render_camera_images_ = render_camera && camera_enabled_;
+  render_simple_cam_images_ = render_simple_cam && simple_cam_enabled_;
+  camera_image_delay_.clear();
+  simple_cam_image_delay_.clear();
+  aruco_quad_ = -1;
+  if (!render_camera_images_ && !render_simple_cam_images_)
+  {
+    rasterizer_.reset();
+    return;
+  }
+
+  rasterizer_.reset(new Rasterizer(threads));
+  const Scene& scene = env_.scene();
+  if (scene.has_ground())
+    rasterizer_->set_ground(scene.ground(), ground_texel_size);
+  for (size_t i = 0; i < scene.num_rectangles(); i++)
+  {
+    Vector3d corner, u, v;
+    scene.rectangle(i, corner, u, v);
+    rasterizer_->add_quad(corner, u, v, Rasterizer::WALL, wall_texel_size);
+  }
+  // The marker's black square is aruco_size across, within a white margin of one of its cells
+  // (an eighth of the quad) on each side; the quad is placed each frame, as the vehicle moves
+  if (simple_cam_enabled_ && aruco_enabled_)
+  {
+    const double side = aruco_size * 8.0 / 6.0;
+    aruco_quad_ = rasterizer_->add_quad(Vector3d::Zero(), side * Vector3d::UnitX(), side * Vector3d::UnitY(),
+                                        Rasterizer::MARKER);
+    aruco_quad_side_ = side;
+  }
 }
 
+
 void Simulator::register_estimator(EstimatorBase *est)
 {
+  if (dispatch_ != DISPATCH_SYNC)
+  {
+    async_est_.emplace_back(new AsyncEstimator(est, estimator_queue_size_));
+    est = async_est_.back().get();
+  }
   est_.push_back(est);
 }
 
+void Simulator::set_estimator_dispatch(EstimatorDispatch dispatch, size_t queue_size)
+{
+  // Unwrap every estimator, then wrap them again for the new mode
+  wait_for_estimators();
+  for (estVec::iterator it = est_.begin(); it != est_.end(); it++)
+  {
+    for (size_t i = 0; i < async_est_.size(); i++)
+    {
+      if (*it == async_est_[i].get())
+        *it = async_est_[i]->estimator();
+    }
+  }
+  async_est_.clear();
+
+  dispatch_ = dispatch;
+  estimator_queue_size_ = queue_size;
+  if (dispatch_ == DISPATCH_SYNC)
+    return;
+  for (estVec::iterator it = est_.begin(); it != est_.end(); it++)
+  {
+    async_est_.emplace_back(new AsyncEstimator(*it, estimator_queue_size_));
+    *it = async_est_.back().get();
+  }
+}
+
+void Simulator::wait_for_estimators()
+{
+  for (size_t i = 0; i < async_est_.size(); i++)
+    async_est_[i]->wait();
+}
+
 void Simulator::use_custom_controller(ControllerBase *cont)
 {
   cont_ = cont;
@@ -441,6 +725,142 @@ void Simulator::use_custom_vehicle(VehicleBase *veh)
   landing_veh_ = veh;
 }
 
+Simulator::Snapshot Simulator::snapshot() const
+{
+  Snapshot snap;
+  snap.t = t_;
+  snap.u = u_;
+  snap.ur = ur_;
+  snap.xc = xc_;
+  snap.dyn = dyn_;
+  snap.ref_con = ref_con_;
+  snap.env = env_;
+  snap.rng = rng_;
+  snap.uniform = uniform_;
+  snap.normal = normal_;
+  snap.noise = noise_;
+  snap.w_err_prev = w_err_prev_;
+
+  snap.last_imu_update = last_imu_update_;
+  snap.accel_bias = accel_bias_;
+  snap.gyro_bias = gyro_bias_;
+  snap.last_simple_cam_update = last_simple_cam_update_;
+  snap.last_camera_update = last_camera_update_;
+  snap.next_feature_id = next_feature_id_;
+  snap.tracked_points = tracked_points_;
+  snap.image_id = image_id_;
+  snap.last_altimeter_update = last_altimeter_update_;
+  snap.last_baro_update = last_baro_update_;
+  snap.baro_bias = baro_bias_;
+  snap.X_I2bk = X_I2bk_;
+  snap.last_mocap_update = last_mocap_update_;
+  snap.next_mocap_measurement = next_mocap_measurement_;
+  snap.last_velocity_update = last_velocity_update_;
+  snap.next_velocity_measurement = next_velocity_measurement_;
+  snap.last_gnss_update = last_gnss_update_;
+  snap.gnss_position_noise = gnss_position_noise_;
+  snap.clock_bias = clock_bias_;
+  snap.clock_bias_rate = clock_bias_rate_;
+  snap.multipath_offset = multipath_offset_;
+  snap.carrier_phase_integer_offsets = carrier_phase_integer_offsets_;
+  snap.satellites = satellites_;
+  snap.last_raw_gnss_update = last_raw_gnss_update_;
+
+  snap.imu_delay = imu_delay_;
+  snap.camera_delay = camera_delay_;
+  snap.alt_delay = alt_delay_;
+  snap.baro_delay = baro_delay_;
+  snap.mocap_delay = mocap_delay_;
+  snap.velocity_delay = velocity_delay_;
+  snap.vo_delay = vo_delay_;
+  snap.gnss_delay = gnss_delay_;
+  snap.raw_gnss_delay = raw_gnss_delay_;
+  snap.aruco_delay = aruco_delay_;
+  snap.landmarks_delay = landmarks_delay_;
+  snap.camera_image_delay = camera_image_delay_;
+  snap.simple_cam_image_delay = simple_cam_image_delay_;
+
+  const PlatformVehicle* platform = dynamic_cast<const PlatformVehicle*>(landing_veh_);
+  snap.platform_t = platform ? platform->t() : std::numeric_limits<double>::quiet_NaN();
+  return snap;
+}
+
+void Simulator::restore(const Snapshot &snap)
+{
+  t_ = snap.t;
+  u_ = snap.u;
+  ur_ = snap.ur;
+  xc_ = snap.xc;
+  dyn_ = snap.dyn;
+  ref_con_ = snap.ref_con;
+  env_ = snap.env;
+  rng_ = snap.rng;
+  uniform_ = snap.uniform;
+  normal_ = snap.normal;
+  noise_ = snap.noise;
+  w_err_prev_ = snap.w_err_prev;
+
+  last_imu_update_ = snap.last_imu_update;
+  accel_bias_ = snap.accel_bias;
+  gyro_bias_ = snap.gyro_bias;
+  last_simple_cam_update_ = snap.last_simple_cam_update;
+  last_camera_update_ = snap.last_camera_update;
+  next_feature_id_ = snap.next_feature_id;
+  tracked_points_ = snap.tracked_points;
+  tracked_ids_.clear();
+  for (size_t i = 0; i < tracked_points_.size(); i++)
+    tracked_ids_.insert(tracked_points_[i].id);
+  image_id_ = snap.image_id;
+  last_altimeter_update_ = snap.last_altimeter_update;
+  last_baro_update_ = snap.last_baro_update;
+  baro_bias_ = snap.baro_bias;
+  X_I2bk_ = snap.X_I2bk;
+  last_mocap_update_ = snap.last_mocap_update;
+  next_mocap_measurement_ = snap.next_mocap_measurement;
+  last_velocity_update_ = snap.last_velocity_update;
+  next_velocity_measurement_ = snap.next_velocity_measurement;
+  last_gnss_update_ = snap.last_gnss_update;
+  gnss_position_noise_ = snap.gnss_position_noise;
+  clock_bias_ = snap.clock_bias;
+  clock_bias_rate_ = snap.clock_bias_rate;
+  multipath_offset_ = snap.multipath_offset;
+  carrier_phase_integer_offsets_ = snap.carrier_phase_integer_offsets;
+  satellites_ = snap.satellites;
+  last_raw_gnss_update_ = snap.last_raw_gnss_update;
+
+  imu_delay_ = snap.imu_delay;
+  camera_delay_ = snap.camera_delay;
+  alt_delay_ = snap.alt_delay;
+  baro_delay_ = snap.baro_delay;
+  mocap_delay_ = snap.mocap_delay;
+  velocity_delay_ = snap.velocity_delay;
+  vo_delay_ = snap.vo_delay;
+  gnss_delay_ = snap.gnss_delay;
+  raw_gnss_delay_ = snap.raw_gnss_delay;
+  aruco_delay_ = snap.aruco_delay;
+  landmarks_delay_ = snap.landmarks_delay;
+  camera_image_delay_ = snap.camera_image_delay;
+  simple_cam_image_delay_ = snap.simple_cam_image_delay;
+
+  // The deck goes back to where it was, so a forked landing sees the parent's platform motion
+  PlatformVehicle* platform = dynamic_cast<PlatformVehicle*>(landing_veh_);
+  if (platform && !std::isnan(snap.platform_t))
+    platform->reset(snap.platform_t);
+}
+
+void Simulator::reseed(uint64_t seed)
+{
+  seed_ = seed;
+  rng_.seed(seed);
+  dyn_.rng_.seed(seed + 1);
+  noise_.seed(seed + 2);
+  ref_con_.reseed(seed + 3);
+  env_.reseed(seed + 4);
+  uniform_.reset();
+  normal_.reset();
+  dyn_.standard_normal_dist_.reset();
+}
+
 void Simulator::update_camera_pose()
 {
   x_I2c_ = state().X * x_b2c_;
@@ -453,38 +873,70 @@ void Simulator::update_simple_cam_pose()
 }
 
 
+void Simulator::render_image(GrayImage::Source source, int id, const Xformd &x_I2c, const Camera<double> &cam,
+                             DelayLine<std::shared_ptr<const GrayImage>> &line, double t, double release)
+{
+  PROFILE_SCOPE(prof_, PROF_RENDER);
+  TraceSpan span(trace_, PROF_RENDER, t_);
+  if (aruco_quad_ >= 0)
+  {
+    Vector3d p_I_a;
+    Quatd q_I_a;
+    landing_veh_->arucoLocation(p_I_a);
+    landing_veh_->arucoOrientation(q_I_a);
+    // Read along the marker's x axis, top to bottom against its y axis
+    const Vector3d x_a = q_I_a.rota(Vector3d::UnitX()), y_a = q_I_a.rota(Vector3d::UnitY());
+    const double s = aruco_quad_side_;
+    rasterizer_->move_quad(aruco_quad_, p_I_a + 0.5 * s * (y_a - x_a), s * x_a, -s * y_a);
+  }
+  std::shared_ptr<GrayImage> img = image_pool_.acquire(std::round(cam.image_size_(0)), std::round(cam.image_size_(1)));
+  img->source = source;
+  img->id = id;
+  rasterizer_->render(x_I2c, cam, *img);
+  line.push(t, release) = img;
+}
+
+
 void Simulator::update_imu_meas()
 {
+  PROFILE_SCOPE(prof_, PROF_IMU);
   double dt = t_ - last_imu_update_;
   if (std::round(dt * t_round_off_) / t_round_off_ >= 1.0/imu_update_rate_)
   {
     last_imu_update_ = t_;
 
     // Bias random walks and IMU noise
-    accel_bias_ += randomNormal<Vector3d>(accel_walk_stdev_, normal_, rng_) * dt;
-    gyro_bias_ += randomNormal<Vector3d>(gyro_walk_stdev_, normal_, rng_) * dt;
+    const double* noise = noise_.take(12);
+    accel_bias_ += accel_walk_stdev_ * dt * Map<const Vector3d>(noise);
+    gyro_bias_ += gyro_walk_stdev_ * dt * Map<const Vector3d>(noise + 3);
 
     // Populate accelerometer and gyro measurements
-    Vector6d imu;
-    imu.segment<3>(0) = dyn_.get_imu_accel() + accel_bias_ + randomNormal<Vector3d>(accel_noise_stdev_, normal_,  rng_);
-    imu.segment<3>(3) = dyn_.get_imu_gyro() + gyro_bias_ + randomNormal<Vector3d>(gyro_noise_stdev_, normal_,  rng_);;
-
-    for (estVec::iterator it = est_.begin(); it != est_.end(); it++)
-      (*it)->imuCallback(t_, imu, imu_R_);
+    double latency = imu_latency_.sample(normal_, rng_);
+    Vector6d& imu = imu_delay_.push(t_, t_ + latency);
+    imu.segment<3>(0) = dyn_.get_imu_accel() + accel_bias_ + accel_noise_stdev_ * Map<const Vector3d>(noise + 6);
+    imu.segment<3>(3) = dyn_.get_imu_gyro() + gyro_bias_ + gyro_noise_stdev_ * Map<const Vector3d>(noise + 9);
+    trace_.instant(PROF_IMU, t_, latency);
+    if (log_.is_open())
+      log_.record(log_imu_) << t_ << imu;
   }
 }
 
 
 void Simulator::update_simple_cam_meas()
 {
+  PROFILE_SCOPE(prof_, PROF_SIMPLE_CAM);
   // If it's time to capture new measurements, then do it
   if (std::round((t_ - last_simple_cam_update_) * t_round_off_) / t_round_off_ >= 1.0/simple_cam_update_rate_)
   {
     last_simple_cam_update_ = t_;
+    trace_.instant(PROF_SIMPLE_CAM, t_);
 
     // Move camera to correct location
     update_simple_cam_pose();
 
+    // The rendered image is delivered with the frame's first measurement
+    double frame_latency = -1.0;
+
     //////////////// Aruco update ////////////////
     if (aruco_enabled_)
     {
@@ -497,15 +949,15 @@ void Simulator::update_simple_cam_meas()
       const xform::Xformd x_I2a(aruco_pt_I, q_I_a);
       const xform::Xformd x_sc2a = x_I2sc_.inverse() * x_I2a;
 
-      xform::Xformd x_c2a_meas = x_sc2a;
-
-      const double aruco_pos_std = 0.1;
-      const double aruco_att_std = 0.1;
-      Eigen::Matrix<double, 6, 6> aruco_R_ = aruco_pos_std * aruco_pos_std * Matrix6d::Identity();
-      aruco_R_.bottomRightCorner(3, 3) = aruco_att_std * aruco_att_std * Eigen::Matrix3d::Identity();
+      double latency = simple_cam_latency_.sample(normal_, rng_);
+      frame_latency = latency;
+      xform::Xformd& x_c2a_meas = aruco_delay_.push(t_, t_ + latency);
+      x_c2a_meas = x_sc2a;
 
-      x_c2a_meas.t_ += randomNormal<Vector3d>(aruco_pos_std, normal_, rng_);
-      x_c2a_meas.q_ += randomNormal<Vector3d>(aruco_att_std, normal_, rng_);
+      x_c2a_meas.t_ += randomNormal<Vector3d>(std::sqrt(aruco_R_(0, 0)), normal_, rng_);
+      x_c2a_meas.q_ += randomNormal<Vector3d>(std::sqrt(aruco_R_(3, 3)), normal_, rng_);
+      if (log_.is_open())
+        log_.record(log_aruco_) << t_ << x_c2a_meas.elements();
 
       //// Not really depth, but distance in z direction
       //Vector3d aruco_pt_c = x_I2sc_.transformp(aruco_pt_I);
@@ -516,237 +968,262 @@ void Simulator::update_simple_cam_meas()
       //Vector2d aruco_pix;
       //simple_cam_.proj(aruco_pt_c, aruco_pix);
       //aruco_pix += randomNormal<Vector2d>(aruco_pixel_noise_stdev_, normal_, rng_);
-
-      for (estVec::iterator eit = est_.begin(); eit != est_.end(); eit++)
-          (*eit)->arucoCallback(t_, x_c2a_meas, aruco_R_);
-          //(*eit)->arucoCallback(t_, aruco_pix, measured_depth, aruco_pixel_R_, aruco_depth_R_);
+      //(*eit)->arucoCallback(t_, aruco_pix, measured_depth, aruco_pixel_R_, aruco_depth_R_);
     }
 
     //////////////// Landmarks update ////////////////
     if (landmarks_enabled_)
     {
-      // Get vehicle landmark points in the inertial frame
-      std::vector<int> lm_ids;
-      std::vector<Vector3d> lm_pts;
-      landing_veh_->landmarkLocations(lm_ids, lm_pts);
+      // Project every landmark on the vehicle at once, straight from the vehicle's arrays.
+      // Landmarks behind the camera or out of frame are still measured
+      const LandmarkView lms = landing_veh_->landmarks();
+      lm_projector_.set_points(lms.points());
+      lm_projector_.project(x_I2sc_, simple_cam_);
 
-      // Project each point into the camera frame and add it to our
-      // sc_landmarks_ msg
       sc_landmarks_.clear();
-      sc_landmarks_.feat_ids = lm_ids;
-
-      for (Vector3d pt : lm_pts)
-      {
-        Vector3d pt_c = x_I2sc_.transformp(pt);
-
-        // we can reject anything behind the camera
-        // if (pt_c(2) < 0.0)
-        // continue;
-
-        double pt_depth = pt_c.norm();
-        pt_c /= pt_depth;
-
-        Vector2d pix;
-        simple_cam_.proj(pt_c, pix);
-
-        pix += randomNormal<Vector2d>(lm_pixel_noise_stdev_, normal_, rng_);
-        sc_landmarks_.pixs.push_back(pix);
-      }
+      sc_landmarks_.feat_ids.assign(lms.ids, lms.ids + lms.size);
+      sc_landmarks_.pixs.resize(lms.size);
+      for (int i = 0; i < lms.size; i++)
+        sc_landmarks_.pixs[i] = lm_projector_.pixel(i) + randomNormal<Vector2d>(lm_pixel_noise_stdev_, normal_, rng_);
+      if (log_.is_open())
+        log_landmarks();
+
+      const double latency = simple_cam_latency_.sample(normal_, rng_);
+      if (frame_latency < 0.0)
+        frame_latency = latency;
+      landmarks_delay_.push(t_, t_ + latency) = sc_landmarks_;
+    }
 
-      for (estVec::iterator eit = est_.begin(); eit != est_.end(); eit++)
-        (*eit)->landmarksCallback(t_, sc_landmarks_, lm_pixel_R_);
+    if (render_simple_cam_images_)
+    {
+      // Only draw a latency of its own when there is no measurement to share one with
+      if (frame_latency < 0.0)
+        frame_latency = simple_cam_latency_.sample(normal_, rng_);
+      render_image(GrayImage::SIMPLE_CAM, 0, x_I2sc_, simple_cam_, simple_cam_image_delay_, t_,
+                   t_ + frame_latency);
     }
   }
 }
 
+void Simulator::log_landmarks()
+{
+  const int n = log_.channel(log_landmarks_).fields()[2].rows;
+  const int count = sc_landmarks_.pixs.size();
+  if (count > n)
+    throw std::runtime_error("The simple camera measured " + std::to_string(count)
+                             + " landmarks, more than log_max_landmarks (" + std::to_string(n) + ")");
+  Logger::Record rec = log_.record(log_landmarks_);
+  rec << t_ << (int32_t)count;
+  for (int i = 0; i < count; i++)
+    rec << (int32_t)sc_landmarks_.feat_ids[i];
+  rec.fill(n - count, (int32_t)-1);
+  for (int i = 0; i < count; i++)
+    rec << sc_landmarks_.pixs[i].transpose();
+}
+
 void Simulator::update_camera_meas()
 {
-  //// If it's time to capture new measurements, then do it
-  //if (std::round((t_ - last_camera_update_) * t_round_off_) / t_round_off_ >= 1.0/camera_update_rate_)
-  //{
-    //last_camera_update_ = t_;
-    //update_camera_pose();
-
-    //double pub_time = t_ + std::max(camera_transmission_time_ + normal_(rng_) * camera_transmission_noise_, 0.0);
-
-    //// Update feature measurements for currently tracked features
-    //for(auto it = tracked_points_.begin(); it != tracked_points_.end();)
-    //{
-      //if (update_feature(*it))
-      //{
-        //measurement_t meas;
-        //meas.t = t_ + camera_time_offset_;
-        //meas.z = it->pixel + randomNormal<Vector2d>(pixel_noise_stdev_, normal_, rng_);
-        //meas.R = feat_R_;
-        //meas.feature_id = (*it).id;
-        //meas.depth = it->depth + depth_noise_stdev_ * normal_(rng_);
-        //camera_measurements_buffer_.push_back(std::pair<double, measurement_t>{pub_time, meas});
-        //DBG("update feature - ID = %d\n", it->id);
-        //it++;
-      //}
-      //else
-      //{
-        //if (it->zeta(2,0) < 0)
-        //{
-          //DBG("clearing feature - ID = %d because went negative [%f, %f, %f]\n",
-              //it->id, it->zeta(0,0), it->zeta(1,0), it->zeta(2,0));
-        //}
-        //else if ((it->pixel.array() < 0).any() || (it->pixel.array() > cam_.image_size_.array()).any())
-        //{
-          //DBG("clearing feature - ID = %d because went out of frame [%f, %f]\n",
-              //it->id, it->pixel(0,0), it->pixel(1,0));
-        //}
-        //tracked_points_.erase(it);
-      //}
-    //}
-
-    //while (tracked_points_.size() < num_features_)
-    //{
-      //// Add the new feature to our "tracker"
-      //feature_t new_feature;
-      //if (!get_feature_in_frame(new_feature, loop_closure_))
-        //break;
-      //tracked_points_.push_back(new_feature);
-      //DBG("new feature - ID = %d [%f, %f, %f], [%f, %f]\n",
-          //new_feature.id, new_feature.zeta(0,0), new_feature.zeta(1,0),
-          //new_feature.zeta(2,0), new_feature.pixel(0,0), new_feature.pixel(1,0));
-
-      //// Create a measurement for this new feature
-      //measurement_t meas;
-      //meas.t = t_ + camera_time_offset_;
-      //meas.z = new_feature.pixel + randomNormal<Vector2d>(pixel_noise_stdev_, normal_, rng_);
-      //meas.R = feat_R_;
-      //meas.feature_id = new_feature.id;
-      //meas.depth = new_feature.depth + depth_noise_stdev_ * normal_(rng_);
-      //camera_measurements_buffer_.push_back(std::pair<double, measurement_t>{pub_time, meas});
-    //}
-  //}
-
-  //// Push out the measurement if it is time to send it
-  //if (camera_measurements_buffer_.size() > 0 && camera_measurements_buffer_[0].first >= t_)
-  //{
-    //// Populate the Image class with all feature measurements
-    //img_.clear();
-    //img_.t = camera_measurements_buffer_[0].second.t;
-    //img_.id = image_id_;
-    //for (auto zit = camera_measurements_buffer_.begin(); zit != camera_measurements_buffer_.end(); zit++)
-    //{
-      //img_.pixs.push_back(zit->second.z);
-      //img_.feat_ids.push_back(zit->second.feature_id);
-      //img_.depths.push_back(zit->second.depth);
-    //}
-
-    //for (estVec::iterator eit = est_.begin(); eit != est_.end(); eit++)
-        //(*eit)->imageCallback(t_, img_, feat_R_, depth_R_);
-
-    //camera_measurements_buffer_.clear();
-    //++image_id_;
-  //}
+  PROFILE_SCOPE(prof_, PROF_CAMERA);
+  // If it's time to capture new measurements, then do it
+  if (std::round((t_ - last_camera_update_) * t_round_off_) / t_round_off_ >= 1.0/camera_update_rate_)
+  {
+    last_camera_update_ = t_;
+    update_camera_pose();
+
+    double latency = camera_latency_.sample(normal_, rng_);
+    trace_.instant(PROF_CAMERA, t_, latency);
+    ImageFeat& img = camera_delay_.push(t_ + camera_time_offset_, t_ + latency);
+    img.clear();
+    img.id = image_id_++;
+    img.t = t_ + camera_time_offset_;
+    if (render_camera_images_)
+      render_image(GrayImage::CAMERA, img.id, x_I2c_, cam_, camera_image_delay_, img.t, t_ + latency);
+
+    // Project every tracked feature at once
+    projector_.resize(tracked_points_.size());
+    for (size_t i = 0; i < tracked_points_.size(); i++)
+      projector_.set_point(i, env_.get_point(tracked_points_[i].id));
+    projector_.project(x_I2c_, cam_);
+
+    // Of those in frame, find the ones behind obstacles with one batch of rays from the camera
+    const bool obstacles = env_.scene().num_rectangles() > 0;
+    if (obstacles)
+    {
+      if (occlusion_points_.cols() < (Index)tracked_points_.size())
+      {
+        occlusion_points_.resize(3, tracked_points_.size());
+        occluded_.resize(tracked_points_.size());
+      }
+      int num_in_frame = 0;
+      for (size_t i = 0; i < tracked_points_.size(); i++)
+      {
+        if (projector_.visible(i))
+          occlusion_points_.col(num_in_frame++) = projector_.point(i);
+      }
+      env_.scene().occluded(x_I2c_.t(), occlusion_points_.data(), num_in_frame, occluded_.data());
+    }
+
+    // Update feature measurements for the features still in view, and drop the rest
+    size_t num_tracked = 0;
+    int num_in_frame = 0;
+    for (size_t i = 0; i < tracked_points_.size(); i++)
+    {
+      feature_t& feature = tracked_points_[num_tracked];
+      feature = tracked_points_[i];
+      feature.zeta = projector_.bearing(i);
+      feature.pixel = projector_.pixel(i);
+      feature.depth = projector_.depth(i);
+      bool in_view = projector_.visible(i);
+      if (in_view && obstacles)
+        in_view = !occluded_[num_in_frame++];
+      if (!in_view)
+      {
+        tracked_ids_.erase(feature.id);
+        DBG("clearing feature - ID = %d [%f, %f, %f], [%f, %f]\n", feature.id,
+            feature.zeta(0,0), feature.zeta(1,0), feature.zeta(2,0), feature.pixel(0,0), feature.pixel(1,0));
+        continue;
+      }
+      img.pixs.push_back(feature.pixel + randomNormal<Vector2d>(pixel_noise_stdev_, normal_, rng_));
+      img.feat_ids.push_back(feature.id);
+      DBG("update feature - ID = %d\n", feature.id);
+      num_tracked++;
+    }
+    tracked_points_.resize(num_tracked);
+
+    // Landmarks already in the map that are in view, to re-track before making new ones (a
+    // tiled world has all of its landmarks already, so new features only ever come from these)
+    env_.update_tiles(x_I2c_.t());
+    frustum_ids_.clear();
+    frustum_next_ = 0;
+    num_candidates_ = next_candidate_ = 0;
+    if ((loop_closure_ || env_.tiled()) && tracked_points_.size() < num_features_)
+      env_.query_frustum(x_I2c_, cam_, frustum_ids_);
+
+    while (tracked_points_.size() < num_features_)
+    {
+      // Add the new feature to our "tracker"
+      feature_t new_feature;
+      if (!get_feature_in_frame(new_feature, loop_closure_))
+        break;
+      tracked_points_.push_back(new_feature);
+      tracked_ids_.insert(new_feature.id);
+      DBG("new feature - ID = %d [%f, %f, %f], [%f, %f]\n",
+          new_feature.id, new_feature.zeta(0,0), new_feature.zeta(1,0),
+          new_feature.zeta(2,0), new_feature.pixel(0,0), new_feature.pixel(1,0));
+
+      img.pixs.push_back(new_feature.pixel + randomNormal<Vector2d>(pixel_noise_stdev_, normal_, rng_));
+      img.feat_ids.push_back(new_feature.id);
+    }
+  }
 }
 
 
 void Simulator::update_alt_meas()
 {
+  PROFILE_SCOPE(prof_, PROF_ALT);
   if (std::round((t_ - last_altimeter_update_) * t_round_off_) / t_round_off_ >= 1.0/altimeter_update_rate_)
   {
-    Vector1d z_alt;
-    z_alt << -1.0 * state().p.z() + altimeter_noise_stdev_ * normal_(rng_);
+    double latency = alt_latency_.sample(normal_, rng_);
+    Vector1d& z_alt = alt_delay_.push(t_, t_ + latency);
+    // Range straight down, to the ground or the top of an obstacle
+    double range;
+    if (!env_.scene().cast(state().p, e_z, std::numeric_limits<double>::infinity(), range))
+      range = -1.0 * state().p.z();
+    z_alt << range + noise_.normal(altimeter_noise_stdev_);
+    if (log_.is_open())
+      log_.record(log_alt_) << t_ << z_alt;
 
     last_altimeter_update_ = t_;
-    for (estVec::iterator it = est_.begin(); it != est_.end(); it++)
-      (*it)->altCallback(t_, z_alt, alt_R_);
+    trace_.instant(PROF_ALT, t_, latency);
   }
 }
 
 void Simulator::update_baro_meas()
 {
+  PROFILE_SCOPE(prof_, PROF_BARO);
   if (std::round((t_ - last_baro_update_) * t_round_off_) / t_round_off_ >= 1.0/baro_update_rate_)
   {
     double dt = t_ - last_baro_update_;
-    baro_bias_ += dt * normal_(rng_)*baro_bias_walk_stdev_;
+    const double* noise = noise_.take(2);
+    baro_bias_ += dt * noise[0] * baro_bias_walk_stdev_;
 
     double alt = -1.0 * state().p.z() + alt0_;
     double pa = 101325.0f*(float)pow((1-2.25694e-5 * alt), 5.2553);
 
-    Vector1d z_baro;
-    z_baro << pa + baro_noise_stdev_ * normal_(rng_) + baro_bias_;
+    double latency = baro_latency_.sample(normal_, rng_);
+    Vector1d& z_baro = baro_delay_.push(t_, t_ + latency);
+    z_baro << pa + baro_noise_stdev_ * noise[1] + baro_bias_;
+    if (log_.is_open())
+      log_.record(log_baro_) << t_ << z_baro;
 
     last_baro_update_ = t_;
-    for (estVec::iterator it = est_.begin(); it != est_.end(); it++)
-        (*it)->baroCallback(t_, z_baro, baro_R_);
+    trace_.instant(PROF_BARO, t_, latency);
   }
 }
 
 
 void Simulator::update_mocap_meas()
 {
+  PROFILE_SCOPE(prof_, PROF_MOCAP);
   if (std::round((t_ - last_mocap_update_) * t_round_off_) / t_round_off_ >= 1.0/mocap_update_rate_)
   {
-    measurement_t meas;
-    meas.t = t_ + mocap_time_offset_;
-    meas.z.resize(7,1);
+    double latency = mocap_latency_.sample(normal_, rng_);
+    double meas_t = t_ + mocap_time_offset_;
+    Xformd& z = mocap_delay_.push(meas_t, t_ + latency);
 
     // Add noise to mocap measurements and transform into mocap coordinate frame
-    Vector3d noise = randomNormal<Vector3d>(position_noise_stdev_, normal_, rng_);
+    Vector3d noise = noise_.normal<Vector3d>(position_noise_stdev_);
     Vector3d I_p_b_I = state().p; // p_{b/I}^I
     Vector3d I_p_m_I = I_p_b_I + state().q.rota(p_b2m_); // p_{m/I}^I = p_{b/I}^I + R(q_I^b)^T (p_{m/b}^b)
-    meas.z.topRows<3>() = I_p_m_I + noise;
+    z.t_ = I_p_m_I + noise;
 
-    noise = randomNormal<Vector3d>(attitude_noise_stdev_, normal_, rng_);
+    noise = noise_.normal<Vector3d>(attitude_noise_stdev_);
     Quatd q_I_m = state().q * q_b2m_; //  q_I^m = q_I^b * q_b^m
-    meas.z.bottomRows<4>() = (q_I_m + noise).elements();
+    z.q_ = q_I_m + noise;
 
-    meas.R = mocap_R_;
-
-    double pub_time = std::max(mocap_transmission_time_ + normal_(rng_) * mocap_transmission_noise_, 0.0) + t_;
-
-    mocap_measurement_buffer_.push_back(std::pair<double, measurement_t>{pub_time, meas});
     last_mocap_update_ = t_;
-  }
-
-  while (mocap_measurement_buffer_.size() > 0 && mocap_measurement_buffer_[0].first >= t_)
-  {
-    measurement_t* m = &(mocap_measurement_buffer_[0].second);
-    if (mocap_enabled_)
-    {
-      for (estVec::iterator it = est_.begin(); it != est_.end(); it++)
-        (*it)->mocapCallback(m->t, Xformd(m->z), m->R);
-    }
-    mocap_measurement_buffer_.erase(mocap_measurement_buffer_.begin());
+    trace_.instant(PROF_MOCAP, t_, latency);
+    if (log_.is_open())
+      log_.record(log_mocap_) << meas_t << mocap_delay_.back().release << z.elements();
   }
 }
 
 
 void Simulator::update_velocity_meas()
 {
+  PROFILE_SCOPE(prof_, PROF_VELOCITY);
   if (std::round((t_ - last_velocity_update_) * t_round_off_) / t_round_off_ >=
       1.0 / velocity_update_rate_)
   {
     Vector3d noise =
         randomNormal<Vector3d>(velocity_noise_stdev_, normal_, rng_);
 
-    Vector3d vel_meas = state().v + noise;
-
-    for (estVec::iterator it = est_.begin(); it != est_.end(); it++)
-      (*it)->velocityCallback(t_, vel_meas, velocity_R_);
+    double latency = velocity_latency_.sample(normal_, rng_);
+    Vector3d& vel_meas = velocity_delay_.push(t_, t_ + latency);
+    vel_meas = state().v + noise;
+    if (log_.is_open())
+      log_.record(log_velocity_) << t_ << vel_meas;
+    trace_.instant(PROF_VELOCITY, t_, latency);
   }
 }
 
 
 void Simulator::update_vo_meas()
 {
+  PROFILE_SCOPE(prof_, PROF_VO);
   Xformd T_i2b = dyn_.get_global_pose();
   Vector6d delta = T_i2b - X_I2bk_;
   if (delta.segment<3>(0).norm() >= vo_delta_position_ || delta.segment<3>(3).norm() >= vo_delta_attitude_)
   {
     // Compute position and attitude relative to the keyframe
-    Xformd T_c2ck;
+    double latency = vo_latency_.sample(normal_, rng_);
+    Xformd& T_c2ck = vo_delay_.push(t_, t_ + latency);
     T_c2ck.t_ = x_b2c_.rotp(T_i2b.q().rotp(X_I2bk_.t() + X_I2bk_.q().inverse().rotp(x_b2c_.t()) -
                                            (T_i2b.t() + T_i2b.q().inverse().rotp(x_b2c_.t()))));
     T_c2ck.q_ = x_b2c_.q_.inverse() * T_i2b.q().inverse() * X_I2bk_.q().inverse() * x_b2c_.q_;
-
-    for (estVec::iterator it = est_.begin(); it != est_.end(); it++)
-      (*it)->voCallback(t_, T_c2ck, vo_R_);
+    trace_.instant(PROF_VO, t_, latency);
+    if (log_.is_open())
+      log_.record(log_vo_) << t_ << T_c2ck.elements();
 
     // Set new keyframe to current pose
     X_I2bk_ = dyn_.get_global_pose();
@@ -755,52 +1232,61 @@ void Simulator::update_vo_meas()
 
 void Simulator::update_gnss_meas()
 {
-  /// TODO: Simulate gnss sensor delay
+  PROFILE_SCOPE(prof_, PROF_GNSS);
   if (std::round((t_ - last_gnss_update_) * t_round_off_) / t_round_off_ >= 1.0/gnss_update_rate_)
   {
     last_gnss_update_ = t_;
+    double latency = gnss_latency_.sample(normal_, rng_);
+    trace_.instant(PROF_GNSS, t_, latency);
     /// TODO: Simulate the random walk associated with gnss position
     Vector3d p_NED = dyn_.get_global_pose().t();
-    p_NED.segment<2>(0) += gnss_horizontal_position_stdev_ * randomNormal<Vector2d>(normal_, rng_);
-    p_NED(2) += gnss_vertical_position_stdev_ * normal_(rng_);
+    p_NED.segment<2>(0) += noise_.normal<Vector2d>(gnss_horizontal_position_stdev_);
+    p_NED(2) += noise_.normal(gnss_vertical_position_stdev_);
     Vector3d p_ECEF = WSG84::ned2ecef(X_e2n_, p_NED);
 
     Vector3d v_NED = dyn_.get_global_pose().q().rota(dyn_.get_state().v);
-    v_NED += gnss_velocity_stdev_ * randomNormal<Vector3d>(normal_, rng_);
+    v_NED += noise_.normal<Vector3d>(gnss_velocity_stdev_);
     Vector3d v_ECEF = X_e2n_.q().rota(v_NED);
-    v_ECEF += gnss_velocity_stdev_ * randomNormal<Vector3d>(normal_, rng_);
+    v_ECEF += noise_.normal<Vector3d>(gnss_velocity_stdev_);
 
-    Vector6d z;
+    Vector6d& z = gnss_delay_.push(t_, t_ + latency);
     z << p_ECEF, v_ECEF;
     // z << p_NED, v_NED;
-
-    for (estVec::iterator it = est_.begin(); it != est_.end(); it++)
-      (*it)->gnssCallback(t_, z, gnss_R_);
+    if (log_.is_open())
+      log_.record(log_gnss_) << t_ << z;
   }
 }
 
 void Simulator::update_raw_gnss_meas()
 {
-  /// TODO: Simulator gnss sensor delay
+  PROFILE_SCOPE(prof_, PROF_RAW_GNSS);
   double dt = t_ - last_raw_gnss_update_;
   if (std::round(dt * t_round_off_) / t_round_off_ >= 1.0/gnss_update_rate_)
   {
     last_raw_gnss_update_ = t_;
-    clock_bias_rate_ += normal_(rng_) * clock_walk_stdev_ * dt;
+    double latency = raw_gnss_latency_.sample(normal_, rng_);
+    trace_.instant(PROF_RAW_GNSS, t_, latency);
+    clock_bias_rate_ += noise_.normal(clock_walk_stdev_) * dt;
     clock_bias_ += clock_bias_rate_ * dt;
 
     GTime t_now = t_ + start_time_;
     Vector3d p_ECEF = get_position_ecef();
     Vector3d v_ECEF = get_velocity_ecef();
 
-    VecVec3 z;
-    VecMat3 R;
+    raw_gnss_meas_t& meas = raw_gnss_delay_.push(t_, t_ + latency);
+    meas.t = t_now;
+    VecVec3& z = meas.z;
+    VecMat3& R = meas.R;
+    vector<bool>& slip = meas.slip;
+    z.clear();
+    R.clear();
+    slip.assign(satellites_.size(), false);
     int i;
     vector<Satellite, aligned_allocator<Satellite>>::iterator sat;
-    vector<bool> slip(satellites_.size(), false);
     for (i = 0, sat = satellites_.begin(); sat != satellites_.end(); sat++, i++)
     {
-      if (normal_(rng_) * dt_ < cycle_slip_prob_)
+      const double* noise = noise_.take(4);
+      if (noise[0] * dt_ < cycle_slip_prob_)
       {
         slip[i] = true;
         carrier_phase_integer_offsets_[i] = round(uniform_(rng_) * 100) - 50;
@@ -820,27 +1306,37 @@ void Simulator::update_raw_gnss_meas()
 
       Vector3d z_i;
       sat->computeMeasurement(t_now, p_ECEF, v_ECEF, Vector2d{clock_bias_, clock_bias_rate_}, z_i);
-      z_i(0) += normal_(rng_) * pseudorange_stdev_+ multipath_offset_[i];
-      z_i(1) += normal_(rng_) * pseudorange_rate_stdev_;
-      z_i(2) += normal_(rng_) * carrier_phase_stdev_ + carrier_phase_integer_offsets_[i];
+      z_i(0) += noise[1] * pseudorange_stdev_+ multipath_offset_[i];
+      z_i(1) += noise[2] * pseudorange_rate_stdev_;
+      z_i(2) += noise[3] * carrier_phase_stdev_ + carrier_phase_integer_offsets_[i];
       z.push_back(z_i);
       R.push_back(raw_gnss_R_);
     }
-
-    for (estVec::iterator it = est_.begin(); it != est_.end(); it++)
-      (*it)->rawGnssCallback(t_now, z, R, satellites_, slip);
+    if (log_.is_open())
+    {
+      Logger::Record rec = log_.record(log_raw_gnss_);
+      rec << t_ << t_now.week << t_now.tow_sec;
+      for (size_t j = 0; j < z.size(); j++)
+        rec << z[j].transpose();
+      for (size_t j = 0; j < slip.size(); j++)
+        rec << (uint8_t)slip[j];
+    }
   }
 }
 
 
 void Simulator::update_measurements()
 {
+  PROFILE_SCOPE(prof_, PROF_MEASUREMENTS);
+  TraceSpan span(trace_, PROF_MEASUREMENTS, t_);
   if (imu_enabled_)
     update_imu_meas();
   if (camera_enabled_)
     update_camera_meas();
   if (alt_enabled_)
     update_alt_meas();
+  if (baro_enabled_)
+    update_baro_meas();
   if (mocap_enabled_)
     update_mocap_meas();
   if (velocity_enabled_)
@@ -853,16 +1349,169 @@ void Simulator::update_measurements()
     update_raw_gnss_meas();
   if (simple_cam_enabled_)
     update_simple_cam_meas();
+  deliver_measurements();
+}
+
+
+void Simulator::deliver_measurements()
+{
+  // Merge the delay lines: repeatedly deliver the due measurement released first, breaking ties
+  // by timestamp and then by sensor, so estimators see one ordered stream across sensors
+  const double t_due = t_ + 0.5 / t_round_off_;
+  while (true)
+  {
+    int next = -1;
+    double release = t_due;
+    double t = 0;
+    next_release(imu_delay_, DELAYED_IMU, next, release, t);
+    next_release(camera_delay_, DELAYED_CAMERA, next, release, t);
+    next_release(alt_delay_, DELAYED_ALT, next, release, t);
+    next_release(baro_delay_, DELAYED_BARO, next, release, t);
+    next_release(mocap_delay_, DELAYED_MOCAP, next, release, t);
+    next_release(velocity_delay_, DELAYED_VELOCITY, next, release, t);
+    next_release(vo_delay_, DELAYED_VO, next, release, t);
+    next_release(gnss_delay_, DELAYED_GNSS, next, release, t);
+    next_release(raw_gnss_delay_, DELAYED_RAW_GNSS, next, release, t);
+    next_release(aruco_delay_, DELAYED_ARUCO, next, release, t);
+    next_release(landmarks_delay_, DELAYED_LANDMARKS, next, release, t);
+    next_release(camera_image_delay_, DELAYED_CAMERA_IMAGE, next, release, t);
+    next_release(simple_cam_image_delay_, DELAYED_SIMPLE_CAM_IMAGE, next, release, t);
+
+    switch (next)
+    {
+    case DELAYED_IMU:
+      for (estVec::iterator it = est_.begin(); it != est_.end(); it++)
+      {
+        PROFILE_SCOPE(prof_, PROF_IMU_CB);
+        TraceSpan span(trace_, PROF_IMU_CB, t_, TraceRecorder::ESTIMATOR_TID + (it - est_.begin()));
+        (*it)->imuCallback(t, imu_delay_.front().z, imu_R_);
+      }
+      imu_delay_.pop();
+      break;
+    case DELAYED_CAMERA:
+      for (estVec::iterator it = est_.begin(); it != est_.end(); it++)
+      {
+        PROFILE_SCOPE(prof_, PROF_IMAGE_CB);
+        TraceSpan span(trace_, PROF_IMAGE_CB, t_, TraceRecorder::ESTIMATOR_TID + (it - est_.begin()));
+        (*it)->imageCallback(t, camera_delay_.front().z, feat_R_, depth_R_);
+      }
+      camera_delay_.pop();
+      break;
+    case DELAYED_ALT:
+      for (estVec::iterator it = est_.begin(); it != est_.end(); it++)
+      {
+        PROFILE_SCOPE(prof_, PROF_ALT_CB);
+        TraceSpan span(trace_, PROF_ALT_CB, t_, TraceRecorder::ESTIMATOR_TID + (it - est_.begin()));
+        (*it)->altCallback(t, alt_delay_.front().z, alt_R_);
+      }
+      alt_delay_.pop();
+      break;
+    case DELAYED_BARO:
+      for (estVec::iterator it = est_.begin(); it != est_.end(); it++)
+      {
+        PROFILE_SCOPE(prof_, PROF_BARO_CB);
+        TraceSpan span(trace_, PROF_BARO_CB, t_, TraceRecorder::ESTIMATOR_TID + (it - est_.begin()));
+        (*it)->baroCallback(t, baro_delay_.front().z, baro_R_);
+      }
+      baro_delay_.pop();
+      break;
+    case DELAYED_MOCAP:
+      for (estVec::iterator it = est_.begin(); it != est_.end(); it++)
+      {
+        PROFILE_SCOPE(prof_, PROF_MOCAP_CB);
+        TraceSpan span(trace_, PROF_MOCAP_CB, t_, TraceRecorder::ESTIMATOR_TID + (it - est_.begin()));
+        (*it)->mocapCallback(t, mocap_delay_.front().z, mocap_R_);
+      }
+      mocap_delay_.pop();
+      break;
+    case DELAYED_VELOCITY:
+      for (estVec::iterator it = est_.begin(); it != est_.end(); it++)
+      {
+        PROFILE_SCOPE(prof_, PROF_VELOCITY_CB);
+        TraceSpan span(trace_, PROF_VELOCITY_CB, t_, TraceRecorder::ESTIMATOR_TID + (it - est_.begin()));
+        (*it)->velocityCallback(t, velocity_delay_.front().z, velocity_R_);
+      }
+      velocity_delay_.pop();
+      break;
+    case DELAYED_VO:
+      for (estVec::iterator it = est_.begin(); it != est_.end(); it++)
+      {
+        PROFILE_SCOPE(prof_, PROF_VO_CB);
+        TraceSpan span(trace_, PROF_VO_CB, t_, TraceRecorder::ESTIMATOR_TID + (it - est_.begin()));
+        (*it)->voCallback(t, vo_delay_.front().z, vo_R_);
+      }
+      vo_delay_.pop();
+      break;
+    case DELAYED_GNSS:
+      for (estVec::iterator it = est_.begin(); it != est_.end(); it++)
+      {
+        PROFILE_SCOPE(prof_, PROF_GNSS_CB);
+        TraceSpan span(trace_, PROF_GNSS_CB, t_, TraceRecorder::ESTIMATOR_TID + (it - est_.begin()));
+        (*it)->gnssCallback(t, gnss_delay_.front().z, gnss_R_);
+      }
+      gnss_delay_.pop();
+      break;
+    case DELAYED_RAW_GNSS:
+    {
+      const raw_gnss_meas_t& m = raw_gnss_delay_.front().z;
+      for (estVec::iterator it = est_.begin(); it != est_.end(); it++)
+      {
+        PROFILE_SCOPE(prof_, PROF_RAW_GNSS_CB);
+        TraceSpan span(trace_, PROF_RAW_GNSS_CB, t_, TraceRecorder::ESTIMATOR_TID + (it - est_.begin()));
+        (*it)->rawGnssCallback(m.t, m.z, m.R, satellites_, m.slip);
+      }
+      raw_gnss_delay_.pop();
+      break;
+    }
+    case DELAYED_ARUCO:
+      for (estVec::iterator it = est_.begin(); it != est_.end(); it++)
+      {
+        PROFILE_SCOPE(prof_, PROF_ARUCO_CB);
+        TraceSpan span(trace_, PROF_ARUCO_CB, t_, TraceRecorder::ESTIMATOR_TID + (it - est_.begin()));
+        (*it)->arucoCallback(t, aruco_delay_.front().z, aruco_R_);
+      }
+      aruco_delay_.pop();
+      break;
+    case DELAYED_LANDMARKS:
+      for (estVec::iterator it = est_.begin(); it != est_.end(); it++)
+      {
+        PROFILE_SCOPE(prof_, PROF_LANDMARKS_CB);
+        TraceSpan span(trace_, PROF_LANDMARKS_CB, t_, TraceRecorder::ESTIMATOR_TID + (it - est_.begin()));
+        (*it)->landmarksCallback(t, landmarks_delay_.front().z, lm_pixel_R_);
+      }
+      landmarks_delay_.pop();
+      break;
+    case DELAYED_CAMERA_IMAGE:
+    case DELAYED_SIMPLE_CAM_IMAGE:
+    {
+      // Moved out of the line, so the buffer goes back to the pool once the estimators let go
+      DelayLine<std::shared_ptr<const GrayImage>>& line = next == DELAYED_CAMERA_IMAGE ? camera_image_delay_
+                                                                                     : simple_cam_image_delay_;
+      std::shared_ptr<const GrayImage> img;
+      img.swap(line.front().z);
+      line.pop();
+      for (estVec::iterator it = est_.begin(); it != est_.end(); it++)
+      {
+        PROFILE_SCOPE(prof_, PROF_GRAY_IMAGE_CB);
+        TraceSpan span(trace_, PROF_GRAY_IMAGE_CB, t_, TraceRecorder::ESTIMATOR_TID + (it - est_.begin()));
+        (*it)->grayImageCallback(t, img);
+      }
+      break;
+    }
+    default:
+      return;
+    }
+  }
 }
 
 
 bool Simulator::update_feature(feature_t &feature) const
 {
-  if (feature.id > env_.get_points().size() || feature.id < 0)
+  if (feature.id < 0 || !env_.has_point(feature.id))
     return false;
 
   // Calculate the bearing vector to the feature
-  Vector3d pt = env_.get_points()[feature.id];
+  Vector3d pt = env_.get_point(feature.id);
   feature.zeta = x_I2c_.transformp(pt);
 
   // we can reject anything behind the camera
@@ -876,46 +1525,53 @@ bool Simulator::update_feature(feature_t &feature) const
   cam_.proj(feature.zeta, feature.pixel);
   if ((feature.pixel.array() < 0).any() || (feature.pixel.array() > cam_.image_size_.array()).any())
     return false;
-  else
-    return true;
+
+  // Nor can we see through obstacles
+  bool blocked;
+  env_.scene().occluded(x_I2c_.t(), pt.data(), 1, &blocked);
+  return !blocked;
 }
 
 bool Simulator::get_previously_tracked_feature_in_frame(feature_t &feature)
 {
-
-  Vector3d ground_pt;
-  env_.get_center_img_center_on_ground_plane(x_I2c_, ground_pt);
-  vector<Vector3d, aligned_allocator<Vector3d>> pts;
-  vector<size_t> ids;
-  if (env_.get_closest_points(ground_pt, num_features_, 2.0, pts, ids))
+  // The query already culled landmarks out of frame.  The ones behind obstacles are culled a
+  // packet of untracked candidates at a time, as they're needed, so a frame only casts rays for
+  // about as many landmarks as it re-tracks, however many are in the frustum.
+  while (true)
   {
-    for (int i = 0; i < pts.size(); i++)
+    if (next_candidate_ == num_candidates_)
     {
-      if (is_feature_tracked(ids[i]))
-        continue;
-      // Calculate the bearing vector to the feature
-      Vector3d pt = env_.get_points()[ids[i]];
-      feature.zeta = x_I2c_.transformp(pt);
-      if (feature.zeta(2) < 0.0)
-        continue;
-
-      feature.depth = feature.zeta.norm();
-      feature.zeta /= feature.depth;
-      cam_.proj(feature.zeta, feature.pixel);
-      if ((feature.pixel.array() < 0).any() || (feature.pixel.array() > cam_.image_size_.array()).any())
-        continue;
-      else
+      num_candidates_ = next_candidate_ = 0;
+      while (num_candidates_ < Scene::PACKET && frustum_next_ < frustum_ids_.size())
       {
-        feature.id = ids[i];
-        return true;
+        size_t id = frustum_ids_[frustum_next_++];
+        if (is_feature_tracked(id))
+          continue;
+        candidate_ids_[num_candidates_] = id;
+        occlusion_points_.col(num_candidates_) = env_.get_point(id);
+        num_candidates_++;
       }
+      if (num_candidates_ == 0)
+        return false;
+      env_.scene().occluded(x_I2c_.t(), occlusion_points_.data(), num_candidates_, occluded_.data());
     }
+
+    int k = next_candidate_++;
+    if (occluded_[k])
+      continue;
+    feature.zeta = x_I2c_.transformp(occlusion_points_.col(k));
+    feature.depth = feature.zeta.norm();
+    feature.zeta /= feature.depth;
+    cam_.proj(feature.zeta, feature.pixel);
+    feature.id = candidate_ids_[k];
+    return true;
   }
-  return false;
 }
 
 bool Simulator::get_feature_in_frame(feature_t &feature, bool retrack)
 {
+  if (env_.tiled())
+    return get_previously_tracked_feature_in_frame(feature);
   if (retrack && get_previously_tracked_feature_in_frame(feature))
   {
     return true;
@@ -932,7 +1588,8 @@ bool Simulator::create_new_feature_in_frame(feature_t &feature)
   feature.id = env_.add_point(x_I2c_.t_, x_I2c_.q_, feature.zeta, feature.pixel, feature.depth);
   if (feature.id != -1)
   {
-    feature.id = next_feature_id_++;
+    // The id indexes the environment's points, see update_feature
+    next_feature_id_++;
     return true;
   }
   else
@@ -944,12 +1601,7 @@ bool Simulator::create_new_feature_in_frame(feature_t &feature)
 
 bool Simulator::is_feature_tracked(int id) const
 {
-  auto it = tracked_points_.begin();
-  while (it < tracked_points_.end() && it->id != id)
-  {
-    it++;
-  }
-  return it != tracked_points_.end();
+  return tracked_ids_.contains(id);
 }
 
 Vector3d Simulator::get_position_ecef() const
@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+#include "multirotor_sim/async_estimator.h"
+
+using namespace Eigen;
+using namespace multirotor_sim;
+
+namespace
+{
+
+// Keeps what it receives and the thread it was called on
+class ThreadEstimator : public EstimatorBase
+{
+public:
+  void imuCallback(const double& t, const Vector6d& z, const Matrix6d& R) override { add(t, z); }
+  void altCallback(const double& t, const Vector1d& z, const Matrix1d& R) override { add(t, z); }
+  void mocapCallback(const double& t, const Xformd& z, const Matrix6d& R) override { add(t, z.elements()); }
+  void imageCallback(const double& t, const ImageFeat& z, const Matrix2d& R_pix, const Matrix1d& R_depth) override
+  {
+    for (size_t i = 0; i < z.pixs.size(); i++)
+      add(z.feat_ids[i], z.pixs[i]);
+  }
+  void rawGnssCallback(const GTime& t, const VecVec3& z, const VecMat3& R,
+                       std::vector<Satellite, aligned_allocator<Satellite>>& sat,
+                       const std::vector<bool>& slip) override
+  {
+    for (size_t i = 0; i < z.size(); i++)
+      add(sat[i].id_ + slip[i], z[i]);
+  }
+
+  template <typename A>
+  void add(double t, const MatrixBase<A>& z)
+  {
+    thread = std::this_thread::get_id();
+    data.push_back(t);
+    for (int i = 0; i < z.size(); i++)
+      data.push_back(z(i));
+  }
+
+  std::thread::id thread;
+  std::vector<double> data;
+};
+
+void deliver_all(EstimatorBase& est, int n)
+{
+  std::vector<Satellite, aligned_allocator<Satellite>> sats;
+  for (int i = 0; i < 3; i++)
+    sats.push_back(Satellite(i + 5, i));
+
+  for (int k = 0; k < n; k++)
+  {
+    double t = 0.004 * k;
+    est.imuCallback(t, Vector6d::Constant(k), Matrix6d::Identity());
+    if (k % 5 == 0)
+      est.altCallback(t, Vector1d::Constant(-k), Matrix1d::Identity());
+    if (k % 10 == 0)
+    {
+      Matrix<double, 7, 1> arr;
+      arr << k, 2, 3, 1, 0, 0, 0;
+      est.mocapCallback(t, Xformd(arr), Matrix6d::Identity());
+      ImageFeat img;
+      for (int i = 0; i < k % 7; i++)
+      {
+        img.pixs.push_back(Vector2d(k, i));
+        img.feat_ids.push_back(i);
+      }
+      est.imageCallback(t, img, Matrix2d::Identity(), Matrix1d::Identity());
+      VecVec3 z(sats.size(), Vector3d::Constant(k));
+      VecMat3 R(sats.size(), Matrix3d::Identity());
+      std::vector<bool> slip(sats.size(), k % 20 == 0);
+      est.rawGnssCallback(GTime(2026, t), z, R, sats, slip);
+    }
+  }
+}
+
+}
+
+TEST (AsyncEstimator, DeliversInOrderOnWorker)
+{
+  ThreadEstimator sync, threaded;
+  AsyncEstimator async(&threaded, 16); // small enough for the simulator to wait on the worker
+  deliver_all(sync, 2000);
+  deliver_all(async, 2000);
+  async.wait();
+
+  EXPECT_EQ(async.delivered(), 2000u + 400u + 3*200u);
+  EXPECT_EQ(async.queue_depth(), 0u);
+  EXPECT_NE(threaded.thread, std::this_thread::get_id());
+  ASSERT_EQ(threaded.data.size(), sync.data.size());
+  EXPECT_TRUE(threaded.data == sync.data);
+}
+
+TEST (AsyncEstimator, DestructionDeliversQueued)
+{
+  ThreadEstimator sync, threaded;
+  deliver_all(sync, 500);
+  {
+    AsyncEstimator async(&threaded);
+    deliver_all(async, 500);
+  }
+  EXPECT_TRUE(threaded.data == sync.data);
+}
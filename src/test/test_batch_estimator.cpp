@@ -0,0 +1,128 @@
+#include <gtest/gtest.h>
+#include <vector>
+
+#include "multirotor_sim/batch_estimator.h"
+
+using namespace Eigen;
+using namespace multirotor_sim;
+
+namespace
+{
+
+class BatchCapture : public BatchEstimatorBase
+{
+public:
+  void batchCallback(const MeasurementBatch& batch) override
+  {
+    windows.push_back(std::make_pair(batch.t0, batch.t1));
+    sizes.push_back(batch.size());
+    // Put the measurements back in the order they were delivered
+    for (size_t i = 0; i < batch.order.size(); i++)
+    {
+      const MeasurementBatch::Entry& e = batch.order[i];
+      types.push_back(e.type);
+      if (e.type == MeasurementBatch::IMU)
+        times.push_back(batch.imu.t[e.index]);
+      else if (e.type == MeasurementBatch::ALT)
+        times.push_back(batch.alt.t[e.index]);
+      else if (e.type == MeasurementBatch::RAW_GNSS)
+        times.push_back(batch.raw_gnss[e.index].t.tow_sec);
+    }
+    // IMU samples are one contiguous block
+    if (!batch.imu.empty())
+    {
+      Map<const Matrix<double, 6, Dynamic>> z(batch.imu.z[0].data(), 6, batch.imu.size());
+      imu_sum += z.rowwise().sum();
+    }
+  }
+
+  std::vector<std::pair<double, double>> windows;
+  std::vector<size_t> sizes;
+  std::vector<uint32_t> types;
+  std::vector<double> times;
+  Vector6d imu_sum = Vector6d::Zero();
+};
+
+void deliver(EstimatorBase& est, std::vector<uint32_t>& types, std::vector<double>& times)
+{
+  std::vector<Satellite, aligned_allocator<Satellite>> sats(1, Satellite(3, 0));
+  for (int k = 0; k < 100; k++)
+  {
+    double t = 0.004 * (k + 1);
+    est.imuCallback(t, Vector6d::Constant(k), Matrix6d::Identity());
+    types.push_back(MeasurementBatch::IMU);
+    times.push_back(t);
+    if (k % 10 == 0)
+    {
+      est.altCallback(t, Vector1d::Constant(k), Matrix1d::Identity());
+      types.push_back(MeasurementBatch::ALT);
+      times.push_back(t);
+    }
+    if (k % 50 == 0)
+    {
+      est.rawGnssCallback(GTime(2026, 1000 + t), VecVec3(1), VecMat3(1), sats, std::vector<bool>(1));
+      types.push_back(MeasurementBatch::RAW_GNSS);
+      times.push_back(1000 + t);
+    }
+  }
+}
+
+}
+
+TEST (MeasurementBatcher, WindowsKeepOrder)
+{
+  BatchCapture cap;
+  MeasurementBatcher batcher(&cap, 0.1);
+  std::vector<uint32_t> types;
+  std::vector<double> times;
+  deliver(batcher, types, times);
+  batcher.flush();
+
+  // 0.004 to 0.4 in windows of 0.1
+  ASSERT_EQ(cap.windows.size(), 5u);
+  for (size_t i = 0; i < 4; i++)
+  {
+    EXPECT_NEAR(cap.windows[i].first, 0.1 * i, 1e-12);
+    EXPECT_NEAR(cap.windows[i].second, 0.1 * (i + 1), 1e-12);
+  }
+  EXPECT_TRUE(cap.types == types);
+  EXPECT_TRUE(cap.times == times);
+  EXPECT_DOUBLE_EQ(cap.imu_sum(0), 99 * 100 / 2);
+}
+
+TEST (MeasurementBatcher, MaxSize)
+{
+  BatchCapture cap;
+  MeasurementBatcher batcher(&cap, 0, 16);
+  std::vector<uint32_t> types;
+  std::vector<double> times;
+  deliver(batcher, types, times);
+  batcher.flush();
+
+  ASSERT_EQ(types.size(), 112u);
+  ASSERT_EQ(cap.sizes.size(), 7u);
+  for (size_t i = 0; i < cap.sizes.size(); i++)
+    EXPECT_EQ(cap.sizes[i], 16u);
+  EXPECT_TRUE(cap.types == types);
+  EXPECT_TRUE(cap.times == times);
+}
+
+// A measurement delayed by its sensor's latency goes in the batch open when it arrives, stamped
+// before the batch's window
+TEST (MeasurementBatcher, LateMeasurementKeepsItsStamp)
+{
+  BatchCapture capture;
+  MeasurementBatcher batcher(&capture, 0.1);
+  batcher.imuCallback(0.05, Vector6d::Zero(), Matrix6d::Identity());
+  batcher.imuCallback(0.12, Vector6d::Zero(), Matrix6d::Identity());
+  batcher.altCallback(0.08, Vector1d::Zero(), Matrix1d::Identity()); // 40 ms late
+  batcher.imuCallback(0.21, Vector6d::Zero(), Matrix6d::Identity());
+
+  ASSERT_EQ(capture.windows.size(), 2u);
+  EXPECT_NEAR(capture.windows[1].first, 0.1, 1e-12);
+  EXPECT_NEAR(capture.windows[1].second, 0.2, 1e-12);
+  EXPECT_EQ(capture.sizes[1], 2u);
+  ASSERT_EQ(capture.times.size(), 3u);
+  EXPECT_EQ(capture.times[2], 0.08);
+  EXPECT_LT(capture.times[2], capture.windows[1].first);
+}
@@ -0,0 +1,98 @@
+#include <gtest/gtest.h>
+#include <random>
+
+#include "multirotor_sim/delay_line.h"
+#include "multirotor_sim/state.h"
+
+using namespace Eigen;
+using namespace multirotor_sim;
+
+TEST (DelayLine, FirstInFirstOut)
+{
+  DelayLine<Vector3d> line(3); // rounded up to 4
+  EXPECT_EQ(line.capacity(), 4u);
+  EXPECT_TRUE(line.empty());
+  EXPECT_EQ(line.next_release(), std::numeric_limits<double>::infinity());
+
+  line.push(0.0, 0.5) = Vector3d::Constant(0);
+  line.push(0.1, 0.2) = Vector3d::Constant(1); // would overtake the first
+  line.push(0.2, 0.7) = Vector3d::Constant(2);
+  ASSERT_EQ(line.size(), 3u);
+  EXPECT_EQ(line.next_release(), 0.5);
+
+  double release[] = {0.5, 0.5, 0.7};
+  for (int i = 0; i < 3; i++)
+  {
+    EXPECT_EQ(line.front().release, release[i]);
+    EXPECT_EQ(line.front().t, 0.1 * i);
+    EXPECT_EQ(line.front().z(0), i);
+    line.pop();
+  }
+  EXPECT_TRUE(line.empty());
+}
+
+TEST (DelayLine, GrowsKeepingOrder)
+{
+  DelayLine<Vector3d> line(4);
+  for (int k = 0; k < 3; k++)
+  {
+    // Wrap the ring before it has to grow
+    line.push(k, k) = Vector3d::Constant(k);
+    line.pop();
+  }
+  for (int i = 0; i < 11; i++)
+    line.push(i, i) = Vector3d::Constant(i);
+  EXPECT_EQ(line.capacity(), 16u);
+  for (int i = 0; i < 11; i++)
+  {
+    EXPECT_EQ(line.front().z(0), i);
+    line.pop();
+  }
+}
+
+TEST (DelayLine, ReusesSlots)
+{
+  DelayLine<ImageFeat> line(2);
+  for (int k = 0; k < 10; k++)
+  {
+    ImageFeat& img = line.push(k, k);
+    img.clear();
+    for (int i = 0; i < 20; i++)
+    {
+      img.pixs.push_back(Vector2d(k, i));
+      img.feat_ids.push_back(i);
+    }
+    if (line.size() == 2)
+    {
+      // Both slots are in use from here on, and hold on to their storage
+      const Vector2d* pixs = line.front().z.pixs.data();
+      line.pop();
+      ImageFeat& next = line.push(k, k);
+      next.clear();
+      next.pixs.resize(20);
+      EXPECT_EQ(next.pixs.data(), pixs);
+      line.pop();
+    }
+  }
+  EXPECT_EQ(line.capacity(), 2u);
+}
+
+TEST (LatencyModel, Sample)
+{
+  std::default_random_engine rng(1);
+  std::normal_distribution<double> normal;
+  LatencyModel fixed(0.05);
+  std::default_random_engine before = rng;
+  EXPECT_EQ(fixed.sample(normal, rng), 0.05);
+  EXPECT_TRUE(rng == before);
+
+  LatencyModel jittery(0.01, 1.0);
+  double sum = 0;
+  for (int i = 0; i < 1000; i++)
+  {
+    double latency = jittery.sample(normal, rng);
+    EXPECT_GE(latency, 0.0);
+    sum += latency;
+  }
+  EXPECT_GT(sum, 0.0);
+}
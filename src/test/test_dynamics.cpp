@@ -3,6 +3,7 @@
 #include <random>
 
 #include "multirotor_sim/dynamics.h"
+#include "multirotor_sim/logger.h"
 #include "multirotor_sim/utils.h"
 #include "multirotor_sim/test_common.h"
 
@@ -47,7 +48,12 @@ TEST (Dynamics, Propagate)
   dyn_euler.RK4_ = false;
 
 
-  std::ofstream file("/tmp/Dynamics.Propagate.log");
+  multirotor_sim::Logger log;
+  int propagate = log.add_channel(multirotor_sim::Logger::Channel("propagate")
+                                  .add("t", multirotor_sim::Logger::F64)
+                                  .add("rk4", multirotor_sim::Logger::F64, multirotor_sim::State::SIZE)
+                                  .add("euler", multirotor_sim::Logger::F64, multirotor_sim::State::SIZE));
+  log.open("/tmp/Dynamics.Propagate.log");
   double t;
   double dt = 0.002;
   Vector4d u;
@@ -62,15 +68,13 @@ TEST (Dynamics, Propagate)
     u += dt * randomNormal<Vector4d>(0.1, dist, gen);
     dyn_rk4.run(t, u);
     dyn_euler.run(t, u);
-    file.write((char*)&t, sizeof(double));
-    file.write((char*)dyn_rk4.get_state().arr.data(), sizeof(double) * multirotor_sim::State::SIZE);
-    file.write((char*)dyn_euler.get_state().arr.data(), sizeof(double) * multirotor_sim::State::SIZE);
+    log.record(propagate) << t << dyn_rk4.get_state().arr << dyn_euler.get_state().arr;
     EXPECT_MAT_NEAR(dyn_euler.get_state().p, dyn_rk4.get_state().p, 6.0);
     EXPECT_MAT_NEAR(dyn_euler.get_state().v, dyn_rk4.get_state().v, 2.5);
     EXPECT_MAT_NEAR(dyn_euler.get_state().q.arr_, dyn_rk4.get_state().q.arr_, 0.3);
     EXPECT_MAT_NEAR(dyn_euler.get_state().w, dyn_rk4.get_state().w, 1e-2);
   }
 
-  file.close();
+  log.close();
 
 }
@@ -0,0 +1,236 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <fstream>
+#include <random>
+#include <yaml-cpp/yaml.h>
+
+#include "multirotor_sim/environment.h"
+
+namespace
+{
+
+// Squared distances from q to every point, sorted, paired with their ids
+vector<pair<double, size_t>> brute_force(const Environment& env, const Vector3d& q)
+{
+  vector<pair<double, size_t>> d;
+  for (size_t i = 0; i < env.get_points().size(); i++)
+    d.push_back(make_pair((env.get_points()[i] - q).squaredNorm(), i));
+  sort(d.begin(), d.end());
+  return d;
+}
+
+void fill(Environment& env, int n, double spread=0.0)
+{
+  env.load(MULTIROTOR_SIM_DIR"/params/sim_params.yaml");
+  Vector3d zeta;
+  Vector2d pix;
+  double depth;
+  std::default_random_engine gen(3);
+  std::uniform_real_distribution<double> uniform(-spread, spread);
+  while (env.get_points().size() < n)
+    env.add_point(Vector3d(uniform(gen), uniform(gen), -5), Quatd::Identity(), zeta, pix, depth);
+}
+
+}
+
+TEST (Environment, ClosestPointsMatchBruteForce)
+{
+  Environment env(1);
+  fill(env, 500);
+
+  const size_t k = 20;
+  size_t ids[k];
+  double dist_sqr[k];
+  Vector3d q(0.5, -0.5, 0);
+  for (double max_dist : {0.5, 2.0, 100.0})
+  {
+    vector<pair<double, size_t>> expected = brute_force(env, q);
+    size_t n = env.get_closest_points(q, k, max_dist, ids, dist_sqr);
+    size_t n_expected = 0;
+    while (n_expected < k && expected[n_expected].first < max_dist*max_dist)
+      n_expected++;
+    ASSERT_EQ(n, n_expected);
+    for (size_t i = 0; i < n; i++)
+    {
+      EXPECT_EQ(ids[i], expected[i].second);
+      EXPECT_DOUBLE_EQ(dist_sqr[i], expected[i].first);
+    }
+  }
+}
+
+TEST (Environment, PointsWithinMatchBruteForce)
+{
+  Environment env(1);
+  fill(env, 500);
+
+  const size_t capacity = 500;
+  size_t ids[capacity];
+  double dist_sqr[capacity];
+  Vector3d q(0.5, -0.5, 0);
+  vector<pair<double, size_t>> expected = brute_force(env, q);
+
+  size_t n = env.get_points_within(q, 2.0, capacity, ids, dist_sqr);
+  vector<pair<double, size_t>> found;
+  for (size_t i = 0; i < n; i++)
+    found.push_back(make_pair(dist_sqr[i], ids[i]));
+  sort(found.begin(), found.end());
+  size_t n_expected = 0;
+  while (n_expected < expected.size() && expected[n_expected].first < 4.0)
+    n_expected++;
+  ASSERT_EQ(found.size(), n_expected);
+  for (size_t i = 0; i < n; i++)
+    EXPECT_EQ(found[i].second, expected[i].second);
+
+  // Stops once the arrays are full
+  EXPECT_EQ(env.get_points_within(q, 2.0, 3, ids, dist_sqr), min<size_t>(3, n_expected));
+}
+
+// Every point checked against the camera one by one, for both ways of finding the cells
+TEST (Environment, FrustumQueryMatchesBruteForce)
+{
+  Environment env(1);
+  fill(env, 5000, 100.0);
+
+  Camera<double> cam;
+  cam.focal_len_ << 250.0, 260.0;
+  cam.cam_center_ << 320.0, 240.0;
+  cam.image_size_ << 640.0, 480.0;
+  cam.distortion_.setZero();
+  cam.s_ = 0.0;
+
+  vector<size_t> ids;
+  for (double max_depth : {8.0, 100.0})
+  {
+    for (int i = 0; i < 10; i++)
+    {
+      // Looking down from 5 m, tilted further each time
+      Xformd x_I2c(Vector3d(10.0 * i - 50.0, 3.0 * i, -5.0),
+                   Quatd::from_axis_angle(Vector3d(1, 1, 0).normalized(), 0.1 * i));
+      vector<size_t> expected;
+      for (size_t j = 0; j < env.get_points().size(); j++)
+      {
+        Vector3d zeta = x_I2c.transformp(env.get_points()[j]);
+        double depth = zeta.norm();
+        if (zeta(2) <= 0.0 || depth < 0.5 || depth > max_depth)
+          continue;
+        Vector2d pix;
+        cam.proj(zeta / depth, pix);
+        if ((pix.array() >= 0).all() && (pix.array() <= cam.image_size_.array()).all())
+          expected.push_back(j);
+      }
+
+      EXPECT_EQ(env.query_frustum(x_I2c, cam, ids, 0.5, max_depth), expected.size());
+      EXPECT_EQ(ids, expected);
+    }
+  }
+}
+
+// Tiles stay under the cap however far the camera goes, and come back the same
+TEST (Environment, TiledWorldRegeneratesEvictedTiles)
+{
+  string filename = "tmp.environment.params.yaml";
+  {
+    ofstream tmp_file(filename);
+    YAML::Node node = YAML::LoadFile(MULTIROTOR_SIM_DIR"/params/sim_params.yaml");
+    node["seed"] = 1;
+    node["world_tile_size"] = 20.0;
+    node["world_tile_landmarks"] = 50;
+    node["world_tile_radius"] = 30.0;
+    node["world_max_tiles"] = 20;
+    tmp_file << node;
+  }
+  Environment env(1);
+  env.load(filename);
+  ASSERT_TRUE(env.tiled());
+
+  Camera<double> cam;
+  cam.focal_len_ << 250.0, 260.0;
+  cam.cam_center_ << 320.0, 240.0;
+  cam.image_size_ << 640.0, 480.0;
+  cam.distortion_.setZero();
+  cam.s_ = 0.0;
+  Xformd x_I2c(Vector3d(5, 5, -10), Quatd::Identity());
+
+  env.update_tiles(x_I2c.t());
+  vector<size_t> first;
+  env.query_frustum(x_I2c, cam, first);
+  ASSERT_FALSE(first.empty());
+  vector<Vector3d, aligned_allocator<Vector3d>> first_pts;
+  for (size_t i = 0; i < first.size(); i++)
+    first_pts.push_back(env.get_point(first[i]));
+
+  // Fly a kilometre away and back
+  vector<size_t> ids;
+  for (double x = 5; x < 1000; x += 10)
+  {
+    env.update_tiles(Vector3d(x, 5, -10));
+    EXPECT_LE(env.num_loaded_tiles(), 20u);
+  }
+  env.query_frustum(x_I2c, cam, ids);
+  EXPECT_TRUE(ids.empty());
+  for (double x = 1000; x > 5; x -= 10)
+    env.update_tiles(Vector3d(x, 5, -10));
+  env.update_tiles(x_I2c.t());
+
+  env.query_frustum(x_I2c, cam, ids);
+  ASSERT_EQ(ids, first);
+  for (size_t i = 0; i < ids.size(); i++)
+    EXPECT_TRUE(env.get_point(ids[i]).isApprox(first_pts[i]));
+
+  // The nearest-point queries search the tiles too
+  size_t nearest[5];
+  double dist_sqr[5];
+  Vector3d q = first_pts[0];
+  ASSERT_EQ(env.get_closest_points(q, 5, 1e-3, nearest, dist_sqr), 1u);
+  EXPECT_EQ(nearest[0], first[0]);
+
+  {
+    ofstream tmp_file(filename);
+    YAML::Node node = YAML::LoadFile(MULTIROTOR_SIM_DIR"/params/sim_params.yaml");
+    node["world_tile_size"] = 20.0;
+    node["world_tile_landmarks"] = 0;
+    tmp_file << node;
+  }
+  Environment empty(1);
+  EXPECT_THROW(empty.load(filename), std::runtime_error);
+  remove(filename.c_str());
+}
+
+// Points land on an obstacle in front of the camera rather than on the floor behind it
+TEST (Environment, PointsLandOnObstacles)
+{
+  string filename = "tmp.environment.params.yaml";
+  {
+    ofstream tmp_file(filename);
+    YAML::Node node = YAML::LoadFile(MULTIROTOR_SIM_DIR"/params/sim_params.yaml");
+    node["seed"] = 1;
+    std::vector<double> boxes = {-50, -50, -3, 50, 50, 0}; // a 3 m high platform
+    node["boxes"] = boxes;
+    tmp_file << node;
+  }
+  Environment env(1);
+  env.load(filename);
+
+  Vector3d zeta;
+  Vector2d pix;
+  double depth;
+  for (int i = 0; i < 20; i++)
+  {
+    int id = env.add_point(Vector3d(0, 0, -10), Quatd::Identity(), zeta, pix, depth);
+    ASSERT_GE(id, 0);
+    EXPECT_NEAR(env.get_point(id).z(), -3.0, 1e-9);
+    EXPECT_NEAR(depth * zeta.z(), 7.0, 1e-9);
+  }
+
+  double range;
+  ASSERT_TRUE(env.scene().cast(Vector3d(0, 0, -10), Vector3d::UnitZ(), 100.0, range));
+  EXPECT_NEAR(range, 7.0, 1e-9);
+
+  // Loaded on their own, as when the camera is off
+  Environment scene_only(1);
+  scene_only.load_scene(filename);
+  EXPECT_EQ(scene_only.scene().num_rectangles(), env.scene().num_rectangles());
+  ASSERT_TRUE(scene_only.scene().cast(Vector3d(0, 0, -10), Vector3d::UnitZ(), 100.0, range));
+  EXPECT_NEAR(range, 7.0, 1e-9);
+  remove(filename.c_str());
+}
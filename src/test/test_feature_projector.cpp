@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+
+#include "multirotor_sim/feature_projector.h"
+#include "multirotor_sim/vehicle_base.h"
+
+using namespace Eigen;
+using namespace multirotor_sim;
+
+namespace
+{
+
+Camera<double> test_camera()
+{
+  Camera<double> cam;
+  cam.focal_len_ << 250.0, 260.0;
+  cam.cam_center_ << 320.0, 240.0;
+  cam.image_size_ << 640.0, 480.0;
+  cam.distortion_.setZero();
+  cam.s_ = 0.0;
+  return cam;
+}
+
+}
+
+// Matches the one at a time projection of Simulator::update_feature, culling included
+TEST (FeatureProjector, MatchesPerFeatureProjection)
+{
+  Camera<double> cam = test_camera();
+  Matrix<double, 7, 1> arr;
+  arr << 1.0, -2.0, -5.0, 0.8, 0.1, -0.2, 0.3;
+  arr.tail<4>().normalize();
+  xform::Xformd x_I2c(arr);
+
+  srand(3);
+  const int N = 300;
+  FeatureProjector proj;
+  proj.resize(N);
+  for (int i = 0; i < N; i++)
+    proj.set_point(i, Vector3d(1.0, -2.0, -5.0) + 10.0 * Vector3d::Random());
+  proj.project(x_I2c, cam);
+
+  int num_visible = 0;
+  for (int i = 0; i < N; i++)
+  {
+    Vector3d zeta = x_I2c.transformp(proj.point(i));
+    bool in_front = zeta(2) >= 0.0;
+    double depth = zeta.norm();
+    zeta /= depth;
+    Vector2d pix;
+    cam.proj(zeta, pix);
+    bool in_frame = (pix.array() >= 0).all() && (pix.array() <= cam.image_size_.array()).all();
+
+    EXPECT_EQ(proj.visible(i), in_front && in_frame) << i;
+    EXPECT_NEAR(proj.depth(i), depth, 1e-9);
+    EXPECT_TRUE(proj.bearing(i).isApprox(zeta, 1e-9));
+    if (in_front)
+    {
+      EXPECT_TRUE(proj.pixel(i).isApprox(pix, 1e-9));
+    }
+    num_visible += in_front && in_frame;
+  }
+  EXPECT_GT(num_visible, 0);
+  EXPECT_LT(num_visible, N);
+}
+
+TEST (FeatureProjector, KeepsPointsWhenGrowing)
+{
+  FeatureProjector proj;
+  proj.resize(3);
+  for (int i = 0; i < 3; i++)
+    proj.set_point(i, Vector3d::Constant(i));
+  proj.resize(100);
+  for (int i = 0; i < 3; i++)
+    EXPECT_TRUE(proj.point(i) == Vector3d::Constant(i));
+  proj.resize(2);
+  EXPECT_EQ(proj.size(), 2);
+}
+
+// A vehicle's landmark array, projected in one call, gives the same as setting each point
+TEST (FeatureProjector, SetsPointsFromArray)
+{
+  srand(4);
+  Matrix3Xd pts = 5.0 * Matrix3Xd::Random(3, 40);
+  pts.row(2).array() += 10.0;
+  std::vector<int> ids(pts.cols());
+  for (size_t i = 0; i < ids.size(); i++)
+    ids[i] = 100 + i;
+  LandmarkView view(pts.cols(), ids.data(), pts.data());
+
+  FeatureProjector a, b;
+  a.set_points(view.points());
+  b.resize(view.size);
+  for (int i = 0; i < view.size; i++)
+    b.set_point(i, pts.col(i));
+  ASSERT_EQ(a.size(), 40);
+
+  xform::Xformd x_I2c = xform::Xformd::Identity();
+  a.project(x_I2c, test_camera());
+  b.project(x_I2c, test_camera());
+  for (int i = 0; i < view.size; i++)
+  {
+    EXPECT_TRUE(a.point(i) == pts.col(i));
+    EXPECT_TRUE(a.pixel(i) == b.pixel(i));
+  }
+}
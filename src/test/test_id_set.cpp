@@ -0,0 +1,47 @@
+#include <gtest/gtest.h>
+#include <random>
+#include <set>
+
+#include "multirotor_sim/id_set.h"
+
+using namespace multirotor_sim;
+
+TEST (IdSet, InsertEraseContains)
+{
+  IdSet ids;
+  EXPECT_TRUE(ids.empty());
+  EXPECT_TRUE(ids.insert(3));
+  EXPECT_FALSE(ids.insert(3));
+  EXPECT_TRUE(ids.insert(0));
+  EXPECT_TRUE(ids.contains(3));
+  EXPECT_TRUE(ids.contains(0));
+  EXPECT_FALSE(ids.contains(4));
+  EXPECT_EQ(ids.size(), 2u);
+  EXPECT_TRUE(ids.erase(3));
+  EXPECT_FALSE(ids.erase(3));
+  EXPECT_FALSE(ids.contains(3));
+  EXPECT_TRUE(ids.contains(0));
+  ids.clear();
+  EXPECT_FALSE(ids.contains(0));
+  EXPECT_TRUE(ids.empty());
+}
+
+// Features coming into and going out of view, checked against std::set
+TEST (IdSet, MatchesStdSet)
+{
+  std::default_random_engine rng(2);
+  std::uniform_int_distribution<int> id_dist(0, 2000);
+  IdSet ids(64);
+  std::set<int> expected;
+  for (int k = 0; k < 50000; k++)
+  {
+    int id = id_dist(rng);
+    if (rng() % 2 && expected.size() < 500)
+      EXPECT_EQ(ids.insert(id), expected.insert(id).second);
+    else
+      EXPECT_EQ(ids.erase(id), expected.erase(id) == 1);
+    ASSERT_EQ(ids.size(), expected.size());
+  }
+  for (int id = 0; id <= 2000; id++)
+    EXPECT_EQ(ids.contains(id), expected.count(id) == 1) << id;
+}
@@ -0,0 +1,134 @@
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <random>
+#include <stdexcept>
+
+#include "multirotor_sim/environment.h"
+#include "multirotor_sim/landmark_map.h"
+
+using namespace multirotor_sim;
+
+namespace
+{
+
+// A file name no other test process is using, so parallel runs don't collide
+std::string temp_filename(const std::string& name)
+{
+  std::string path = "/tmp/multirotor_sim_test." + name + ".XXXXXX";
+  int fd = mkstemp(&path[0]);
+  if (fd < 0)
+    throw std::runtime_error("Unable to create a temporary file for " + name);
+  ::close(fd);
+  return path;
+}
+
+class LandmarkMapTest : public ::testing::Test
+{
+protected:
+  LandmarkMapTest() :
+    original(1),
+    filename(temp_filename("landmark_map"))
+  {}
+
+  void SetUp() override
+  {
+    original.load(MULTIROTOR_SIM_DIR"/params/sim_params.yaml");
+    std::default_random_engine gen(3);
+    std::uniform_real_distribution<double> uniform(-50.0, 50.0);
+    Vector3d zeta;
+    Vector2d pix;
+    double depth;
+    while (original.get_points().size() < 3000)
+      original.add_point(Vector3d(uniform(gen), uniform(gen), -5), Quatd::Identity(), zeta, pix, depth);
+    original.save_map(filename);
+
+    cam.focal_len_ << 250.0, 260.0;
+    cam.cam_center_ << 320.0, 240.0;
+    cam.image_size_ << 640.0, 480.0;
+    cam.distortion_.setZero();
+    cam.s_ = 0.0;
+  }
+
+  void TearDown() override
+  {
+    remove(filename.c_str());
+  }
+
+  Environment mapped()
+  {
+    Environment env(1);
+    env.load(MULTIROTOR_SIM_DIR"/params/sim_params.yaml");
+    env.open_map(filename);
+    return env;
+  }
+
+  Environment original;
+  std::string filename;
+  Camera<double> cam;
+};
+
+}
+
+TEST_F (LandmarkMapTest, MappedQueriesMatchOriginal)
+{
+  Environment env = mapped();
+  for (size_t i = 0; i < original.get_points().size(); i++)
+  {
+    ASSERT_TRUE(env.has_point(i));
+    EXPECT_EQ(env.get_point(i), original.get_points()[i]);
+  }
+
+  vector<size_t> expected, ids;
+  for (int i = 0; i < 10; i++)
+  {
+    Xformd x_I2c(Vector3d(10.0 * i - 50.0, 3.0 * i, -5.0),
+                 Quatd::from_axis_angle(Vector3d(1, 1, 0).normalized(), 0.1 * i));
+    original.query_frustum(x_I2c, cam, expected);
+    env.query_frustum(x_I2c, cam, ids);
+    EXPECT_EQ(ids, expected);
+  }
+
+  size_t expected_near[10], near[10];
+  double expected_dist[10], dist[10];
+  Vector3d q(0.5, -0.5, 0);
+  size_t n = original.get_closest_points(q, 10, 5.0, expected_near, expected_dist);
+  ASSERT_EQ(env.get_closest_points(q, 10, 5.0, near, dist), n);
+  for (size_t i = 0; i < n; i++)
+  {
+    EXPECT_EQ(near[i], expected_near[i]);
+    EXPECT_DOUBLE_EQ(dist[i], expected_dist[i]);
+  }
+}
+
+// Points added to one mapped environment stay out of the others, and can be saved with the map
+TEST_F (LandmarkMapTest, OverlayIsPrivate)
+{
+  Environment a = mapped();
+  Environment b = mapped();
+  Vector3d zeta;
+  Vector2d pix;
+  double depth;
+  int id = -1;
+  while (id < 0)
+    id = a.add_point(Vector3d(0, 0, -5), Quatd::Identity(), zeta, pix, depth);
+  EXPECT_EQ(id, 3000);
+  EXPECT_TRUE(a.has_point(id));
+  EXPECT_FALSE(b.has_point(id));
+
+  std::string overlay_filename = temp_filename("landmark_map_overlay");
+  a.save_map(overlay_filename);
+  Environment c(1);
+  c.load(MULTIROTOR_SIM_DIR"/params/sim_params.yaml");
+  c.open_map(overlay_filename);
+  EXPECT_EQ(c.get_point(id), a.get_point(id));
+  EXPECT_EQ(c.get_point(0), a.get_point(0));
+  remove(overlay_filename.c_str());
+}
+
+TEST_F (LandmarkMapTest, RejectsOtherFiles)
+{
+  EXPECT_THROW(LandmarkMap(MULTIROTOR_SIM_DIR"/params/sim_params.yaml"), std::runtime_error);
+  EXPECT_THROW(LandmarkMap("does_not_exist.bin"), std::runtime_error);
+}
@@ -0,0 +1,262 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <fstream>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "multirotor_sim/logger.h"
+
+using namespace multirotor_sim;
+
+namespace
+{
+
+struct Block
+{
+  uint32_t kind;
+  uint32_t channel;
+  uint32_t records;
+  std::vector<char> payload;
+};
+
+std::vector<Block> read_blocks(const std::string& filename)
+{
+  std::ifstream file(filename, std::ios::binary);
+  char magic[8];
+  uint32_t header[2];
+  file.read(magic, 8);
+  file.read((char*)header, sizeof(header));
+  EXPECT_EQ(std::string(magic), "MSIMLOG");
+  EXPECT_EQ(header[0], (uint32_t)Logger::VERSION);
+
+  // Stops at the index
+  std::vector<Block> blocks;
+  uint32_t block_header[4];
+  while (file.read((char*)block_header, sizeof(block_header)) && block_header[0] != Logger::INDEX)
+  {
+    Block b;
+    b.kind = block_header[0];
+    b.channel = block_header[1];
+    b.records = block_header[3];
+    b.payload.resize(block_header[2]);
+    file.read(b.payload.data(), b.payload.size());
+    blocks.push_back(b);
+  }
+  return blocks;
+}
+
+}
+
+TEST (Logger, NumpyDtype)
+{
+  Logger::Channel c("truth");
+  c.add("t", Logger::F64).add("p", Logger::F64, 3).add("R", Logger::F32, 3, 3).add("slip", Logger::U8, 2);
+  EXPECT_EQ(c.record_size(), 8u + 24u + 36u + 2u);
+  EXPECT_EQ(c.numpy_dtype(), "[('t', '<f8'), ('p', '<f8', (3,)), ('R', '<f4', (3, 3)), ('slip', 'u1', (2,))]");
+}
+
+TEST (Logger, RoundTrip)
+{
+  std::string filename = "/tmp/Logger.RoundTrip.log";
+  Logger log;
+  int a = log.add_channel(Logger::Channel("a").add("t", Logger::F64).add("M", Logger::F64, 2, 3));
+  ASSERT_TRUE(log.open(filename));
+  int b = log.add_channel(Logger::Channel("b").add("i", Logger::I32).add("x", Logger::F64));
+
+  Eigen::Matrix<double, 2, 3> M;
+  M << 1, 2, 3,
+       4, 5, 6;
+  for (int i = 0; i < 3; i++)
+  {
+    Logger::Record rec = log.record(a);
+    rec << 0.1 * i << M;
+    EXPECT_TRUE(rec.complete());
+  }
+  log.record(b) << (int32_t)7; // x is left zeroed
+  log.close();
+
+  std::vector<Block> blocks = read_blocks(filename);
+  ASSERT_EQ(blocks.size(), 4u);
+  EXPECT_EQ(blocks[0].kind, (uint32_t)Logger::DEFINITION);
+  EXPECT_EQ(std::string(blocks[0].payload.data()), "a");
+  EXPECT_EQ(blocks[1].kind, (uint32_t)Logger::DEFINITION);
+  EXPECT_EQ(blocks[1].channel, (uint32_t)b);
+
+  const Block& da = blocks[2];
+  EXPECT_EQ(da.kind, (uint32_t)Logger::DATA);
+  EXPECT_EQ(da.channel, (uint32_t)a);
+  ASSERT_EQ(da.records, 3u);
+  ASSERT_EQ(da.payload.size(), 3 * 7 * sizeof(double));
+  // Stored by column: t of every record, then M of every record
+  const double* d = (const double*)da.payload.data();
+  for (int i = 0; i < 3; i++)
+  {
+    EXPECT_DOUBLE_EQ(d[i], 0.1 * i);
+    for (int j = 0; j < 6; j++)
+      EXPECT_DOUBLE_EQ(d[3 + 6*i + j], j + 1); // row-major
+  }
+
+  const Block& db = blocks[3];
+  ASSERT_EQ(db.records, 1u);
+  EXPECT_EQ(*(const int32_t*)db.payload.data(), 7);
+  EXPECT_EQ(*(const double*)(db.payload.data() + 4), 0.0);
+  EXPECT_EQ(log.bytes_written(), (uint64_t)(Logger::HEADER_SIZE + 5 * Logger::BLOCK_HEADER_SIZE
+                                           + blocks[0].payload.size() + blocks[1].payload.size()
+                                           + da.payload.size() + db.payload.size()
+                                           + 4 * sizeof(Logger::IndexEntry) + Logger::TRAILER_SIZE));
+}
+
+TEST (Logger, IndexPointsAtEveryBlock)
+{
+  std::string filename = "/tmp/Logger.Index.log";
+  Logger log(10 * 2 * sizeof(double));
+  int c = log.add_channel(Logger::Channel("c").add("t", Logger::F64).add("x", Logger::F64));
+  int d = log.add_channel(Logger::Channel("d").add("x", Logger::F64));
+  ASSERT_TRUE(log.open(filename));
+  for (int i = 0; i < 25; i++)
+  {
+    log.record(c) << 0.1 * i << 1.0;
+    log.record(d) << 2.0;
+  }
+  log.close();
+
+  std::ifstream file(filename, std::ios::binary);
+  std::string buf((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  ASSERT_EQ(buf.size(), log.bytes_written());
+  EXPECT_EQ(buf.substr(buf.size() - 8, 7), "MSIMIDX");
+  uint64_t index_offset;
+  memcpy(&index_offset, &buf[buf.size() - Logger::TRAILER_SIZE], sizeof(index_offset));
+
+  uint32_t header[4];
+  memcpy(header, &buf[index_offset], sizeof(header));
+  EXPECT_EQ(header[0], (uint32_t)Logger::INDEX);
+  ASSERT_EQ(header[3], 2u + 3u + 2u); // definitions, chunks of c (10 records) and of d (20 records)
+  ASSERT_EQ(header[2], header[3] * sizeof(Logger::IndexEntry));
+  std::vector<Logger::IndexEntry> index(header[3]);
+  memcpy(index.data(), &buf[index_offset + Logger::BLOCK_HEADER_SIZE], header[2]);
+
+  int c_chunks = 0;
+  for (size_t i = 0; i < index.size(); i++)
+  {
+    uint32_t block[4];
+    memcpy(block, &buf[index[i].offset], sizeof(block));
+    EXPECT_EQ(block[0], index[i].kind);
+    EXPECT_EQ(block[1], index[i].channel);
+    EXPECT_EQ(block[3], index[i].records);
+    if (index[i].kind == Logger::DATA && index[i].channel == (uint32_t)c)
+    {
+      EXPECT_DOUBLE_EQ(index[i].t_min, 0.1 * 10 * c_chunks);
+      EXPECT_DOUBLE_EQ(index[i].t_max, 0.1 * (c_chunks < 2 ? 10 * c_chunks + 9 : 24));
+      ++c_chunks;
+    }
+    else if (index[i].channel == (uint32_t)d)
+    {
+      EXPECT_TRUE(std::isinf(index[i].t_min));
+    }
+  }
+  EXPECT_EQ(c_chunks, 3);
+}
+
+TEST (Logger, CompressionAvailability)
+{
+  Logger log;
+  EXPECT_TRUE(log.set_compression(Logger::NONE));
+  EXPECT_EQ(log.set_compression(Logger::ZSTD), Logger::has_compression(Logger::ZSTD));
+  EXPECT_EQ(log.set_compression(Logger::LZ4), Logger::has_compression(Logger::LZ4));
+}
+
+TEST (Logger, WritesFullBlocks)
+{
+  std::string filename = "/tmp/Logger.WritesFullBlocks.log";
+  Logger log(10 * sizeof(double));
+  int c = log.add_channel(Logger::Channel("c").add("x", Logger::F64));
+  ASSERT_TRUE(log.open(filename));
+  for (int i = 0; i < 25; i++)
+    log.record(c) << (double)i;
+  log.close();
+
+  std::vector<Block> blocks = read_blocks(filename);
+  ASSERT_EQ(blocks.size(), 4u);
+  EXPECT_EQ(blocks[1].records, 10u);
+  EXPECT_EQ(blocks[2].records, 10u);
+  EXPECT_EQ(blocks[3].records, 5u);
+  EXPECT_DOUBLE_EQ(((const double*)blocks[3].payload.data())[4], 24.0);
+}
+
+TEST (Logger, ClosedLoggerIgnoresRecords)
+{
+  Logger log;
+  int c = log.add_channel(Logger::Channel("c").add("x", Logger::F64));
+  log.record(c) << 1.0 << 2.0;
+  EXPECT_FALSE(log.is_open());
+  EXPECT_EQ(log.bytes_written(), 0u);
+}
+
+static std::string read_file(const std::string& filename)
+{
+  std::ifstream file(filename, std::ios::binary);
+  return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+static void write_test_log(Logger& log, const std::string& filename)
+{
+  int a = log.add_channel(Logger::Channel("a").add("t", Logger::F64).add("x", Logger::F64, 3));
+  int b = log.add_channel(Logger::Channel("b").add("i", Logger::I32));
+  ASSERT_TRUE(log.open(filename));
+  for (int i = 0; i < 5000; i++)
+  {
+    log.record(a) << 0.01 * i << Eigen::Vector3d(i, 2*i, 3*i);
+    if (i % 3 == 0)
+      log.record(b) << (int32_t)i;
+  }
+  log.close();
+}
+
+TEST (Logger, AsyncMatchesSync)
+{
+  Logger sync(1024), async(1024);
+  async.set_async(4096, 2, Logger::BLOCK);
+  write_test_log(sync, "/tmp/Logger.Sync.log");
+  write_test_log(async, "/tmp/Logger.Async.log");
+
+  EXPECT_EQ(async.queue_depth(), 0);
+  EXPECT_EQ(async.dropped_blocks(), 0u);
+  EXPECT_EQ(async.bytes_written(), sync.bytes_written());
+  EXPECT_TRUE(read_file("/tmp/Logger.Sync.log") == read_file("/tmp/Logger.Async.log"));
+}
+
+// Compressed by the writer thread, the file is the same as when compressed inline
+TEST (Logger, AsyncCompressionMatchesSync)
+{
+  Logger::Compression compression = Logger::has_compression(Logger::LZ4) ? Logger::LZ4 : Logger::ZSTD;
+  if (!Logger::has_compression(compression))
+    return;
+  Logger sync(1024), async(1024);
+  sync.set_compression(compression);
+  async.set_compression(compression);
+  async.set_async(4096, 2, Logger::BLOCK);
+  write_test_log(sync, "/tmp/Logger.SyncCompressed.log");
+  write_test_log(async, "/tmp/Logger.AsyncCompressed.log");
+
+  EXPECT_EQ(async.bytes_written(), sync.bytes_written());
+  EXPECT_TRUE(read_file("/tmp/Logger.SyncCompressed.log") == read_file("/tmp/Logger.AsyncCompressed.log"));
+}
+
+TEST (Logger, AsyncDropAccountsForEveryByte)
+{
+  Logger sync(1024), async(1024);
+  async.set_async(2048, 2, Logger::DROP);
+  write_test_log(sync, "/tmp/Logger.Sync.log");
+  write_test_log(async, "/tmp/Logger.AsyncDrop.log");
+
+  // Whether anything is dropped depends on the disk, but every block is either written or
+  // counted.  Dropped blocks are also missing from the index
+  EXPECT_EQ(async.bytes_written() + async.dropped_bytes() + async.dropped_blocks() * sizeof(Logger::IndexEntry),
+            sync.bytes_written());
+  EXPECT_EQ(read_file("/tmp/Logger.AsyncDrop.log").size(), async.bytes_written());
+  std::vector<Block> blocks = read_blocks("/tmp/Logger.AsyncDrop.log");
+  ASSERT_GE(blocks.size(), 2u);
+  EXPECT_EQ(blocks[0].kind, (uint32_t)Logger::DEFINITION);
+  EXPECT_EQ(blocks[1].kind, (uint32_t)Logger::DEFINITION);
+}
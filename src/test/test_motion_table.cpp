@@ -0,0 +1,102 @@
+#include <gtest/gtest.h>
+
+#include "multirotor_sim/motion_table.h"
+#include "multirotor_sim/platform_vehicle.h"
+
+using namespace Eigen;
+using namespace multirotor_sim;
+
+// The spline passes through the samples, and carries on into the next period with the drift
+TEST (MotionTable, InterpolatesAndRepeats)
+{
+  MotionTable::ShipMotion m;
+  m.duration = 120.0;
+  std::shared_ptr<const MotionTable> table = MotionTable::ship(m, 1);
+  const MotionTable& ship = *table;
+  ASSERT_EQ(ship.size(), 2400u);
+  EXPECT_NEAR(ship.period(), 120.0, 1e-9);
+
+  for (int i : {0, 1, 500, 2399})
+    EXPECT_TRUE((ship(i * ship.dt()) - ship.samples().col(i)).isZero(1e-9)) << i;
+  for (double t : {-30.0, 0.013, 17.5, 119.99})
+    EXPECT_TRUE((ship(t + ship.period()) - ship(t) - ship.drift()).isZero(1e-6)) << t;
+
+  // Continuous across the end of the table
+  EXPECT_TRUE((ship(ship.period() - 1e-6) - ship(ship.period())).isZero(1e-4));
+  EXPECT_NEAR(ship.drift()(MotionTable::X), m.speed * m.duration, 1e-9);
+}
+
+// Each motion has the standard deviation asked for, and seeds give different realizations
+TEST (MotionTable, ShipSeaState)
+{
+  MotionTable::ShipMotion m;
+  m.heave_stdev = 0.8;
+  m.roll_stdev = 0.1;
+  std::shared_ptr<const MotionTable> a = MotionTable::ship(m, 1);
+  std::shared_ptr<const MotionTable> b = MotionTable::ship(m, 2);
+
+  const ArrayXd heave = a->samples().row(MotionTable::Z).array();
+  const ArrayXd roll = a->samples().row(MotionTable::ROLL).array();
+  EXPECT_NEAR(std::sqrt((heave - heave.mean()).square().mean()), 0.8, 1e-6);
+  EXPECT_NEAR(std::sqrt((roll - roll.mean()).square().mean()), 0.1, 1e-6);
+  EXPECT_NEAR(heave.mean(), m.start.z(), 1e-9);
+  EXPECT_FALSE(a->samples().isApprox(b->samples()));
+}
+
+// Round a rectangle at a steady speed, turning once clockwise per lap
+TEST (MotionTable, PathLaps)
+{
+  std::vector<Vector3d> waypoints = {Vector3d(0, 0, 0), Vector3d(20, 0, 0), Vector3d(20, 10, 0), Vector3d(0, 10, 0)};
+  std::shared_ptr<const MotionTable> table = MotionTable::path(waypoints, 2.0);
+  const MotionTable& rover = *table;
+  EXPECT_TRUE(rover.samples().col(0).head<3>().isZero());
+  EXPECT_NEAR(rover.drift()(MotionTable::YAW), 2.0 * M_PI, 1e-9);
+  EXPECT_TRUE(rover.drift().head<3>().isZero());
+
+  for (size_t i = 0; i < rover.size(); i++)
+  {
+    const Vector3d step = rover.samples().col((i + 1) % rover.size()).head<3>() - rover.samples().col(i).head<3>();
+    EXPECT_NEAR(step.norm() / rover.dt(), 2.0, 0.1) << i;
+    EXPECT_NEAR(rover.samples()(MotionTable::ROLL, i), 0.0, 1e-12);
+  }
+  // Facing north halfway along the first side
+  EXPECT_NEAR(rover(5.0)(MotionTable::YAW), 0.0, 0.02);
+}
+
+// The landmark view, the copied landmarks and the marker all follow the platform
+TEST (PlatformVehicle, CarriesMarkerAndLandmarks)
+{
+  std::vector<Vector3d> waypoints = {Vector3d(0, 0, -1), Vector3d(20, 0, -1), Vector3d(20, 10, -1)};
+  PlatformVehicle veh(MotionTable::path(waypoints, 3.0), 2.0);
+  veh.set_aruco(Vector3d(0.5, 0, 0), quat::Quatd::Identity());
+  veh.set_landmark_grid(3, 4, 0.5, Vector3d::Zero(), 10);
+  veh.step(0.7);
+  EXPECT_NEAR(veh.t(), 2.7, 1e-12);
+
+  LandmarkView view = veh.landmarks();
+  ASSERT_EQ(view.size, 12);
+  std::vector<int> ids;
+  std::vector<Vector3d> pts;
+  veh.landmarkLocations(ids, pts);
+  ASSERT_EQ(ids.size(), 12u);
+  for (int i = 0; i < view.size; i++)
+  {
+    EXPECT_EQ(view.ids[i], 10 + i);
+    EXPECT_EQ(ids[i], view.ids[i]);
+    EXPECT_TRUE(pts[i] == view.points().col(i));
+  }
+
+  // The grid is centred on the platform, level, and the marker is ahead of it
+  const xform::Xformd& x_I2b = veh.pose();
+  EXPECT_TRUE(view.points().rowwise().mean().isApprox(x_I2b.t(), 1e-9));
+  EXPECT_TRUE((view.points().row(2).array() == x_I2b.t().z()).all());
+  Vector3d p_I_a;
+  veh.arucoLocation(p_I_a);
+  EXPECT_TRUE(p_I_a.isApprox(x_I2b.t() + x_I2b.q().rota(Vector3d(0.5, 0, 0))));
+  EXPECT_TRUE(veh.getPosition().isApprox(x_I2b.t().head<2>()));
+
+  // An id for every landmark, no more and no fewer
+  EXPECT_THROW(veh.set_landmarks(std::vector<int>(13), Matrix3Xd::Zero(3, 12)), std::runtime_error);
+  EXPECT_THROW(veh.set_landmarks(std::vector<int>(11), Matrix3Xd::Zero(3, 12)), std::runtime_error);
+  EXPECT_EQ(veh.landmarks().size, 12);
+}
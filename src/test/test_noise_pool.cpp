@@ -0,0 +1,53 @@
+#include <gtest/gtest.h>
+
+#include "multirotor_sim/noise_pool.h"
+
+using namespace Eigen;
+using namespace multirotor_sim;
+
+TEST (NoisePool, ReproducibleBySeed)
+{
+  NoisePool a(42, 64), b(42, 64), c(43, 64);
+  for (int i = 0; i < 200; i++)
+  {
+    Vector3d za = a.normal<Vector3d>(2.0);
+    EXPECT_TRUE(za == b.normal<Vector3d>(2.0));
+    EXPECT_FALSE(za == c.normal<Vector3d>(2.0));
+  }
+
+  // Reseeding starts the sequence over
+  NoisePool d(7, 64);
+  double first = d.normal();
+  for (int i = 0; i < 100; i++)
+    d.normal();
+  d.seed(7);
+  EXPECT_EQ(d.normal(), first);
+}
+
+TEST (NoisePool, SlicesStayInOneBlock)
+{
+  NoisePool pool(1, 16);
+  EXPECT_EQ(pool.block_size(), 16u);
+  const double* first = pool.take(10);
+  const double* second = pool.take(10); // doesn't fit in what's left of the block
+  EXPECT_EQ(second, first);
+  const double* third = pool.take(6);
+  EXPECT_EQ(third, first + 10);
+}
+
+TEST (NoisePool, StandardNormal)
+{
+  NoisePool pool(3);
+  const int N = 400000;
+  double sum = 0, sum_sq = 0, sum_4 = 0;
+  for (int i = 0; i < N; i++)
+  {
+    double x = pool.normal();
+    sum += x;
+    sum_sq += x * x;
+    sum_4 += x * x * x * x;
+  }
+  EXPECT_NEAR(sum / N, 0.0, 0.01);
+  EXPECT_NEAR(sum_sq / N, 1.0, 0.01);
+  EXPECT_NEAR(sum_4 / N, 3.0, 0.05); // kurtosis of a gaussian
+}
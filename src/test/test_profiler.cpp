@@ -0,0 +1,58 @@
+#include <gtest/gtest.h>
+#include <sstream>
+
+#include "multirotor_sim/profiler.h"
+
+using namespace multirotor_sim;
+
+TEST (Profiler, HistogramBuckets)
+{
+  EXPECT_EQ(TimingHistogram::bucket(0), 0);
+  EXPECT_EQ(TimingHistogram::bucket(1), 0);
+  EXPECT_EQ(TimingHistogram::bucket(2), 1);
+  EXPECT_EQ(TimingHistogram::bucket(3), 1);
+  EXPECT_EQ(TimingHistogram::bucket(1024), 10);
+  EXPECT_EQ(TimingHistogram::bucket(~0ull), TimingHistogram::NUM_BUCKETS - 1);
+}
+
+TEST (Profiler, HistogramStatistics)
+{
+  TimingHistogram h;
+  EXPECT_EQ(h.count(), 0u);
+  EXPECT_EQ(h.min_ns(), 0u);
+  EXPECT_DOUBLE_EQ(h.percentile(0.5), 0.0);
+
+  for (uint64_t ns = 1000; ns <= 100000; ns += 1000)
+    h.add(ns);
+
+  EXPECT_EQ(h.count(), 100u);
+  EXPECT_EQ(h.min_ns(), 1000u);
+  EXPECT_EQ(h.max_ns(), 100000u);
+  EXPECT_DOUBLE_EQ(h.mean_ns(), 50500.0);
+
+  // Bucket resolution is a factor of two
+  EXPECT_GT(h.percentile(0.5), 25000.0);
+  EXPECT_LT(h.percentile(0.5), 100000.0);
+  EXPECT_LE(h.percentile(0.5), h.percentile(0.99));
+  EXPECT_LE(h.percentile(1.0), 100000.0);
+
+  h.clear();
+  EXPECT_EQ(h.count(), 0u);
+  EXPECT_EQ(h.bucket_count(TimingHistogram::bucket(1000)), 0u);
+}
+
+TEST (Profiler, ScopedTimerRecordsStage)
+{
+  Profiler prof;
+  for (int i = 0; i < 3; i++)
+  {
+    ScopedTimer timer(prof, PROF_DYNAMICS);
+  }
+  EXPECT_EQ(prof.stage(PROF_DYNAMICS).count(), 3u);
+  EXPECT_EQ(prof.stage(PROF_IMU).count(), 0u);
+
+  std::stringstream ss;
+  prof.print(ss);
+  EXPECT_NE(ss.str().find("dynamics"), std::string::npos);
+  EXPECT_EQ(ss.str().find("imu"), std::string::npos);
+}
@@ -0,0 +1,166 @@
+#include <gtest/gtest.h>
+
+#include "multirotor_sim/rasterizer.h"
+
+using namespace Eigen;
+using namespace multirotor_sim;
+
+namespace
+{
+
+Camera<double> test_camera()
+{
+  Camera<double> cam;
+  cam.focal_len_ << 250.0, 250.0;
+  cam.cam_center_ << 320.0, 240.0;
+  cam.image_size_ << 640.0, 480.0;
+  cam.distortion_.setZero();
+  cam.s_ = 0.0;
+  return cam;
+}
+
+// Camera at the origin, its axes the inertial axes, so it looks down
+xform::Xformd looking_down()
+{
+  return xform::Xformd::Identity();
+}
+
+// Pixel of the point (x, y, z) seen by looking_down() through test_camera()
+void pixel(double x, double y, double z, int& u, int& v)
+{
+  u = (int)std::floor(250.0 * x / z + 320.0);
+  v = (int)std::floor(250.0 * y / z + 240.0);
+}
+
+// Whether any pixel is pure black or white, which only markers have
+bool has_marker_pixels(const GrayImage& img)
+{
+  for (int v = 0; v < img.height; v++)
+  {
+    for (int u = 0; u < img.width; u++)
+    {
+      if (img(u, v) == 0 || img(u, v) == 255)
+        return true;
+    }
+  }
+  return false;
+}
+
+}
+
+// A 2 m marker 5 m below the camera, facing it: 8 cells of 0.25 m, the outer ring white, the
+// next black and the bits within
+TEST (Rasterizer, MarkerCells)
+{
+  Rasterizer r;
+  r.add_quad(Vector3d(-1, -1, 5), Vector3d(2, 0, 0), Vector3d(0, 2, 0), Rasterizer::MARKER);
+  GrayImage img;
+  r.render(looking_down(), test_camera(), img);
+  ASSERT_EQ(img.width, 640);
+  ASSERT_EQ(img.height, 480);
+
+  const int bits[4][4] = {{1, 0, 1, 1}, {0, 1, 0, 1}, {0, 0, 1, 1}, {0, 0, 1, 0}};
+  for (int row = 0; row < 8; row++)
+  {
+    for (int col = 0; col < 8; col++)
+    {
+      int u, v;
+      pixel(-1.0 + (col + 0.5) * 0.25, -1.0 + (row + 0.5) * 0.25, 5.0, u, v);
+      int expected;
+      if (row == 0 || row == 7 || col == 0 || col == 7)
+        expected = 255;
+      else if (row == 1 || row == 6 || col == 1 || col == 6)
+        expected = 0;
+      else
+        expected = bits[row - 2][col - 2] ? 255 : 0;
+      EXPECT_EQ(img(u, v), expected) << row << " " << col;
+    }
+  }
+
+  // Nothing beyond the marker
+  int u, v;
+  pixel(-1.1, 0.0, 5.0, u, v);
+  EXPECT_NE(img(u, v), 255);
+}
+
+// The nearer surface wins, whichever order they were added in
+TEST (Rasterizer, WallHidesMarker)
+{
+  Rasterizer r;
+  r.set_ground(10.0);
+  int marker = r.add_quad(Vector3d(-1, -1, 5), Vector3d(2, 0, 0), Vector3d(0, 2, 0), Rasterizer::MARKER);
+  GrayImage img;
+  r.render(looking_down(), test_camera(), img);
+  EXPECT_TRUE(has_marker_pixels(img));
+
+  r.add_quad(Vector3d(-2, -2, 3), Vector3d(4, 0, 0), Vector3d(0, 4, 0), Rasterizer::WALL);
+  r.render(looking_down(), test_camera(), img);
+  EXPECT_FALSE(has_marker_pixels(img));
+
+  // Moved beneath the ground
+  r.clear_quads();
+  marker = r.add_quad(Vector3d(-1, -1, 5), Vector3d(2, 0, 0), Vector3d(0, 2, 0), Rasterizer::MARKER);
+  r.move_quad(marker, Vector3d(-1, -1, 12), Vector3d(2, 0, 0), Vector3d(0, 2, 0));
+  r.render(looking_down(), test_camera(), img);
+  EXPECT_FALSE(has_marker_pixels(img));
+}
+
+// Tiles rendered by several threads make the same image as one thread
+TEST (Rasterizer, ThreadsMatch)
+{
+  Rasterizer one(1), four(4);
+  EXPECT_EQ(four.num_threads(), 4);
+  for (Rasterizer* r : {&one, &four})
+  {
+    r->set_ground(0.0);
+    srand(2);
+    for (int i = 0; i < 50; i++)
+    {
+      Vector3d lo = 30.0 * Vector3d::Random();
+      lo.z() = 0.0;
+      r->add_quad(lo, Vector3d(2, 1, 0), Vector3d(0, 0, -3), Rasterizer::WALL);
+    }
+    r->add_quad(Vector3d(5, 0, -1), Vector3d(0, 1, 0), Vector3d(0, 0, 1), Rasterizer::MARKER);
+  }
+
+  // 2 m up, pitched down a little from looking north
+  Matrix3d R_c2I;
+  R_c2I << 0, -0.2, 0.98, 1, 0, 0, 0, 0.98, 0.2;
+  Quaterniond q(R_c2I);
+  q.normalize();
+  Matrix<double, 7, 1> arr;
+  arr << -10, 0, -2, q.w(), q.x(), q.y(), q.z();
+  xform::Xformd x_I2c(arr);
+
+  GrayImage a, b;
+  for (int frame = 0; frame < 3; frame++)
+  {
+    arr(0) += 1.0;
+    x_I2c = xform::Xformd(arr);
+    one.render(x_I2c, test_camera(), a);
+    four.render(x_I2c, test_camera(), b);
+    ASSERT_EQ(a.pixels, b.pixels);
+  }
+}
+
+// Buffers are only reused once nothing else holds them
+TEST (ImagePool, ReusesReleasedImages)
+{
+  ImagePool pool;
+  std::shared_ptr<GrayImage> a = pool.acquire(640, 480);
+  const GrayImage* first = a.get();
+  EXPECT_EQ(a->stride, 640);
+  std::shared_ptr<const GrayImage> held = a;
+  a.reset();
+  std::shared_ptr<GrayImage> b = pool.acquire(100, 10);
+  EXPECT_NE(b.get(), first);
+  EXPECT_EQ(b->stride, 128);
+  EXPECT_EQ(pool.size(), 2u);
+
+  held.reset();
+  b.reset();
+  std::shared_ptr<GrayImage> c = pool.acquire(640, 480);
+  std::shared_ptr<GrayImage> d = pool.acquire(640, 480);
+  EXPECT_EQ(pool.size(), 2u);
+  EXPECT_TRUE(c.get() == first || d.get() == first);
+}
@@ -0,0 +1,241 @@
+#include <gtest/gtest.h>
+#include <vector>
+
+#include "multirotor_sim/recorder.h"
+
+using namespace Eigen;
+using namespace multirotor_sim;
+
+// Flattens every value it receives, so two streams of callbacks can be compared exactly
+class CaptureEstimator : public EstimatorBase
+{
+public:
+  void imuCallback(const double& t, const Vector6d& z, const Matrix6d& R) override { add(0, t, z, R); }
+  void altCallback(const double& t, const Vector1d& z, const Matrix1d& R) override { add(1, t, z, R); }
+  void baroCallback(const double& t, const Vector1d& z, const Matrix1d& R) override { add(2, t, z, R); }
+  void mocapCallback(const double& t, const Xformd& z, const Matrix6d& R) override { add(3, t, z.elements(), R); }
+  void velocityCallback(const double& t, const Vector3d& z, const Matrix3d& R) override { add(4, t, z, R); }
+  void voCallback(const double& t, const Xformd& z, const Matrix6d& R) override { add(5, t, z.elements(), R); }
+  void imageCallback(const double& t, const ImageFeat& z, const Matrix2d& R_pix, const Matrix1d& R_depth) override
+  {
+    add(6, t, R_pix, R_depth);
+    add_image(z);
+  }
+  void arucoCallback(const double& t, const xform::Xformd& z, const Matrix6d& R) override { add(7, t, z.elements(), R); }
+  void landmarksCallback(const double& t, const ImageFeat& z, const Matrix2d& R_pix) override
+  {
+    add(8, t, R_pix, Matrix1d::Zero());
+    add_image(z);
+  }
+  void gnssCallback(const double& t, const Vector6d& z, const Matrix6d& R) override { add(9, t, z, R); }
+  void rawGnssCallback(const GTime& t, const VecVec3& z, const VecMat3& R,
+                       std::vector<Satellite, aligned_allocator<Satellite>>& sat,
+                       const std::vector<bool>& slip) override
+  {
+    data.push_back(10);
+    data.push_back(t.week);
+    data.push_back(t.tow_sec);
+    for (size_t i = 0; i < z.size(); i++)
+    {
+      add_matrix(z[i]);
+      add_matrix(R[i]);
+      data.push_back(slip[i]);
+    }
+    for (size_t i = 0; i < sat.size(); i++)
+    {
+      data.push_back(sat[i].id_);
+      data.push_back(sat[i].idx_);
+      data.push_back(sat[i].eph_.toe.tow_sec);
+      data.push_back(sat[i].eph_.A);
+      data.push_back(sat[i].eph_.f0);
+    }
+  }
+
+  template <typename A, typename B>
+  void add(int type, double t, const MatrixBase<A>& z, const MatrixBase<B>& R)
+  {
+    data.push_back(type);
+    data.push_back(t);
+    add_matrix(z);
+    add_matrix(R);
+  }
+  template <typename A>
+  void add_matrix(const MatrixBase<A>& m)
+  {
+    for (int i = 0; i < m.size(); i++)
+      data.push_back(m(i));
+  }
+  void add_image(const ImageFeat& z)
+  {
+    data.push_back(z.id);
+    data.push_back(z.t);
+    for (size_t i = 0; i < z.pixs.size(); i++)
+      add_matrix(z.pixs[i]);
+    for (size_t i = 0; i < z.feat_ids.size(); i++)
+      data.push_back(z.feat_ids[i]);
+  }
+
+  std::vector<double> data;
+};
+
+static Xformd random_xform()
+{
+  Matrix<double, 7, 1> arr = Matrix<double, 7, 1>::Random();
+  arr.tail<4>().normalize();
+  return Xformd(arr);
+}
+
+static ImageFeat random_image(int n)
+{
+  ImageFeat img;
+  img.id = n;
+  img.t = 0.1 * n;
+  for (int i = 0; i < n; i++)
+  {
+    img.pixs.push_back(Vector2d::Random() * 640);
+    img.feat_ids.push_back(i * 3);
+  }
+  return img;
+}
+
+// Delivers the same pseudo-random stream of every kind of callback to each estimator
+static void deliver_all(std::vector<EstimatorBase*> est)
+{
+  std::vector<Satellite, aligned_allocator<Satellite>> sats;
+  for (int i = 0; i < 4; i++)
+  {
+    sats.push_back(Satellite(i + 3, i));
+    sats.back().eph_.A = 2.6e7 + i;
+    sats.back().eph_.toe.tow_sec = 1000 * i;
+  }
+
+  for (int k = 0; k < 20; k++)
+  {
+    double t = 0.01 * k + 1.0 / 3.0;
+    Vector6d z6 = Vector6d::Random();
+    Matrix6d R6 = Matrix6d::Random();
+    Vector1d z1 = Vector1d::Random();
+    Matrix1d R1 = Matrix1d::Random();
+    Vector3d z3 = Vector3d::Random();
+    Matrix3d R3 = Matrix3d::Random();
+    Matrix2d R2 = Matrix2d::Random();
+    Xformd x = random_xform();
+    ImageFeat img = random_image(k % 5);
+    VecVec3 zs;
+    VecMat3 Rs;
+    std::vector<bool> slip;
+    for (size_t i = 0; i < sats.size(); i++)
+    {
+      zs.push_back(Vector3d::Random() * 1e7);
+      Rs.push_back(Matrix3d::Random());
+      slip.push_back((i + k) % 3 == 0);
+    }
+    if (k == 10)
+      sats[2].eph_.f0 = 1e-5;
+
+    for (size_t i = 0; i < est.size(); i++)
+    {
+      est[i]->imuCallback(t, z6, R6);
+      if (k % 2 == 0)
+      {
+        est[i]->altCallback(t, z1, R1);
+        est[i]->baroCallback(t, z1, R1);
+        est[i]->velocityCallback(t, z3, R3);
+        est[i]->mocapCallback(t, x, R6);
+      }
+      if (k % 4 == 0)
+      {
+        est[i]->voCallback(t, x, R6);
+        est[i]->imageCallback(t, img, R2, R1);
+        est[i]->arucoCallback(t, x, R6);
+        est[i]->landmarksCallback(t, img, R2);
+        est[i]->gnssCallback(t, z6, R6);
+        est[i]->rawGnssCallback(GTime(2026, 165029 + t), zs, Rs, sats, slip);
+      }
+    }
+  }
+}
+
+TEST (Recorder, ReplayIsBitExact)
+{
+  std::string filename = "/tmp/Recorder.ReplayIsBitExact.rec";
+  MeasurementRecorder rec;
+  CaptureEstimator truth, replayed;
+  ASSERT_TRUE(rec.open(filename));
+  deliver_all(std::vector<EstimatorBase*>{&rec, &truth});
+  EXPECT_TRUE(rec.close());
+
+  MeasurementReplayer replay;
+  replay.open(filename);
+  replay.register_estimator(&replayed);
+  EXPECT_EQ(replay.run(), 20u + 4*10u + 5*6u);
+  ASSERT_EQ(replayed.data.size(), truth.data.size());
+  EXPECT_TRUE(replayed.data == truth.data);
+
+  // A second pass after rewinding delivers the same stream
+  replayed.data.clear();
+  replay.rewind();
+  replay.run();
+  EXPECT_TRUE(replayed.data == truth.data);
+}
+
+TEST (Recorder, SatellitesRecordedWhenChanged)
+{
+  MeasurementRecorder rec;
+  ASSERT_TRUE(rec.open("/tmp/Recorder.Satellites.rec"));
+  deliver_all(std::vector<EstimatorBase*>{&rec});
+  // 90 measurements, plus the satellites at the first raw GNSS and after the change at k = 10
+  EXPECT_EQ(rec.num_records(), 20u + 4*10u + 5*6u + 2u);
+}
+
+TEST (Recorder, RejectsOtherFiles)
+{
+  MeasurementReplayer replay;
+  EXPECT_THROW(replay.open("/tmp/does_not_exist.rec"), std::runtime_error);
+  FILE* f = fopen("/tmp/Recorder.NotARecording.rec", "wb");
+  fputs("this is not a recording", f);
+  fclose(f);
+  EXPECT_THROW(replay.open("/tmp/Recorder.NotARecording.rec"), std::runtime_error);
+}
+
+// A full disk closes the recording rather than truncating it silently
+TEST (Recorder, ReportsFailedWrites)
+{
+  MeasurementRecorder rec;
+  ASSERT_TRUE(rec.open("/dev/full"));
+  for (int i = 0; i < 1000; i++)
+    rec.imuCallback(i * 0.01, Vector6d::Zero(), Matrix6d::Identity());
+  EXPECT_FALSE(rec.is_open());
+  EXPECT_TRUE(rec.failed());
+  EXPECT_LT(rec.num_records(), 1000u);
+  EXPECT_FALSE(rec.close());
+}
+
+// Counts in a record that claim more than its payload holds
+TEST (Recorder, RejectsOverrunningRecords)
+{
+  std::string filename = "/tmp/Recorder.Overrun.rec";
+  {
+    MeasurementRecorder rec;
+    ASSERT_TRUE(rec.open(filename));
+    ImageFeat img;
+    img.id = 1;
+    img.t = 0.5;
+    img.pixs.push_back(Vector2d(1, 2));
+    img.feat_ids.push_back(7);
+    rec.landmarksCallback(0.5, img, Matrix2d::Identity());
+    ASSERT_TRUE(rec.close());
+  }
+
+  // npix follows the record header, t, R_pix, the image id and its t
+  FILE* f = fopen(filename.c_str(), "r+b");
+  ASSERT_TRUE(f != nullptr);
+  uint32_t npix = 1000000;
+  fseek(f, recording::HEADER_SIZE + recording::RECORD_HEADER_SIZE + 8 + 32 + 4 + 8, SEEK_SET);
+  fwrite(&npix, sizeof(npix), 1, f);
+  fclose(f);
+
+  MeasurementReplayer replay;
+  replay.open(filename);
+  EXPECT_THROW(replay.step(), std::runtime_error);
+}
@@ -0,0 +1,158 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <limits>
+#include <random>
+
+#include "multirotor_sim/scene.h"
+
+using namespace Eigen;
+using namespace multirotor_sim;
+
+namespace
+{
+
+// Entry distance of a ray into a box by the slab method, for an origin outside it
+double box_entry(const Vector3d& lo, const Vector3d& hi, const Vector3d& origin, const Vector3d& dir)
+{
+  double t_near = 0, t_far = std::numeric_limits<double>::infinity();
+  for (int i = 0; i < 3; i++)
+  {
+    double t0 = (lo(i) - origin(i)) / dir(i);
+    double t1 = (hi(i) - origin(i)) / dir(i);
+    t_near = std::max(t_near, std::min(t0, t1));
+    t_far = std::min(t_far, std::max(t0, t1));
+  }
+  return t_near <= t_far && t_near > 0 ? t_near : std::numeric_limits<double>::infinity();
+}
+
+}
+
+TEST (Scene, Wall)
+{
+  Scene scene;
+  // 10 m north of the origin facing it, 4 m wide to the east and 3 m high
+  scene.add_wall(Vector3d(10, 0, 0), Vector3d(-1, 0, 0), 4.0, 3.0);
+  scene.build();
+
+  double range;
+  int surface;
+  ASSERT_TRUE(scene.cast(Vector3d(0, 1, -1), Vector3d::UnitX(), 100.0, range, &surface));
+  EXPECT_NEAR(range, 10.0, 1e-12);
+  EXPECT_EQ(surface, 0);
+  EXPECT_FALSE(scene.cast(Vector3d(0, -1, -1), Vector3d::UnitX(), 100.0, range)); // beside it
+  EXPECT_FALSE(scene.cast(Vector3d(0, 1, -4), Vector3d::UnitX(), 100.0, range)); // over it
+  EXPECT_FALSE(scene.cast(Vector3d(0, 1, -1), Vector3d::UnitX(), 5.0, range)); // out of range
+
+  scene.set_ground(0.0);
+  ASSERT_TRUE(scene.cast(Vector3d(0, 1, -2), Vector3d::UnitZ(), 100.0, range, &surface));
+  EXPECT_NEAR(range, 2.0, 1e-12);
+  EXPECT_EQ(surface, (int)Scene::GROUND);
+}
+
+// Single and packet casts through the hierarchy against every box tested directly
+TEST (Scene, BoxesMatchBruteForce)
+{
+  std::default_random_engine gen(1);
+  std::uniform_real_distribution<double> position(-50.0, 50.0);
+  std::uniform_real_distribution<double> size(0.5, 5.0);
+  std::normal_distribution<double> normal;
+
+  Scene scene;
+  scene.set_ground(0.0);
+  std::vector<Vector3d> lo, hi;
+  for (int i = 0; i < 200; i++)
+  {
+    Vector3d l(position(gen), position(gen), -size(gen) - 2.0);
+    Vector3d h = l + Vector3d(size(gen), size(gen), size(gen));
+    lo.push_back(l);
+    hi.push_back(h);
+    scene.add_box(l, h);
+  }
+  scene.build();
+  EXPECT_EQ(scene.num_rectangles(), 1200u);
+
+  const Vector3d origin(0, 0, -20);
+  Matrix3Xd dirs(3, 1000);
+  for (int j = 0; j < dirs.cols(); j++)
+  {
+    dirs.col(j) << normal(gen), normal(gen), std::abs(normal(gen));
+    dirs.col(j).normalize();
+  }
+  VectorXd ranges;
+  scene.cast(origin, dirs, 200.0, ranges);
+
+  int hits = 0;
+  for (int j = 0; j < dirs.cols(); j++)
+  {
+    Vector3d dir = dirs.col(j);
+    double expected = -origin.z() / dir.z();
+    for (size_t i = 0; i < lo.size(); i++)
+      expected = std::min(expected, box_entry(lo[i], hi[i], origin, dir));
+    if (expected >= 200.0)
+      expected = std::numeric_limits<double>::infinity();
+    else if (expected < -origin.z() / dir.z())
+      hits++;
+
+    double range = std::numeric_limits<double>::infinity();
+    scene.cast(origin, dir, 200.0, range);
+    if (std::isinf(expected))
+    {
+      EXPECT_TRUE(std::isinf(range));
+      EXPECT_TRUE(std::isinf(ranges[j]));
+      continue;
+    }
+    EXPECT_NEAR(range, expected, 1e-9);
+    EXPECT_NEAR(ranges[j], expected, 1e-9);
+  }
+  EXPECT_GT(hits, 10);
+}
+
+// Occlusion of points against the nearest hit of a full cast
+TEST (Scene, OccludedMatchesCast)
+{
+  std::default_random_engine gen(2);
+  std::uniform_real_distribution<double> position(-50.0, 50.0);
+  std::uniform_real_distribution<double> size(0.5, 5.0);
+
+  Scene scene;
+  scene.set_ground(0.0);
+  for (int i = 0; i < 200; i++)
+  {
+    Vector3d lo(position(gen), position(gen), -size(gen) - 2.0);
+    scene.add_box(lo, lo + Vector3d(size(gen), size(gen), size(gen)));
+  }
+  scene.build();
+
+  // Points below the ground aren't hidden by it
+  const Vector3d origin(0, 0, -20);
+  Matrix3Xd points(3, 1001);
+  for (int j = 0; j < points.cols(); j++)
+    points.col(j) << position(gen), position(gen), std::abs(position(gen)) / 10.0 - 4.0;
+  Array<bool, Dynamic, 1> blocked(points.cols());
+  scene.occluded(origin, points.data(), points.cols(), blocked.data());
+
+  int num_blocked = 0;
+  for (int j = 0; j < points.cols(); j++)
+  {
+    Vector3d delta = points.col(j) - origin;
+    double range = std::numeric_limits<double>::infinity();
+    int surface = Scene::NONE;
+    scene.cast(origin, delta.normalized(), delta.norm() - 1e-6, range, &surface);
+    bool expected = surface >= 0;
+    EXPECT_EQ(blocked[j], expected) << j;
+    num_blocked += expected;
+  }
+  EXPECT_GT(num_blocked, 10);
+  EXPECT_LT(num_blocked, 990);
+
+  // A point on a face isn't hidden by it
+  Scene box;
+  box.add_box(Vector3d(10, -1, -1), Vector3d(12, 1, 1));
+  box.build();
+  Vector3d on_face(10, 0, 0), behind(13, 0, 0);
+  bool face_blocked, behind_blocked;
+  box.occluded(Vector3d::Zero(), on_face.data(), 1, &face_blocked);
+  box.occluded(Vector3d::Zero(), behind.data(), 1, &behind_blocked);
+  EXPECT_FALSE(face_blocked);
+  EXPECT_TRUE(behind_blocked);
+}
@@ -0,0 +1,191 @@
+#include <gtest/gtest.h>
+#include <vector>
+
+#include "multirotor_sim/simulator.h"
+#include "multirotor_sim/platform_vehicle.h"
+
+using namespace Eigen;
+using namespace multirotor_sim;
+
+namespace
+{
+
+// Flattens the measurements it receives, so two continuations can be compared exactly
+class CaptureEstimator : public EstimatorBase
+{
+public:
+  void imuCallback(const double& t, const Vector6d& z, const Matrix6d& R) override { add(t, z); }
+  void altCallback(const double& t, const Vector1d& z, const Matrix1d& R) override { add(t, z); }
+  void baroCallback(const double& t, const Vector1d& z, const Matrix1d& R) override { add(t, z); }
+  void mocapCallback(const double& t, const Xformd& z, const Matrix6d& R) override { add(t, z.elements()); }
+  void velocityCallback(const double& t, const Vector3d& z, const Matrix3d& R) override { add(t, z); }
+  void voCallback(const double& t, const Xformd& z, const Matrix6d& R) override { add(t, z.elements()); }
+  void imageCallback(const double& t, const ImageFeat& z, const Matrix2d& R_pix, const Matrix1d& R_depth) override
+  {
+    for (size_t i = 0; i < z.pixs.size(); i++)
+      add(z.feat_ids[i], z.pixs[i]);
+  }
+  void gnssCallback(const double& t, const Vector6d& z, const Matrix6d& R) override { add(t, z); }
+  void rawGnssCallback(const GTime& t, const VecVec3& z, const VecMat3& R,
+                       std::vector<Satellite, aligned_allocator<Satellite>>& sat,
+                       const std::vector<bool>& slip) override
+  {
+    for (size_t i = 0; i < z.size(); i++)
+      add(t.tow_sec, z[i]);
+  }
+
+  template <typename A>
+  void add(double t, const MatrixBase<A>& z)
+  {
+    data.push_back(t);
+    for (int i = 0; i < z.size(); i++)
+      data.push_back(z(i));
+  }
+
+  std::vector<double> data;
+};
+
+}
+
+class SnapshotTest : public ::testing::Test
+{
+public:
+  SnapshotTest() :
+    sim(false) {}
+
+protected:
+  void SetUp() override
+  {
+    filename = "tmp.snapshot.params.yaml";
+    ofstream tmp_file(filename);
+    YAML::Node node = YAML::LoadFile(MULTIROTOR_SIM_DIR"/params/sim_params.yaml");
+    node["tmax"] = 60;
+    node["seed"] = 1;
+    node["dt"] = 0.004;
+    node["log_filename"] = "";
+    node["ephemeris_filename"] = MULTIROTOR_SIM_DIR"/sample/eph.dat";
+    node["imu_enabled"] = true;
+    node["alt_enabled"] = true;
+    node["baro_enabled"] = true;
+    node["mocap_enabled"] = true;
+    node["vo_enabled"] = true;
+    node["camera_enabled"] = true;
+    node["gnss_enabled"] = true;
+    node["raw_gnss_enabled"] = true;
+    node["velocity_sensor_enabled"] = true;
+    node["velocity_update_rate"] = 50;
+    node["velocity_noise_stdev"] = 0.1;
+    node["simple_cam_enabled"] = false;
+    node["enable_wind"] = true;
+    node["enable_dynamics_noise"] = true;
+    tmp_file << node;
+    tmp_file.close();
+
+    sim.load(filename);
+    sim.register_estimator(&est);
+  }
+
+  static void run_until(Simulator& s, double t)
+  {
+    while (s.t_ < t - 1e-9)
+      s.run();
+  }
+
+  Simulator sim;
+  CaptureEstimator est;
+  std::string filename;
+};
+
+TEST_F (SnapshotTest, RestoreRepeatsContinuation)
+{
+  run_until(sim, 2.0);
+  Simulator::Snapshot snap = sim.snapshot();
+
+  est.data.clear();
+  run_until(sim, 4.0);
+  std::vector<double> first = est.data;
+  State x_first = sim.state();
+  ASSERT_GT(first.size(), 0u);
+
+  sim.restore(snap);
+  EXPECT_EQ(sim.t_, 2.0);
+  est.data.clear();
+  run_until(sim, 4.0);
+  EXPECT_TRUE(est.data == first);
+  EXPECT_TRUE(sim.state().arr == x_first.arr);
+}
+
+TEST_F (SnapshotTest, ForkIntoAnotherSimulator)
+{
+  run_until(sim, 2.0);
+  Simulator::Snapshot snap = sim.snapshot();
+  est.data.clear();
+  run_until(sim, 4.0);
+
+  Simulator fork(false);
+  CaptureEstimator fork_est;
+  fork.load(filename);
+  fork.register_estimator(&fork_est);
+  fork.restore(snap);
+  run_until(fork, 4.0);
+  EXPECT_TRUE(fork_est.data == est.data);
+  EXPECT_TRUE(fork.state().arr == sim.state().arr);
+}
+
+TEST_F (SnapshotTest, ReseedDiverges)
+{
+  run_until(sim, 2.0);
+  Simulator::Snapshot snap = sim.snapshot();
+
+  sim.reseed(1234);
+  est.data.clear();
+  run_until(sim, 4.0);
+  std::vector<double> a = est.data;
+
+  sim.restore(snap);
+  sim.reseed(1234);
+  est.data.clear();
+  run_until(sim, 4.0);
+  EXPECT_TRUE(est.data == a);
+
+  sim.restore(snap);
+  sim.reseed(5678);
+  est.data.clear();
+  run_until(sim, 4.0);
+  EXPECT_FALSE(est.data == a);
+}
+
+// A ship deck landing pad forked with the run moves on from the snapshot, not from where the
+// last continuation left it
+TEST_F (SnapshotTest, ForkRestoresPlatform)
+{
+  std::shared_ptr<const MotionTable> ship = MotionTable::ship(MotionTable::ShipMotion(), 1);
+  PlatformVehicle deck(ship);
+  deck.set_aruco(Vector3d::Zero(), quat::Quatd::Identity());
+  sim.use_custom_vehicle(&deck);
+  run_until(sim, 2.0);
+  Simulator::Snapshot snap = sim.snapshot();
+  EXPECT_EQ(snap.platform_t, deck.t());
+
+  run_until(sim, 4.0);
+  const double t_end = deck.t();
+  Vector3d p_end;
+  deck.arucoLocation(p_end);
+
+  sim.restore(snap);
+  EXPECT_EQ(deck.t(), snap.platform_t);
+  sim.reseed(1234);
+  run_until(sim, 4.0);
+  Vector3d p;
+  deck.arucoLocation(p);
+  EXPECT_EQ(deck.t(), t_end);
+  EXPECT_TRUE(p == p_end);
+
+  // Into another simulator, whose own platform starts from the beginning of the table
+  Simulator fork(false);
+  PlatformVehicle fork_deck(ship);
+  fork.load(filename);
+  fork.use_custom_vehicle(&fork_deck);
+  fork.restore(snap);
+  EXPECT_EQ(fork_deck.t(), snap.platform_t);
+}
@@ -0,0 +1,50 @@
+#include <gtest/gtest.h>
+#include <thread>
+
+#include "multirotor_sim/spsc_queue.h"
+
+using namespace multirotor_sim;
+
+TEST (SPSCQueue, FullAndEmpty)
+{
+  SPSCQueue<int> q(3); // rounded up to 4
+  EXPECT_EQ(q.capacity(), 4u);
+  EXPECT_TRUE(q.empty());
+  int v;
+  EXPECT_FALSE(q.pop(v));
+  for (int i = 0; i < 4; i++)
+    EXPECT_TRUE(q.push(i));
+  EXPECT_FALSE(q.push(4));
+  EXPECT_EQ(q.size(), 4u);
+  for (int i = 0; i < 4; i++)
+  {
+    ASSERT_TRUE(q.pop(v));
+    EXPECT_EQ(v, i);
+  }
+  EXPECT_FALSE(q.pop(v));
+}
+
+TEST (SPSCQueue, TwoThreadsKeepOrder)
+{
+  SPSCQueue<int> q(16);
+  const int N = 20000;
+  std::thread producer([&q]()
+  {
+    for (int i = 0; i < N; i++)
+      while (!q.push(i))
+        std::this_thread::yield();
+  });
+
+  int expected = 0;
+  while (expected < N)
+  {
+    int v;
+    if (q.pop(v))
+    {
+      ASSERT_EQ(v, expected);
+      ++expected;
+    }
+  }
+  producer.join();
+  EXPECT_TRUE(q.empty());
+}
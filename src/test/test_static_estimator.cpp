@@ -0,0 +1,54 @@
+#include <gtest/gtest.h>
+#include <vector>
+
+#include "multirotor_sim/static_estimator.h"
+
+using namespace Eigen;
+using namespace multirotor_sim;
+
+namespace
+{
+
+std::vector<int> calls;
+
+class ImuOnly : public EstimatorBase
+{
+public:
+  void imuCallback(const double& t, const Vector6d& z, const Matrix6d& R) override { calls.push_back(1); }
+};
+
+class ImuAndAlt : public EstimatorBase
+{
+public:
+  void imuCallback(const double& t, const Vector6d& z, const Matrix6d& R) override { calls.push_back(2); }
+  void altCallback(const double& t, const Vector1d& z, const Matrix1d& R) override { calls.push_back(20); }
+};
+
+}
+
+TEST (StaticEstimators, DeliversToEachInOrder)
+{
+  ImuOnly a;
+  ImuAndAlt b;
+  StaticEstimators<ImuAndAlt, ImuOnly, ImuAndAlt> est(b, a, b);
+  EstimatorBase* base = &est;
+
+  calls.clear();
+  base->imuCallback(0.1, Vector6d::Zero(), Matrix6d::Identity());
+  base->altCallback(0.1, Vector1d::Zero(), Matrix1d::Identity());
+  base->baroCallback(0.1, Vector1d::Zero(), Matrix1d::Identity());
+  EXPECT_EQ(calls, (std::vector<int>{2, 1, 2, 20, 20}));
+}
+
+TEST (StaticSimulator, RegistersItsEstimators)
+{
+  ImuOnly a;
+  ImuAndAlt b;
+  StaticSimulator<ImuOnly, ImuAndAlt> sim(a, b, false, 1);
+  ASSERT_EQ(sim.est_.size(), 1u);
+  EXPECT_EQ(sim.est_[0], &sim.estimators());
+
+  calls.clear();
+  sim.est_[0]->imuCallback(0.1, Vector6d::Zero(), Matrix6d::Identity());
+  EXPECT_EQ(calls, (std::vector<int>{1, 2}));
+}
@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+#include <fstream>
+#include <sstream>
+
+#include "multirotor_sim/trace.h"
+
+using namespace multirotor_sim;
+
+TEST (Trace, DisabledRecordsNothing)
+{
+  TraceRecorder trace;
+  EXPECT_FALSE(trace.enabled());
+  trace.instant(PROF_IMU, 0.1);
+  {
+    TraceSpan span(trace, PROF_DYNAMICS, 0.1);
+  }
+  EXPECT_EQ(trace.size(), 0u);
+}
+
+TEST (Trace, RingBufferKeepsNewestEvents)
+{
+  TraceRecorder trace;
+  trace.init(5); // rounded up to 8
+  for (int i = 0; i < 20; i++)
+    trace.instant(PROF_MOCAP, i * 0.1, 0.01 * i);
+
+  ASSERT_EQ(trace.size(), 8u);
+  EXPECT_EQ(trace.dropped(), 12u);
+  for (int i = 0; i < 8; i++)
+  {
+    EXPECT_EQ(trace.event(i).stage, PROF_MOCAP);
+    EXPECT_EQ(trace.event(i).kind, TraceRecorder::INSTANT);
+    EXPECT_DOUBLE_EQ(trace.event(i).sim_t, (12 + i) * 0.1);
+    EXPECT_DOUBLE_EQ(trace.event(i).delay, 0.01 * (12 + i));
+  }
+}
+
+TEST (Trace, SpanRecordsDuration)
+{
+  TraceRecorder trace;
+  trace.init(16);
+  {
+    TraceSpan span(trace, PROF_IMU_CB, 2.0, TraceRecorder::ESTIMATOR_TID + 1);
+    volatile double x = 0;
+    for (int i = 0; i < 1000; i++)
+      x += i;
+  }
+  ASSERT_EQ(trace.size(), 1u);
+  EXPECT_EQ(trace.event(0).kind, TraceRecorder::SPAN);
+  EXPECT_EQ(trace.event(0).tid, TraceRecorder::ESTIMATOR_TID + 1);
+  EXPECT_DOUBLE_EQ(trace.event(0).sim_t, 2.0);
+  EXPECT_LE(trace.event(0).wall_ns, trace.now());
+}
+
+TEST (Trace, WriteChromeTrace)
+{
+  TraceRecorder trace;
+  trace.init(16);
+  {
+    TraceSpan span(trace, PROF_DYNAMICS, 0.004);
+  }
+  trace.instant(PROF_MOCAP, 0.004, 0.02);
+
+  std::string filename = "/tmp/Trace.WriteChromeTrace.json";
+  ASSERT_TRUE(trace.write_chrome_trace(filename));
+  std::ifstream file(filename);
+  std::stringstream ss;
+  ss << file.rdbuf();
+  std::string json = ss.str();
+  EXPECT_NE(json.find("\"traceEvents\""), std::string::npos);
+  EXPECT_NE(json.find("\"name\":\"dynamics\",\"ph\":\"X\""), std::string::npos);
+  EXPECT_NE(json.find("\"name\":\"mocap\",\"ph\":\"i\""), std::string::npos);
+  EXPECT_NE(json.find("\"delay\":0.020000"), std::string::npos);
+  EXPECT_NE(json.find("\"name\":\"sensors\""), std::string::npos);
+}
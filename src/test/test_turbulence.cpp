@@ -0,0 +1,150 @@
+#include <gtest/gtest.h>
+#include <fstream>
+
+#include "multirotor_sim/turbulence.h"
+#include "multirotor_sim/dynamics.h"
+#include "multirotor_sim/utils.h"
+
+using namespace Eigen;
+using namespace multirotor_sim;
+
+namespace
+{
+
+TurbulenceField::Params test_params()
+{
+  TurbulenceField::Params params;
+  params.size = 32;
+  params.cell_size = 5.0;
+  params.length_scale = 30.0;
+  params.stdev = 1.5;
+  return params;
+}
+
+}
+
+// Each component has the standard deviation asked for, and nearby winds are more alike than
+// distant ones
+TEST (TurbulenceField, Statistics)
+{
+  for (TurbulenceField::Model model : {TurbulenceField::DRYDEN, TurbulenceField::VON_KARMAN})
+  {
+    TurbulenceField::Params params = test_params();
+    params.model = model;
+    TurbulenceField field(params, 1);
+    const int n = params.size;
+    Vector3d sum = Vector3d::Zero(), sum_sq = Vector3d::Zero();
+    double near = 0.0, far = 0.0;
+    for (int k = 0; k < n; k++)
+    {
+      for (int j = 0; j < n; j++)
+      {
+        for (int i = 0; i < n; i++)
+        {
+          const Vector3d v = field.node(i, j, k);
+          sum += v;
+          sum_sq += v.cwiseProduct(v);
+          near += v.dot(field.node(i + 1, j, k));
+          far += v.dot(field.node(i + n / 2, j, k));
+        }
+      }
+    }
+    const double nodes = n * n * n;
+    EXPECT_NEAR(sum_sq.sum() / (3.0 * nodes), 1.5 * 1.5, 1e-3);
+    EXPECT_TRUE((sum / nodes).isZero(1e-3));
+    for (int c = 0; c < 3; c++)
+      EXPECT_NEAR(std::sqrt(sum_sq(c) / nodes), 1.5, 0.3) << c;
+    EXPECT_GT(near / nodes, 0.7 * 3.0 * 1.5 * 1.5);
+    EXPECT_LT(std::abs(far / nodes), 0.5 * near / nodes);
+  }
+}
+
+// Interpolates between nodes, and repeats every period
+TEST (TurbulenceField, SamplesPeriodically)
+{
+  TurbulenceField field(test_params(), 2);
+  EXPECT_NEAR(field.period(), 160.0, 1e-12);
+  EXPECT_TRUE(field.sample(Vector3d(10, 15, -5)).isApprox(field.node(2, 3, -1), 1e-6));
+  EXPECT_TRUE(field.sample(Vector3d(12.5, 15, -5)).isApprox(0.5 * (field.node(2, 3, -1) + field.node(3, 3, -1)), 1e-6));
+
+  const Vector3d p(13.3, -71.2, -4.4);
+  EXPECT_TRUE(field.sample(p).isApprox(field.sample(p + Vector3d(160, -320, 160)), 1e-6));
+}
+
+// Runs asking for the same field share it
+TEST (TurbulenceField, SharedBySeed)
+{
+  std::shared_ptr<const TurbulenceField> a = TurbulenceField::shared(test_params(), 3);
+  std::shared_ptr<const TurbulenceField> b = TurbulenceField::shared(test_params(), 3);
+  std::shared_ptr<const TurbulenceField> c = TurbulenceField::shared(test_params(), 4);
+  EXPECT_EQ(a.get(), b.get());
+  EXPECT_NE(a.get(), c.get());
+  EXPECT_NE(a->node(0, 0, 0), c->node(0, 0, 0));
+
+  TurbulenceField::Params params = test_params();
+  params.size = 48;
+  EXPECT_THROW(TurbulenceField(params, 1), std::runtime_error);
+  params = test_params();
+  params.cell_size = 0.0;
+  EXPECT_THROW(TurbulenceField(params, 1), std::runtime_error);
+  params = test_params();
+  params.length_scale = -1.0;
+  EXPECT_THROW(TurbulenceField(params, 1), std::runtime_error);
+}
+
+TEST (Gust, OneMinusCosine)
+{
+  Gust gust;
+  gust.start = 1.0;
+  gust.duration = 2.0;
+  gust.amplitude << 4, 0, -2;
+  EXPECT_TRUE(gust.velocity(0.5).isZero());
+  EXPECT_TRUE(gust.velocity(2.0).isApprox(gust.amplitude));
+  EXPECT_TRUE(gust.velocity(1.5).isApprox(0.5 * gust.amplitude));
+  EXPECT_TRUE(gust.velocity(3.5).isZero());
+}
+
+// The vehicle feels the field where it is, and two simulators with the same seed share it
+TEST (Dynamics, TurbulentWind)
+{
+  std::string filename = "/tmp/turbulence_params.yaml";
+  std::ofstream tmp_file(filename);
+  YAML::Node node;
+  node["mass"] = 1.0;
+  node["seed"] = 1;
+  node["max_thrust"] = 19.6133;
+  node["drag_constant"] = 0.1;
+  node["enable_dynamics_noise"] = false;
+  node["dyn_noise"] = std::vector<double>(12, 0.0);
+  node["angular_drag_constant"] = 0.01;
+  node["RK4"] = true;
+  node["p_b_u"] = std::vector<double>{0, 0, 0};
+  node["q_b_u"] = std::vector<double>{1, 0, 0, 0};
+  node["enable_wind"] = true;
+  node["wind_init_stdev"] = 0.0;
+  node["wind_walk_stdev"] = 0.0;
+  node["wind_turbulence"] = 2;
+  node["wind_turbulence_stdev"] = 1.5;
+  node["wind_turbulence_length"] = 30.0;
+  node["wind_turbulence_grid_size"] = 32;
+  node["wind_turbulence_cell_size"] = 5.0;
+  node["x0"] = std::vector<double>{0, 0, -5, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+  node["inertia"] = std::vector<double>{0.1, 0.1, 0.1};
+  tmp_file << node;
+  tmp_file.close();
+
+  Dynamics a, b;
+  a.load(filename);
+  b.load(filename);
+  ASSERT_TRUE(a.turbulence_ != nullptr);
+  EXPECT_EQ(a.turbulence_.get(), b.turbulence_.get());
+  EXPECT_TRUE(a.get_wind().isApprox(a.turbulence_->sample(Vector3d(0, 0, -5))));
+
+  // Still, with no mean wind, the wind only changes when the vehicle moves
+  a.update_wind(0.1);
+  EXPECT_TRUE(a.get_wind().isApprox(b.get_wind()));
+  a.get_state().p << 37.0, -12.0, -5.0;
+  a.update_wind(0.1);
+  EXPECT_TRUE(a.get_wind().isApprox(a.turbulence_->sample(Vector3d(37.0, -12.0, -5.0))));
+  EXPECT_FALSE(a.get_wind().isApprox(b.get_wind()));
+}
@@ -0,0 +1,67 @@
+#include <stdio.h>
+#include <set>
+
+#include "multirotor_sim/trace.h"
+
+namespace multirotor_sim
+{
+
+void TraceRecorder::init(size_t capacity)
+{
+  size_t size = 1;
+  while (size < capacity)
+    size <<= 1;
+  events_.resize(size);
+  mask_ = size - 1;
+  count_ = 0;
+  start_ns_ = Profiler::now_ns();
+}
+
+bool TraceRecorder::write_chrome_trace(const std::string &filename) const
+{
+  FILE* file = fopen(filename.c_str(), "w");
+  if (!file)
+    return false;
+
+  fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+
+  // Name the tracks
+  std::set<int> tids;
+  for (size_t i = 0; i < size(); i++)
+    tids.insert(event(i).tid);
+  tids.insert(SIMULATOR_TID);
+  bool first = true;
+  for (std::set<int>::iterator it = tids.begin(); it != tids.end(); it++)
+  {
+    std::string name = *it == SIMULATOR_TID ? "simulator"
+                     : *it == SENSOR_TID ? "sensors"
+                     : "estimator " + std::to_string(*it - ESTIMATOR_TID);
+    fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+            first ? "" : ",\n", *it, name.c_str());
+    first = false;
+  }
+
+  for (size_t i = 0; i < size(); i++)
+  {
+    const Event& e = event(i);
+    const char* name = Profiler::name((ProfileStage)e.stage);
+    if (e.kind == SPAN)
+    {
+      fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,"
+                    "\"args\":{\"sim_t\":%.6f}}",
+              name, e.tid, e.wall_ns * 1e-3, e.dur_ns * 1e-3, e.sim_t);
+    }
+    else
+    {
+      fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,"
+                    "\"args\":{\"sim_t\":%.6f,\"delay\":%.6f}}",
+              name, e.tid, e.wall_ns * 1e-3, e.sim_t, e.delay);
+    }
+  }
+
+  fprintf(file, "\n],\"otherData\":{\"dropped_events\":%llu}}\n", (unsigned long long)dropped());
+  fclose(file);
+  return true;
+}
+
+}
@@ -0,0 +1,215 @@
+#include <cmath>
+#include <complex>
+#include <map>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <tuple>
+
+#include "multirotor_sim/turbulence.h"
+
+using namespace Eigen;
+
+namespace multirotor_sim
+{
+
+typedef std::complex<double> Complex;
+
+// In place radix-2 FFT of n (a power of 2) values, inverse without the 1/n
+static void fft(Complex* x, int n, bool inverse)
+{
+  for (int i = 1, j = 0; i < n; i++)
+  {
+    int bit = n >> 1;
+    for (; j & bit; bit >>= 1)
+      j ^= bit;
+    j ^= bit;
+    if (i < j)
+      std::swap(x[i], x[j]);
+  }
+  for (int len = 2; len <= n; len <<= 1)
+  {
+    const double angle = (inverse ? 2.0 : -2.0) * M_PI / len;
+    const Complex step(std::cos(angle), std::sin(angle));
+    for (int i = 0; i < n; i += len)
+    {
+      Complex w(1.0, 0.0);
+      for (int j = 0; j < len / 2; j++)
+      {
+        const Complex a = x[i + j], b = w * x[i + j + len / 2];
+        x[i + j] = a + b;
+        x[i + j + len / 2] = a - b;
+        w *= step;
+      }
+    }
+  }
+}
+
+// Along each axis in turn, a line at a time, of a size^3 grid with x fastest
+static void inverse_fft3(std::vector<Complex>& grid, int size)
+{
+  std::vector<Complex> line(size);
+  const size_t strides[3] = {1, (size_t)size, (size_t)size * size};
+  for (int axis = 0; axis < 3; axis++)
+  {
+    const size_t stride = strides[axis];
+    for (size_t start = 0; start < grid.size(); start++)
+    {
+      // Lines start where the index along this axis is 0
+      if ((start / stride) % size != 0)
+        continue;
+      for (int i = 0; i < size; i++)
+        line[i] = grid[start + i * stride];
+      fft(line.data(), size, true);
+      for (int i = 0; i < size; i++)
+        grid[start + i * stride] = line[i];
+    }
+  }
+}
+
+TurbulenceField::Params::Params() :
+  model(VON_KARMAN),
+  size(64),
+  cell_size(4.0),
+  length_scale(50.0),
+  stdev(1.0)
+{}
+
+// An isotropic field with energy spectrum E(k) has spectral tensor E(k) / (4 pi k^2) times the
+// projection across k, so each mode is a complex gaussian vector projected across its wavenumber
+// and scaled by sqrt(E(k)) / k.  The real part of the inverse transform is then scaled to stdev,
+// leaving the spectrum's constants out.
+TurbulenceField::TurbulenceField(const Params &params, uint64_t seed) :
+  params_(params),
+  seed_(seed),
+  mask_(params.size - 1),
+  inv_cell_(1.0 / params.cell_size)
+{
+  const int n = params.size;
+  if (n < 2 || (n & (n - 1)) != 0)
+    throw std::runtime_error("The turbulence grid size must be a power of 2");
+  if (!(params.cell_size > 0.0))
+    throw std::runtime_error("The turbulence cell size must be positive");
+  if (!(params.length_scale > 0.0))
+    throw std::runtime_error("The turbulence length scale must be positive");
+
+  const size_t nodes = (size_t)n * n * n;
+  std::vector<Complex> spectrum[3];
+  for (int c = 0; c < 3; c++)
+    spectrum[c].assign(nodes, Complex(0.0, 0.0));
+
+  std::mt19937_64 gen(seed);
+  std::normal_distribution<double> normal;
+  const double dk = 2.0 * M_PI / (n * params.cell_size);
+  const double exponent = params.model == DRYDEN ? 3.0 : 17.0 / 6.0;
+  for (int k = 0; k < n; k++)
+  {
+    for (int j = 0; j < n; j++)
+    {
+      for (int i = 0; i < n; i++)
+      {
+        const Vector3d kv = dk * Vector3d(i < n / 2 ? i : i - n, j < n / 2 ? j : j - n, k < n / 2 ? k : k - n);
+        Complex z[3];
+        for (int c = 0; c < 3; c++)
+        {
+          const double re = normal(gen);
+          z[c] = Complex(re, normal(gen));
+        }
+        const double kn = kv.norm();
+        if (kn == 0.0)
+          continue;
+
+        const double kl = kn * params.length_scale;
+        const double energy = std::pow(kl, 4) / std::pow(1.0 + kl * kl, exponent);
+        const double amplitude = std::sqrt(energy) / kn;
+        const Vector3d khat = kv / kn;
+        const Complex along = khat.x() * z[0] + khat.y() * z[1] + khat.z() * z[2];
+        const size_t index = ((size_t)k * n + j) * n + i;
+        for (int c = 0; c < 3; c++)
+          spectrum[c][index] = amplitude * (z[c] - khat(c) * along);
+      }
+    }
+  }
+
+  double sum_sq = 0.0;
+  for (int c = 0; c < 3; c++)
+  {
+    inverse_fft3(spectrum[c], n);
+    for (size_t m = 0; m < nodes; m++)
+      sum_sq += spectrum[c][m].real() * spectrum[c][m].real();
+  }
+  const double scale = sum_sq > 0.0 ? params.stdev / std::sqrt(sum_sq / (3.0 * nodes)) : 0.0;
+
+  v_.resize(3 * nodes);
+  for (size_t m = 0; m < nodes; m++)
+  {
+    for (int c = 0; c < 3; c++)
+      v_[3 * m + c] = scale * spectrum[c][m].real();
+  }
+}
+
+// Fields that are still held by someone, by parameters and seed
+std::shared_ptr<const TurbulenceField> TurbulenceField::shared(const Params &params, uint64_t seed)
+{
+  typedef std::tuple<int, int, double, double, double, uint64_t> Key;
+  static std::mutex mutex;
+  static std::map<Key, std::weak_ptr<const TurbulenceField>> fields;
+
+  const Key key(params.model, params.size, params.cell_size, params.length_scale, params.stdev, seed);
+  std::lock_guard<std::mutex> lock(mutex);
+  std::shared_ptr<const TurbulenceField> field;
+  auto found = fields.find(key);
+  if (found != fields.end())
+    field = found->second.lock();
+  if (field)
+    return field;
+
+  // Forget the fields nobody holds any more, so a study sweeping seeds doesn't pile up entries
+  for (auto it = fields.begin(); it != fields.end();)
+  {
+    if (it->second.expired())
+      it = fields.erase(it);
+    else
+      ++it;
+  }
+  field = std::make_shared<const TurbulenceField>(params, seed);
+  fields[key] = field;
+  return field;
+}
+
+Vector3d TurbulenceField::node(int i, int j, int k) const
+{
+  const int n = params_.size;
+  const float* v = v_.data() + 3 * (((size_t)(k & mask_) * n + (j & mask_)) * n + (i & mask_));
+  return Vector3d(v[0], v[1], v[2]);
+}
+
+Vector3d TurbulenceField::sample(const Vector3d &p) const
+{
+  const Vector3d g = p * inv_cell_;
+  const Vector3d lo = g.array().floor();
+  const Vector3d f = g - lo;
+  const int i = (long long)lo.x() & mask_, j = (long long)lo.y() & mask_, k = (long long)lo.z() & mask_;
+  const int i1 = (i + 1) & mask_, j1 = (j + 1) & mask_, k1 = (k + 1) & mask_;
+  const int n = params_.size;
+  const float* v = v_.data();
+  auto at = [&](int a, int b, int c) -> Vector3d
+  {
+    return Map<const Vector3f>(v + 3 * (((size_t)c * n + b) * n + a)).cast<double>();
+  };
+
+  const Vector3d y0 = (1.0 - f.y()) * ((1.0 - f.x()) * at(i, j, k) + f.x() * at(i1, j, k))
+                      + f.y() * ((1.0 - f.x()) * at(i, j1, k) + f.x() * at(i1, j1, k));
+  const Vector3d y1 = (1.0 - f.y()) * ((1.0 - f.x()) * at(i, j, k1) + f.x() * at(i1, j, k1))
+                      + f.y() * ((1.0 - f.x()) * at(i, j1, k1) + f.x() * at(i1, j1, k1));
+  return (1.0 - f.z()) * y0 + f.z() * y1;
+}
+
+Vector3d Gust::velocity(double t) const
+{
+  if (t <= start || t >= start + duration)
+    return Vector3d::Zero();
+  return 0.5 * (1.0 - std::cos(2.0 * M_PI * (t - start) / duration)) * amplitude;
+}
+
+}